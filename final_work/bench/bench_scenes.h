@@ -0,0 +1,84 @@
+#ifndef BENCH_SCENES_H
+#define BENCH_SCENES_H
+
+// 各个 benchmark 共用的场景和小工具
+// stb_image 的实现由每个 bench 的 .cpp 自己定义 STB_IMAGE_IMPLEMENTATION 之后再包含
+#include "camera.h"
+#include "material.hpp"
+#include "scene.h"
+#include "sphere.h"
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// 和 main.cpp 一样的墙角场景，去掉了图片纹理
+inline void build_corner_scene(Scene& scene) {
+    auto ground = scene.arena.make<Lambertian>(Color(0.5, 0.5, 0.5));
+    auto red = scene.arena.make<Lambertian>(Color(0.7, 0.3, 0.3));
+    auto green = scene.arena.make<Lambertian>(Color(0.3, 0.7, 0.3));
+    auto blue = scene.arena.make<Lambertian>(Color(0.3, 0.3, 0.7));
+    auto glass = scene.arena.make<Dielectric>(1.5);
+    auto metal = scene.arena.make<Metal>(Color(0.8, 0.6, 0.2), 0.01);
+    auto light = scene.arena.make<DiffuseLight>(Color(50.0, 50.0, 50.0));
+    scene.add(scene.arena.make<Sphere>(Point3(0, -100.5, -1), 100, ground));
+    scene.add(scene.arena.make<Sphere>(Point3(0, 0, -1003), 1000, red));
+    scene.add(scene.arena.make<Sphere>(Point3(-1002, 0, -1), 1000, blue));
+    scene.add(scene.arena.make<Sphere>(Point3(1002, 0, -1), 1000, green));
+    scene.add(scene.arena.make<Sphere>(Point3(0, 0, 1005), 1000, red));
+    scene.add(scene.arena.make<Sphere>(Point3(0.8, 1.5, 0.2), 0.2, light));
+    scene.add(scene.arena.make<Sphere>(Point3(-0.5, 0, 0.2), 0.5, glass));
+    scene.add(scene.arena.make<Sphere>(Point3(1.1, 0, -1.1), 0.7, metal));
+}
+
+// 看墙角场景的相机
+inline Camera corner_camera(int width, int height) {
+    return Camera(Point3(0, 1, 4), Point3(0, 0, -1), Vec3(0, 1, 0), 35, double(width) / height);
+}
+
+/**
+* 地面上一片随机大小的小球：grid x grid 个，z 方向从 0 往 -grid 排开，每次调用的随机数顺序相同
+*@param & scene 场景
+*@param grid    每边的小球数
+*@param ball    小球的材质
+*@param metal   不为空时 (x + z) % 5 == 0 的小球用它
+*/
+inline void build_sphere_grid(Scene& scene, int grid, shared_ptr<Material> ball, shared_ptr<Material> metal = nullptr) {
+    shared_ptr<Material> ground = scene.arena.make<Lambertian>(Color(0.5, 0.5, 0.5));
+    scene.add(scene.arena.make<Sphere>(Point3(0, -1000, 0), 1000, ground));
+    for (int z = 0; z < grid; ++z)
+        for (int x = 0; x < grid; ++x) {
+            Real r = 0.2 + 0.2 * random_double();
+            Point3 c(x - grid / 2 + 0.5 * random_double(), r, -z - 0.5 * random_double());
+            scene.add(scene.arena.make<Sphere>(c, r, metal && (x + z) % 5 == 0 ? metal : ball));
+        }
+}
+
+// 两张 8 位图像之间的 RMSE（0~255）
+inline double rmse(const std::vector<unsigned char>& a, const std::vector<unsigned char>& b) {
+    double sum = 0;
+    for (size_t i = 0; i < a.size(); ++i) sum += (double(a[i]) - b[i]) * (double(a[i]) - b[i]);
+    return std::sqrt(sum / a.size());
+}
+
+inline double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// 作用域内关掉 std::cout / std::cerr：渲染器和场景 commit 会打进度和统计，bench 只看计时
+class QuietOutput {
+public:
+    QuietOutput() : cout_buf(std::cout.rdbuf(nullptr)), cerr_buf(std::cerr.rdbuf(nullptr)) {}
+    ~QuietOutput() {
+        std::cout.rdbuf(cout_buf);
+        std::cerr.rdbuf(cerr_buf);
+    }
+    QuietOutput(const QuietOutput&) = delete;
+    QuietOutput& operator=(const QuietOutput&) = delete;
+
+private:
+    std::streambuf* cout_buf;
+    std::streambuf* cerr_buf;
+};
+
+#endif
@@ -0,0 +1,92 @@
+// 数值精度对比：同一份源码分别编译成 double (PrecisionBench) 和 float (PrecisionBenchFloat)，
+// 在同一个场景、同一个采样器、同样的 spp 下渲染，比较耗时和误差（8 位，0~255 的 RMSE）
+// double 版渲染高 spp 的参考图，把参考图和自己的结果存到当前目录；float 版读进来比较，所以先运行 double 版：
+//     ./PrecisionBench && ./PrecisionBenchFloat
+// 两边用的是同一串样本，float 和 double 结果之间的差别就是精度带来的误差（自相交、求根误差等）
+#include "bench_scenes.h"
+#include "renderer_path.h"
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+namespace {
+
+const int kWidth = 160;
+const int kHeight = 90;
+const int kSpp = 16;
+const int kReferenceSpp = 256;
+const int kMaxDepth = 8;
+const int kRrMinBounce = 3;
+const int kRuns = 3; // 取最快的一次
+const char* kReferenceFile = "precision_reference.bin";
+const char* kDoubleFile = "precision_double.bin";
+
+// 渲染 runs 遍，渲染器的进度输出关掉，返回最快一遍的耗时
+double render(const Scene& scene, const Camera& cam, int spp, int runs, std::vector<unsigned char>& buffer) {
+    std::unique_ptr<Sampler> sampler = make_sampler("sobol", spp, kWidth);
+    QuietOutput quiet;
+    double best = 1e30;
+    for (int r = 0; r < runs; ++r) {
+        auto start = std::chrono::steady_clock::now();
+        render_path_tracing(scene, cam, kWidth, kHeight, spp, kMaxDepth, kRrMinBounce, *sampler, buffer);
+        best = std::min(best, seconds_since(start));
+    }
+    return best;
+}
+
+bool save(const char* path, const std::vector<unsigned char>& buffer) {
+    std::ofstream out(path, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+    return bool(out);
+}
+
+bool load(const char* path, size_t size, std::vector<unsigned char>& buffer) {
+    std::ifstream in(path, std::ios::binary);
+    buffer.resize(size);
+    in.read(reinterpret_cast<char*>(buffer.data()), size);
+    return bool(in);
+}
+
+} // namespace
+
+int main() {
+    const bool is_double = sizeof(Real) == sizeof(double);
+    Scene scene;
+    build_corner_scene(scene);
+    std::streambuf* cout_buf = std::cout.rdbuf(nullptr);
+    bool committed = scene.commit(AccelType::Bvh);
+    std::cout.rdbuf(cout_buf);
+    if (!committed) {
+        std::fprintf(stderr, "场景 commit 失败\n");
+        return 1;
+    }
+    Camera cam = corner_camera(kWidth, kHeight);
+    std::printf("数值精度 %s, %dx%d, %d spp, 参考图 %d spp (double)\n", is_double ? "double" : "float", kWidth, kHeight, kSpp, kReferenceSpp);
+
+    std::vector<unsigned char> image, reference, other;
+    double seconds = render(scene, cam, kSpp, kRuns, image);
+    const size_t size = image.size();
+    if (is_double) {
+        render(scene, cam, kReferenceSpp, 1, reference);
+        if (!save(kReferenceFile, reference) || !save(kDoubleFile, image)) {
+            std::fprintf(stderr, "无法写入 %s / %s\n", kReferenceFile, kDoubleFile);
+            return 1;
+        }
+        std::printf("double  %7.3f s  %6.3f M样本/s  和参考图 RMSE %6.2f\n",
+                    seconds, 1e-6 * kWidth * kHeight * kSpp / seconds, rmse(reference, image));
+        return 0;
+    }
+    if (!load(kReferenceFile, size, reference) || !load(kDoubleFile, size, other)) {
+        std::fprintf(stderr, "没有找到 %s / %s，请先在同一个目录运行 double 版 PrecisionBench\n", kReferenceFile, kDoubleFile);
+        return 1;
+    }
+    int differ = 0;
+    for (size_t i = 0; i < size; ++i) differ += image[i] != other[i];
+    std::printf("float   %7.3f s  %6.3f M样本/s  和参考图 RMSE %6.2f  和 double 结果 RMSE %6.2f (%.2f%% 的通道值不同)\n",
+                seconds, 1e-6 * kWidth * kHeight * kSpp / seconds, rmse(reference, image), rmse(other, image), 100.0 * differ / size);
+    return 0;
+}
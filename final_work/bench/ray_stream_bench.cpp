@@ -0,0 +1,111 @@
+// 光线流求交的吞吐量：同一批光线分别用逐条 hit() 和 intersect_stream / occluded_stream 求交，比较每秒光线数
+// 场景是地面上一片小球（BVH），光线分三种：
+//   grid      相机光线，按像素顺序提交
+//   coherent  同样是从一个相机位置发出的光线，但目标点随机、提交顺序是乱的，要靠重排才能打成相干的包
+//   diffuse / shadow  从地面上的随机点朝余弦半球的随机方向发出，模拟漫反射之后的次级光线和阴影光线
+// 同时检查两种方式的结果一致（击中与否、t）
+#include "bench_scenes.h"
+#include "ray_stream.h"
+#include "sampling.h"
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+const int kRays = 1 << 18;
+const int kGrid = 64; // 地面上 kGrid x kGrid 个小球
+const int kRounds = 2;
+
+RayStream coherent_rays() {
+    RayStream rays;
+    Point3 eye(0, 4, 8);
+    for (int i = 0; i < kRays; ++i) {
+        Point3 target(random_double(-kGrid / 2, kGrid / 2), 0, -random_double(0, kGrid));
+        rays.push(Ray(eye, unit_vector(target - eye)));
+    }
+    return rays;
+}
+
+RayStream grid_rays() {
+    RayStream rays;
+    Point3 eye(0, 4, 8);
+    const int side = 1 << 9; // side * side == kRays
+    for (int y = 0; y < side; ++y)
+        for (int x = 0; x < side; ++x) {
+            Point3 target(-kGrid / 2 + kGrid * (x + 0.5) / side, 0, -kGrid * (y + 0.5) / side);
+            rays.push(Ray(eye, unit_vector(target - eye)));
+        }
+    return rays;
+}
+
+RayStream incoherent_rays(bool shadow) {
+    RayStream rays;
+    for (int i = 0; i < kRays; ++i) {
+        Point3 o(random_double(-kGrid / 2, kGrid / 2), 0.001, -random_double(0, kGrid));
+        Vec3 d = Onb(Vec3(0, 1, 0)).to_world(sample_cosine_hemisphere(random_double(), random_double()));
+        rays.push(Ray(o, d), shadow ? Real(2) : infinity);
+    }
+    return rays;
+}
+
+// 返回和逐条 hit() 结果不一致的光线数
+int run(const char* label, const HittableObj& world, const RayStream& rays) {
+    const int n = static_cast<int>(rays.size());
+    std::vector<char> scalar_hit(n);
+    std::vector<Real> scalar_t(n);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < kRounds; ++r) {
+        #pragma omp parallel for schedule(dynamic, 1024)
+        for (int i = 0; i < n; ++i) {
+            HitRecord rec;
+            scalar_hit[i] = world.hit(rays.ray(i), kRayTMin, rays.t_max[i], rec);
+            scalar_t[i] = rec.t;
+        }
+    }
+    double scalar_time = seconds_since(start);
+
+    HitStream hits;
+    start = std::chrono::steady_clock::now();
+    for (int r = 0; r < kRounds; ++r) intersect_stream(world, rays, hits);
+    double stream_time = seconds_since(start);
+
+    std::vector<uint64_t> blocked;
+    start = std::chrono::steady_clock::now();
+    for (int r = 0; r < kRounds; ++r) blocked = occluded_stream(world, rays);
+    double occluded_time = seconds_since(start);
+
+    int mismatch = 0;
+    for (int i = 0; i < n; ++i) {
+        bool same = scalar_hit[i] == hits.hit[i] && scalar_hit[i] == stream_bit(blocked, i)
+                    && (!scalar_hit[i] || std::fabs(scalar_t[i] - hits.rec[i].t) <= 1e-6 * scalar_t[i]);
+        if (!same) ++mismatch;
+    }
+
+    double total = double(n) * kRounds / 1e6;
+    std::printf("%-10s  scalar %7.2f Mrays/s   stream %7.2f Mrays/s (%.2fx)   occluded %7.2f Mrays/s   mismatch %d\n",
+                label, total / scalar_time, total / stream_time, scalar_time / stream_time, total / occluded_time, mismatch);
+    return mismatch;
+}
+
+} // namespace
+
+int main() {
+    Scene scene;
+    build_sphere_grid(scene, kGrid, scene.arena.make<Lambertian>(Color(0.7, 0.3, 0.3)));
+    if (!scene.commit(AccelType::Bvh)) {
+        std::fprintf(stderr, "场景 commit 失败\n");
+        return 1;
+    }
+    std::printf("光线流求交, %d 条光线 x %d 轮, %d 个物体\n", kRays, kRounds, kGrid * kGrid + 1);
+    int mismatch = run("grid", scene.accel(), grid_rays());
+    mismatch += run("coherent", scene.accel(), coherent_rays());
+    mismatch += run("diffuse", scene.accel(), incoherent_rays(false));
+    mismatch += run("shadow", scene.accel(), incoherent_rays(true));
+    return mismatch ? 1 : 0;
+}
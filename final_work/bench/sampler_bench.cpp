@@ -0,0 +1,123 @@
+// 采样器对比：低 spp 下的误差，以及人眼感知的误差
+// 每个像素估计一个二维积分（一条正弦形状的遮挡边缘下的软阴影），积分的位置随像素缓慢变化，
+// 参考值用一维数值积分精确算出。感知误差 = 估计图和参考图各自做一次高斯低通 (sigma = 1.5 像素) 之后的 RMSE，
+// 近似人眼和降噪器看到的误差：白噪声的误差低通后还在，蓝噪声的误差集中在高频，低通后基本消掉。
+// 每个采样器同时给出每个样本的耗时，同样耗时下比较误差。
+#include "sampler.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+const int kWidth = 128;
+const int kHeight = 128;
+const int kRounds = 8; // 计时重复轮数
+
+// 像素 (x, y) 处遮挡边缘的位置，在图像上缓慢变化
+double edge(int x, int y) {
+    return 0.5 + 0.3 * std::sin(x * 0.05) * std::cos(y * 0.04);
+}
+
+// 被积函数：u 在遮挡边缘左边就是亮的
+double integrand(int x, int y, double u, double v) {
+    return u + 0.35 * std::sin(2 * pi * v) < edge(x, y) ? 1.0 : 0.0;
+}
+
+// 对 u 的积分是 clamp(t - 0.35 sin(2 pi v), 0, 1)，对 v 数值积分
+std::vector<double> reference() {
+    std::vector<double> ref(kWidth * kHeight);
+    const int n = 4096;
+    for (int y = 0; y < kHeight; ++y) {
+        for (int x = 0; x < kWidth; ++x) {
+            double sum = 0;
+            for (int k = 0; k < n; ++k) {
+                double v = (k + 0.5) / n;
+                double c = edge(x, y) - 0.35 * std::sin(2 * pi * v);
+                sum += c < 0 ? 0 : (c > 1 ? 1 : c);
+            }
+            ref[y * kWidth + x] = sum / n;
+        }
+    }
+    return ref;
+}
+
+// 环绕边界的可分离高斯低通
+std::vector<double> blur(const std::vector<double>& img, double sigma) {
+    const int r = static_cast<int>(std::ceil(3 * sigma));
+    std::vector<double> w(2 * r + 1);
+    double wsum = 0;
+    for (int i = -r; i <= r; ++i) wsum += w[i + r] = std::exp(-i * i / (2 * sigma * sigma));
+    for (double& x : w) x /= wsum;
+    std::vector<double> tmp(img.size()), out(img.size());
+    for (int y = 0; y < kHeight; ++y)
+        for (int x = 0; x < kWidth; ++x) {
+            double s = 0;
+            for (int i = -r; i <= r; ++i) s += w[i + r] * img[y * kWidth + (x + i + kWidth) % kWidth];
+            tmp[y * kWidth + x] = s;
+        }
+    for (int y = 0; y < kHeight; ++y)
+        for (int x = 0; x < kWidth; ++x) {
+            double s = 0;
+            for (int i = -r; i <= r; ++i) s += w[i + r] * tmp[((y + i + kHeight) % kHeight) * kWidth + x];
+            out[y * kWidth + x] = s;
+        }
+    return out;
+}
+
+double rmse(const std::vector<double>& a, const std::vector<double>& b) {
+    double s = 0;
+    for (size_t i = 0; i < a.size(); ++i) s += (a[i] - b[i]) * (a[i] - b[i]);
+    return std::sqrt(s / a.size());
+}
+
+// 用 sampler 渲染一张 spp 的估计图
+std::vector<double> render(Sampler& sampler, int spp) {
+    std::vector<double> img(kWidth * kHeight);
+    for (int y = 0; y < kHeight; ++y) {
+        for (int x = 0; x < kWidth; ++x) {
+            double sum = 0;
+            for (int s = 0; s < spp; ++s) {
+                sampler.start_pixel_sample(y * kWidth + x, s);
+                Real u, v;
+                sampler.get_2d(u, v);
+                sum += integrand(x, y, u, v);
+            }
+            img[y * kWidth + x] = sum / spp;
+        }
+    }
+    return img;
+}
+
+} // namespace
+
+int main() {
+    const char* names[] = {"independent", "stratified", "halton", "sobol", "bluenoise"};
+    const int spps[] = {1, 2, 4};
+
+    std::vector<double> ref = reference();
+    std::vector<double> ref_blur = blur(ref, 1.5);
+    BlueNoiseMask::instance(); // 阈值图的生成不算进计时
+
+    std::printf("采样器对比, %dx%d, 误差是 RMSE / 低通后的感知 RMSE\n", kWidth, kHeight);
+    std::printf("%-12s", "sampler");
+    for (int spp : spps) std::printf("   %dspp rmse / perceived", spp);
+    std::printf("   ns/sample\n");
+    for (const char* name : names) {
+        std::printf("%-12s", name);
+        double ns_per_sample = 0;
+        for (int spp : spps) {
+            std::unique_ptr<Sampler> sampler = make_sampler(name, spp, kWidth);
+            auto start = std::chrono::steady_clock::now();
+            std::vector<double> img;
+            for (int r = 0; r < kRounds; ++r) img = render(*sampler, spp);
+            auto end = std::chrono::steady_clock::now();
+            ns_per_sample += std::chrono::duration<double, std::nano>(end - start).count()
+                             / (double(kWidth) * kHeight * spp * kRounds);
+            std::printf("   %8.4f / %8.4f      ", rmse(img, ref), rmse(blur(img, 1.5), ref_blur));
+        }
+        std::printf("   %7.1f\n", ns_per_sample / (sizeof(spps) / sizeof(spps[0])));
+    }
+    return 0;
+}
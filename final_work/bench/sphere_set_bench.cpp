@@ -0,0 +1,134 @@
+// SphereSet 和逐个 Sphere 的对比：同一批随机小球，一边每个球是一个 Sphere 物体、由场景的 BVH 管理，
+// 一边全部放进一个 SphereSet（内部 BVH，叶子是 kLanes 个球的 SoA 块）。比较建场景的时间、内存和求交的每秒光线数，
+// 光线分两种：
+//   camera   从场景外面的一个相机位置按像素顺序射进来
+//   random   从球群内部的随机点朝随机方向射出，模拟漫反射之后的次级光线
+// 同时检查两边的结果一致（击中与否、t）
+#include "material.hpp"
+#include "sampling.h"
+#include "scene.h"
+#include "sphere.h"
+#include "sphere_set.h"
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include <omp.h>
+
+namespace {
+
+const int kSpheres = 200000;
+const Real kExtent = 100; // 球心在 [-kExtent, kExtent] x [0, kExtent / 4] x [-kExtent, kExtent] 里
+const int kSide = 512;    // camera 光线 kSide x kSide 条
+const int kRays = kSide * kSide;
+
+struct SphereDesc {
+    Point3 center;
+    Real radius;
+};
+
+std::vector<SphereDesc> random_spheres() {
+    std::vector<SphereDesc> spheres(kSpheres);
+    for (SphereDesc& s : spheres) {
+        s.center = Point3(random_double(-kExtent, kExtent), random_double(0, kExtent / 4), random_double(-kExtent, kExtent));
+        s.radius = random_double(0.1, 0.5);
+    }
+    return spheres;
+}
+
+std::vector<Ray> camera_rays() {
+    std::vector<Ray> rays;
+    Point3 eye(0, kExtent / 2, kExtent * 1.5);
+    for (int y = 0; y < kSide; ++y)
+        for (int x = 0; x < kSide; ++x) {
+            Point3 target(-kExtent + 2 * kExtent * (x + 0.5) / kSide, 0, -kExtent + 2 * kExtent * (y + 0.5) / kSide);
+            rays.push_back(Ray(eye, unit_vector(target - eye)));
+        }
+    return rays;
+}
+
+std::vector<Ray> random_rays() {
+    std::vector<Ray> rays;
+    for (int i = 0; i < kRays; ++i) {
+        Point3 o(random_double(-kExtent, kExtent), random_double(0, kExtent / 4), random_double(-kExtent, kExtent));
+        rays.push_back(Ray(o, sample_uniform_sphere(random_double(), random_double())));
+    }
+    return rays;
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// 逐条求交，返回耗时；t 里存每条光线最近交点的 t，没击中是 infinity
+double trace(const HittableObj& world, const std::vector<Ray>& rays, std::vector<Real>& t) {
+    const int n = static_cast<int>(rays.size());
+    t.assign(n, infinity);
+    auto start = std::chrono::steady_clock::now();
+    #pragma omp parallel for schedule(dynamic, 256)
+    for (int i = 0; i < n; ++i) {
+        PrimHit hit;
+        if (world.intersect(rays[i], kRayTMin, infinity, hit)) t[i] = hit.t;
+    }
+    return seconds_since(start);
+}
+
+int mismatches(const std::vector<Real>& a, const std::vector<Real>& b) {
+    int bad = 0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (std::isinf(a[i]) != std::isinf(b[i])) ++bad;
+        else if (!std::isinf(a[i]) && std::fabs(a[i] - b[i]) > 1e-4 * (1 + a[i])) ++bad;
+    }
+    return bad;
+}
+
+} // namespace
+
+int main() {
+    std::vector<SphereDesc> spheres = random_spheres();
+    std::printf("SphereSet, %d 个球, 每块 %d 个球 (%s), %d 个线程\n", kSpheres, SphereSet::kLanes, simd::backend_name(),
+                omp_get_max_threads());
+
+    // 逐个 Sphere + 场景 BVH
+    auto start = std::chrono::steady_clock::now();
+    Scene individual;
+    auto material = individual.arena.make<Lambertian>(Color(0.5, 0.5, 0.5));
+    for (const SphereDesc& s : spheres) individual.add(individual.arena.make<Sphere>(s.center, s.radius, material));
+    if (!individual.commit(AccelType::Bvh)) return 1;
+    double individual_build = seconds_since(start);
+
+    // 一个 SphereSet
+    start = std::chrono::steady_clock::now();
+    Scene grouped;
+    auto set = grouped.arena.make<SphereSet>();
+    auto set_material = grouped.arena.make<Lambertian>(Color(0.5, 0.5, 0.5));
+    for (const SphereDesc& s : spheres) set->add(s.center, s.radius, set_material);
+    set->build();
+    grouped.add(set);
+    if (!grouped.commit(AccelType::Bvh)) return 1;
+    double grouped_build = seconds_since(start);
+    std::printf("建场景: Sphere + BVH %.3f s, SphereSet %.3f s\n", individual_build, grouped_build);
+
+    struct RaySet {
+        const char* name;
+        std::vector<Ray> rays;
+    };
+    RaySet sets[] = {{"camera", camera_rays()}, {"random", random_rays()}};
+    bool ok = true;
+    for (const RaySet& s : sets) {
+        std::vector<Real> t_individual, t_grouped;
+        trace(individual.accel(), s.rays, t_individual); // 预热
+        double individual_seconds = trace(individual.accel(), s.rays, t_individual);
+        double grouped_seconds = trace(grouped.accel(), s.rays, t_grouped);
+        int bad = mismatches(t_individual, t_grouped);
+        ok = ok && bad == 0;
+        double mrays = s.rays.size() / 1e6;
+        std::printf("%-8s Sphere + BVH %6.2f Mrays/s, SphereSet %6.2f Mrays/s (%.2fx)  %s\n", s.name,
+                    mrays / individual_seconds, mrays / grouped_seconds, individual_seconds / grouped_seconds,
+                    bad ? "结果不一致!" : "");
+        if (bad) std::printf("         %d 条光线结果不一致\n", bad);
+    }
+    return ok ? 0 : 1;
+}
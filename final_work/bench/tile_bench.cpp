@@ -0,0 +1,94 @@
+// 分块调度和原来按行调度的对比：同一个场景用同样的采样器各渲染一遍，比较耗时和每秒样本数
+// 按行：#pragma omp parallel for schedule(dynamic, 1) 逐行分给线程（原来 render_path_tracing 的写法，去掉了每行的 critical 打印）
+// 分块：render_path_tracing，块的大小和顺序（scanline / morton / hilbert）各试几种
+// 场景是地面上一片贴了图的小球（BVH），相邻像素打到的几何和纹理相同，顺序好坏体现在缓存上；
+// 同时检查每种调度的结果和按行调度逐位相同
+#include "bench_scenes.h"
+#include "renderer_path.h"
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+const int kWidth = 480;
+const int kHeight = 270;
+const int kSpp = 4;
+const int kMaxDepth = 8;
+const int kRrMinBounce = 3;
+const int kGrid = 48; // 地面上 kGrid x kGrid 个小球
+
+// 原来的按行调度
+void render_rows(const Scene& scene, const Camera& cam, const Sampler& sampler_proto, std::vector<unsigned char>& buffer) {
+    buffer.resize(kWidth * kHeight * 3);
+    #pragma omp parallel
+    {
+    std::unique_ptr<Sampler> sampler = sampler_proto.clone(kSpp);
+    #pragma omp for schedule(dynamic, 1)
+    for (int row = 0; row < kHeight; ++row) {
+        for (int i0 = 0; i0 < kWidth; i0 += kCameraPacket) {
+            int n = std::min(kCameraPacket, kWidth - i0);
+            Color pixel_color[kCameraPacket];
+            int pixels[kCameraPacket], samples[kCameraPacket];
+            for (int k = 0; k < n; ++k) pixels[k] = row * kWidth + i0 + k;
+            for (int s = 0; s < kSpp; ++s) {
+                Color radiance[kCameraPacket];
+                for (int k = 0; k < n; ++k) samples[k] = s;
+                trace_camera_packet(scene, cam, kWidth, kHeight, n, pixels, samples, kMaxDepth, kRrMinBounce, *sampler, radiance);
+                for (int k = 0; k < n; ++k) pixel_color[k] += radiance[k];
+            }
+            for (int k = 0; k < n; ++k) store_pixel(buffer, pixels[k], pixel_color[k] / kSpp);
+        }
+    }
+    }
+}
+
+void report(const char* label, double seconds, double baseline, bool same) {
+    double msamples = double(kWidth) * kHeight * kSpp / 1e6;
+    std::printf("%-18s %7.3f s  %6.3f Msamples/s  (%.2fx)  %s\n", label, seconds, msamples / seconds, baseline / seconds,
+                same ? "" : "结果和按行不同!");
+}
+
+} // namespace
+
+int main() {
+    Scene scene;
+    shared_ptr<Material> ball = scene.arena.make<Lambertian>(scene.arena.make<ImageTexture>("maodie.png"));
+    build_sphere_grid(scene, kGrid, ball, scene.arena.make<Metal>(Color(0.8, 0.8, 0.8), 0.1));
+    if (!scene.commit(AccelType::Bvh)) {
+        std::fprintf(stderr, "场景 commit 失败\n");
+        return 1;
+    }
+    Camera cam(Point3(0, 3, 6), Point3(0, 0, -kGrid / 3), Vec3(0, 1, 0), 50, double(kWidth) / kHeight);
+    std::unique_ptr<Sampler> sampler = make_sampler("sobol", kSpp, kWidth);
+    std::printf("分块调度, %dx%d, %d spp, %d 个线程, %d 个物体\n", kWidth, kHeight, kSpp, omp_get_max_threads(), kGrid * kGrid + 1);
+
+    std::vector<unsigned char> reference, buffer;
+    render_rows(scene, cam, *sampler, reference); // 预热：第一次渲染要把 BVH 和纹理读进缓存
+    auto start = std::chrono::steady_clock::now();
+    render_rows(scene, cam, *sampler, reference);
+    double baseline = seconds_since(start);
+    report("rows", baseline, baseline, true);
+
+    const TileOrder orders[] = {TileOrder::Scanline, TileOrder::Morton, TileOrder::Hilbert};
+    const int sizes[] = {8, 16, 32};
+    for (TileOrder order : orders)
+        for (int size : sizes) {
+            TileSettings tiles;
+            tiles.size = size;
+            tiles.order = order;
+            double seconds;
+            {
+                QuietOutput quiet; // render_path_tracing 会往 stdout / stderr 打进度，这里只看计时
+                start = std::chrono::steady_clock::now();
+                render_path_tracing(scene, cam, kWidth, kHeight, kSpp, kMaxDepth, kRrMinBounce, *sampler, buffer, tiles);
+                seconds = seconds_since(start);
+            }
+            char label[32];
+            std::snprintf(label, sizeof(label), "%s %d", tile_order_name(order), size);
+            report(label, seconds, baseline, buffer == reference);
+        }
+    return 0;
+}
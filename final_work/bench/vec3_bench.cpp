@@ -0,0 +1,53 @@
+// Vec3 核心运算的微基准测试
+// 同一份源码会编译两次：Vec3Bench 使用 simd.h 选出的 SIMD 后端，
+// Vec3BenchScalar 定义了 RT_NO_SIMD，走标量回退，两者输出放在一起对比。
+#include "vec3.h"
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+const int kCount = 1 << 14;  // 每轮处理的向量个数，放得进 L2
+const int kRounds = 400;     // 重复轮数
+
+std::vector<Vec3> make_vectors(Real lo, Real hi) {
+    std::vector<Vec3> v(kCount);
+    for (auto& x : v) x = Vec3::random(lo, hi);
+    return v;
+}
+
+// 计时一个逐元素的操作，返回每次操作的纳秒数；sink 防止编译器把计算删掉
+template<typename Func>
+void run(const char* name, Func op) {
+    Real sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < kRounds; ++r) {
+        for (int i = 0; i < kCount; ++i) sink += op(i);
+    }
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    std::printf("%-16s %8.3f ns/op   (checksum %g)\n", name, ns / (double(kCount) * kRounds), double(sink));
+}
+
+} // namespace
+
+int main() {
+    std::printf("Vec3 微基准, 后端: %s, Real = %s, sizeof(Vec3) = %zu\n",
+                simd::backend_name(), sizeof(Real) == sizeof(float) ? "float" : "double", sizeof(Vec3));
+
+    auto a = make_vectors(-1, 1);
+    auto b = make_vectors(-1, 1);
+    auto c = make_vectors(0, 4); // HDR 颜色
+
+    run("add",            [&](int i) { return (a[i] + b[i]).x(); });
+    run("mul_scalar",     [&](int i) { return (a[i] * Real(1.7)).y(); });
+    run("mul_vec",        [&](int i) { return (a[i] * b[i]).z(); });
+    run("dot",            [&](int i) { return dot(a[i], b[i]); });
+    run("cross",          [&](int i) { return cross(a[i], b[i]).x(); });
+    run("unit_vector",    [&](int i) { return unit_vector(a[i]).y(); });
+    run("reflect",        [&](int i) { return reflect(a[i], b[i]).z(); });
+    run("aces_approx",    [&](int i) { return aces_approx(c[i]).x(); });
+    run("tonemap+gamma",  [&](int i) { return component_sqrt(aces_approx(c[i])).y(); });
+    return 0;
+}
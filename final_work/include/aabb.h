@@ -3,6 +3,8 @@
 #include "vec3.h"
 #include "ray.h"
 #include "utils.h"
+#include "ray_packet.h"
+#include <algorithm>
 
 /**
 *aabb盒：AABB指的是轴对齐边界盒（Axis-Aligned Bounding Box）
@@ -15,7 +17,7 @@ public:
     Point3 min() const { return minimum; }
     Point3 max() const { return maximum; }
 
-    bool hit(const Ray& r, double t_min, double t_max) const {
+    bool hit(const Ray& r, Real t_min, Real t_max) const {
         for (int a = 0; a < 3; a++) {
             auto invD = 1.0f / r.direction()[a];
             auto t0 = (minimum[a] - r.origin()[a]) * invD;
@@ -30,20 +32,76 @@ public:
         return true;
     }
 
+    /**
+    光线包的逐条包围盒测试
+    *@param & p 光线包
+    *@param active 参与测试的光线掩码
+    *@param t_min 最小 t 值
+    *@param t_max 每条光线当前最近交点的 t，长度为 p.size
+    *@return 击中包围盒的光线掩码
+    */
+    uint32_t hit_packet(const RayPacket& p, uint32_t active, Real t_min, const Real* t_max) const {
+        // 和 hit() 一样用比较 + 选择而不是 fmin/fmax：0*inf 产生的 NaN 比较结果为假，自动被忽略，
+        // 而且编译器能把比较选择向量化，fmin/fmax 在没有 -ffast-math 时是库函数调用
+        const Real* o[3] = {p.ox, p.oy, p.oz};
+        const Real* inv[3] = {p.idx, p.idy, p.idz};
+        Real t_near[RayPacket::kMaxSize], t_far[RayPacket::kMaxSize];
+        for (int k = 0; k < p.size; ++k) {
+            t_near[k] = t_min;
+            t_far[k] = t_max[k];
+        }
+        for (int a = 0; a < 3; ++a) {
+            const Real lo = minimum[a], hi = maximum[a];
+            #pragma omp simd
+            for (int k = 0; k < p.size; ++k) {
+                Real t0 = (lo - o[a][k]) * inv[a][k];
+                Real t1 = (hi - o[a][k]) * inv[a][k];
+                Real t_enter = inv[a][k] < 0 ? t1 : t0;
+                Real t_exit = inv[a][k] < 0 ? t0 : t1;
+                t_near[k] = t_enter > t_near[k] ? t_enter : t_near[k];
+                t_far[k] = t_exit < t_far[k] ? t_exit : t_far[k];
+            }
+        }
+        uint32_t mask = 0;
+        for (int k = 0; k < p.size; ++k)
+            if (t_far[k] > t_near[k]) mask |= (1u << k);
+        return mask & active;
+    }
+
+    /**
+    视锥剔除：用区间运算求整包光线进入包围盒的最早时间下界和离开的最晚时间上界，
+    下界大于上界说明包里没有一条光线能击中，整包跳过（保守测试，返回 false 不代表一定击中）
+    *@param & p 光线包，需要先调用 finalize()
+    *@param t_max 包内所有光线当前最近交点 t 的最大值
+    */
+    bool cull_packet(const RayPacket& p, Real t_min, Real t_max) const {
+        if (!p.frustum_valid) return false;
+        Real near_lo = t_min, far_hi = t_max;
+        for (int a = 0; a < 3; ++a) {
+            Real t0_lo, t0_hi, t1_lo, t1_hi;
+            interval_mul(minimum[a] - p.o_hi[a], minimum[a] - p.o_lo[a], p.inv_lo[a], p.inv_hi[a], t0_lo, t0_hi);
+            interval_mul(maximum[a] - p.o_hi[a], maximum[a] - p.o_lo[a], p.inv_lo[a], p.inv_hi[a], t1_lo, t1_hi);
+            near_lo = std::max(near_lo, std::min(t0_lo, t1_lo));
+            far_hi = std::min(far_hi, std::max(t0_hi, t1_hi));
+        }
+        return near_lo > far_hi;
+    }
+
     Point3 minimum;
     Point3 maximum;
+
+private:
+    // 区间乘法 [a_lo,a_hi] * [b_lo,b_hi]，frustum_valid 保证方向倒数有限，乘积不会是 NaN
+    static void interval_mul(Real a_lo, Real a_hi, Real b_lo, Real b_hi, Real& lo, Real& hi) {
+        Real p0 = a_lo*b_lo, p1 = a_lo*b_hi, p2 = a_hi*b_lo, p3 = a_hi*b_hi;
+        lo = std::min(std::min(p0, p1), std::min(p2, p3));
+        hi = std::max(std::max(p0, p1), std::max(p2, p3));
+    }
 };
 
 inline aabb surrounding_box(aabb box0, aabb box1) {
-    Point3 small(fmin(box0.min().x(), box1.min().x()),
-                 fmin(box0.min().y(), box1.min().y()),
-                 fmin(box0.min().z(), box1.min().z()));
-
-    Point3 big(fmax(box0.max().x(), box1.max().x()),
-               fmax(box0.max().y(), box1.max().y()),
-               fmax(box0.max().z(), box1.max().z()));
-
-    return aabb(small, big);
+    return aabb(component_min(box0.min(), box1.min()),
+                component_max(box0.max(), box1.max()));
 }
 
 #endif
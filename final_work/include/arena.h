@@ -0,0 +1,195 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <typeindex>
+#include <type_traits>
+#include <typeinfo>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#ifdef __GNUG__
+#include <cxxabi.h>
+#include <cstdlib>
+#endif
+
+using std::shared_ptr;
+
+// 类型擦除的池接口，Arena 统计内存占用用
+class PoolBase {
+public:
+    virtual ~PoolBase() {}
+    virtual size_t size() const = 0;
+    virtual size_t bytes_used() const = 0;
+    virtual size_t bytes_reserved() const = 0;
+    virtual const char* type_name() const = 0;
+};
+
+/**
+* 单一类型的对象池：对象按块 (chunk) 连续存放，块一旦分配就不会搬家，
+* 所以下标和指针在池的整个生命周期里都有效；池析构时按块整体释放
+*@param kChunk 每块的对象数
+*@brief emplace(args...) 在池尾构造一个对象，返回它的下标
+*@brief operator[](i) 按下标取对象
+*/
+template <typename T>
+class TypedPool : public PoolBase {
+public:
+    static constexpr size_t kChunk = 256;
+
+    TypedPool() {}
+    TypedPool(const TypedPool&) = delete;
+    TypedPool& operator=(const TypedPool&) = delete;
+
+    ~TypedPool() {
+        // 反序析构，和普通容器一样，跳过构造失败留下的空位；内存随块一起释放
+        for (size_t i = constructed.size(); i > 0; --i)
+            if (constructed[i - 1]) (*this)[i - 1].~T();
+    }
+
+    template <typename... Args>
+    size_t emplace(Args&&... args) {
+        // 先占下标再构造：BVH 节点的构造函数里会递归地在同一个池里创建子节点（子节点下标更大，却先构造完）。
+        // 构造成功之后才标记和计数，构造函数抛异常时这个下标留空，析构时不会对它调用 ~T
+        size_t i = constructed.size();
+        if (i == chunks.size() * kChunk) chunks.emplace_back(new Slot[kChunk]);
+        constructed.push_back(0);
+        new (slot(i)) T(std::forward<Args>(args)...);
+        constructed[i] = 1;
+        ++count;
+        return i;
+    }
+
+    T& operator[](size_t i) { return *reinterpret_cast<T*>(slot(i)); }
+    const T& operator[](size_t i) const { return *reinterpret_cast<const T*>(slot(i)); }
+
+    virtual size_t size() const override { return count; }
+    virtual size_t bytes_used() const override { return count * sizeof(T); }
+    virtual size_t bytes_reserved() const override { return chunks.size() * kChunk * sizeof(Slot); }
+    virtual const char* type_name() const override { return typeid(T).name(); }
+
+private:
+    // 按 T 的大小和对齐开的原始存储，构造和析构由池自己管
+    struct Slot { alignas(T) unsigned char bytes[sizeof(T)]; };
+
+    void* slot(size_t i) const { return chunks[i / kChunk][i % kChunk].bytes; }
+
+    std::vector<std::unique_ptr<Slot[]>> chunks;
+    std::vector<char> constructed; // 每个下标的对象是否构造成功
+    size_t count = 0;              // 构造成功的对象数
+};
+
+/**
+* Arena 里的对象的句柄：不持有所有权，就是一个指针，对象的生命周期由 Arena 决定，句柄不能活得比 Arena（也就是 Scene）更久
+* 现有的 HittableObj / Material 接口收 shared_ptr，句柄在交过去时隐式转换成没有控制块的别名 shared_ptr，
+* 同样不持有所有权、拷贝没有引用计数开销；名字写在类型上，调用方一看就知道它不是普通的 shared_ptr
+*@brief get() 取裸指针
+*/
+template <typename T>
+class ArenaRef {
+public:
+    ArenaRef() {}
+    explicit ArenaRef(T* p) : ptr(p) {}
+    template <typename U, typename = typename std::enable_if<std::is_convertible<U*, T*>::value>::type>
+    ArenaRef(const ArenaRef<U>& o) : ptr(o.get()) {}
+
+    T* get() const { return ptr; }
+    T& operator*() const { return *ptr; }
+    T* operator->() const { return ptr; }
+    explicit operator bool() const { return ptr != nullptr; }
+
+    template <typename U, typename = typename std::enable_if<std::is_convertible<T*, U*>::value>::type>
+    operator shared_ptr<U>() const { return shared_ptr<U>(shared_ptr<void>(), ptr); }
+
+private:
+    T* ptr = nullptr;
+};
+
+/**
+* Arena 类：场景存储。每种类型（球、三角形、BVH 节点、材质……）一个 TypedPool，
+* 同类对象连续存放，场景析构时整块释放，不用逐个走 shared_ptr 的控制块。
+* make<T>() 返回不持有所有权的句柄 ArenaRef<T>，可以直接交给现有的 HittableObj / Material 接口；
+* 对象的生命周期由 Arena 决定，所以句柄（以及从它转出来的 shared_ptr）不能活得比 Arena（也就是 Scene）更久
+*@brief make<T>(args...) 在 T 的池里构造一个对象，返回它的句柄
+*@brief pool<T>() 取 T 的池，可以按稳定的下标访问
+*@brief report(out) 打印每种类型的对象数和内存占用
+*/
+class Arena {
+public:
+    Arena() {}
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    ~Arena() {
+        // 按池创建的反序释放，和普通局部对象的析构顺序一致
+        for (auto it = order.rbegin(); it != order.rend(); ++it) pools.erase(*it);
+    }
+
+    template <typename T>
+    TypedPool<T>& pool() {
+        auto key = std::type_index(typeid(T));
+        auto it = pools.find(key);
+        if (it == pools.end()) {
+            it = pools.emplace(key, std::unique_ptr<PoolBase>(new TypedPool<T>())).first;
+            order.push_back(key);
+        }
+        return *static_cast<TypedPool<T>*>(it->second.get());
+    }
+
+    template <typename T, typename... Args>
+    ArenaRef<T> make(Args&&... args) {
+        TypedPool<T>& p = pool<T>();
+        return ArenaRef<T>(&p[p.emplace(std::forward<Args>(args)...)]);
+    }
+
+    size_t object_count() const {
+        size_t n = 0;
+        for (const auto& kv : pools) n += kv.second->size();
+        return n;
+    }
+
+    size_t bytes_reserved() const {
+        size_t n = 0;
+        for (const auto& kv : pools) n += kv.second->bytes_reserved();
+        return n;
+    }
+
+    void report(std::ostream& out) const {
+        out << "Arena: " << object_count() << " 个对象, 已分配 " << bytes_reserved() / 1024.0 << " KB\n";
+        for (const auto& key : order) {
+            const PoolBase& p = *pools.at(key);
+            out << "    " << demangle(p.type_name()) << ": " << p.size() << " 个, "
+                << p.bytes_used() / 1024.0 << " / " << p.bytes_reserved() / 1024.0 << " KB\n";
+        }
+    }
+
+private:
+    static std::string demangle(const char* name) {
+#ifdef __GNUG__
+        int status = 0;
+        char* s = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+        std::string result = (status == 0 && s) ? s : name;
+        std::free(s);
+        return result;
+#else
+        return name;
+#endif
+    }
+
+    std::unordered_map<std::type_index, std::unique_ptr<PoolBase>> pools;
+    std::vector<std::type_index> order;
+};
+
+// arena 为空时退回 make_shared，没有场景的地方（加载工具、单独的物体）照常使用；
+// arena 不为空时返回的是 ArenaRef 转出来的别名 shared_ptr，不持有所有权，不能活得比 arena 更久
+template <typename T, typename... Args>
+shared_ptr<T> arena_make(Arena* arena, Args&&... args) {
+    if (arena) return arena->make<T>(std::forward<Args>(args)...);
+    return std::make_shared<T>(std::forward<Args>(args)...);
+}
+
+#endif
@@ -4,6 +4,7 @@
 #include "utils.h"
 #include "hittable_obj.h"
 #include "hittable_list.hpp"
+#include "arena.h"
 #include <algorithm>
 #include <cstdlib>
 
@@ -11,15 +12,31 @@ class BvhNode : public HittableObj {
 public:
     BvhNode() {}
 
-    BvhNode(const HittableObjList& list, double time0, double time1)
+    BvhNode(const HittableObjList& list, Real time0, Real time1)
         : BvhNode(list.objects, 0, list.objects.size(), time0, time1)
     {}
 
+    // arena 不为空时，所有内部节点都放在 arena 的节点池里
     BvhNode(const std::vector<shared_ptr<HittableObj>>& src_objects,
-            size_t start, size_t end, double time0, double time1);
+            size_t start, size_t end, Real time0, Real time1, Arena* arena = nullptr);
+
+    virtual bool intersect(const Ray& r, Real t_min, Real t_max, PrimHit& hit) const override;
+    virtual bool bounding_box(Real time0, Real time1, aabb& output_box) const override;
+    virtual void hit_packet(const RayPacket& packet, uint32_t active, Real t_min, PacketHits& hits) const override;
+    virtual uint32_t occluded_packet(const RayPacket& packet, uint32_t active, Real t_min, const Real* t_max) const override;
+    virtual void assign_prim_id(int id) override {
+        prim_id = id;
+        left->assign_prim_id(id);
+        right->assign_prim_id(id);
+    }
+    virtual void collect_materials(std::vector<const Material*>& out) const override {
+        left->collect_materials(out);
+        if (right != left) right->collect_materials(out);
+    }
 
-    virtual bool hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const override;
-    virtual bool bounding_box(double time0, double time1, aabb& output_box) const override;
+private:
+    void build(std::vector<shared_ptr<HittableObj>>& objects,
+               size_t start, size_t end, Real time0, Real time1, Arena* arena);
 
 public:
     shared_ptr<HittableObj> left;
@@ -52,10 +69,24 @@ bool box_z_compare (const shared_ptr<HittableObj> a, const shared_ptr<HittableOb
 
 
 BvhNode::BvhNode(const std::vector<shared_ptr<HittableObj>>& src_objects,
-                 size_t start, size_t end, double time0, double time1) {
-    auto objects = src_objects; // Create a modifiable copy of the source vector
+                 size_t start, size_t end, Real time0, Real time1, Arena* arena) {
+    auto objects = src_objects; // 只在根节点拷贝一次，整棵树都在这份拷贝上原地排序
+    build(objects, start, end, time0, time1, arena);
+}
 
-    int axis = rand() % 3;
+void BvhNode::build(std::vector<shared_ptr<HittableObj>>& objects,
+                    size_t start, size_t end, Real time0, Real time1, Arena* arena) {
+    // 沿排序键（包围盒最小角）分布最长的轴划分，比随机选轴得到的树更紧，而且结果是确定的
+    Point3 key_lo(infinity, infinity, infinity), key_hi(-infinity, -infinity, -infinity);
+    for (size_t i = start; i < end; ++i) {
+        aabb b;
+        if (!objects[i]->bounding_box(time0, time1, b)) continue;
+        key_lo = component_min(key_lo, b.min());
+        key_hi = component_max(key_hi, b.min());
+    }
+    Vec3 extent = key_hi - key_lo;
+    int axis = (extent.x() >= extent.y() && extent.x() >= extent.z()) ? 0
+             : (extent.y() >= extent.z()) ? 1 : 2;
     auto comparator = (axis == 0) ? box_x_compare
                     : (axis == 1) ? box_y_compare
                     : box_z_compare;
@@ -76,8 +107,12 @@ BvhNode::BvhNode(const std::vector<shared_ptr<HittableObj>>& src_objects,
         std::sort(objects.begin() + start, objects.begin() + end, comparator);
 
         auto mid = start + object_span/2;
-        left = make_shared<BvhNode>(objects, start, mid, time0, time1);
-        right = make_shared<BvhNode>(objects, mid, end, time0, time1);
+        auto left_node = arena_make<BvhNode>(arena);
+        auto right_node = arena_make<BvhNode>(arena);
+        left_node->build(objects, start, mid, time0, time1, arena);
+        right_node->build(objects, mid, end, time0, time1, arena);
+        left = left_node;
+        right = right_node;
     }
 
     aabb box_left, box_right;
@@ -91,18 +126,57 @@ BvhNode::BvhNode(const std::vector<shared_ptr<HittableObj>>& src_objects,
 }
 
 
-bool BvhNode::hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const {
+bool BvhNode::intersect(const Ray& r, Real t_min, Real t_max, PrimHit& hit) const {
     if (!box.hit(r, t_min, t_max))
         return false;
 
-    bool hit_left = left->hit(r, t_min, t_max, rec);
-    bool hit_right = right->hit(r, t_min, hit_left ? rec.t : t_max, rec);
+    bool hit_left = left->intersect(r, t_min, t_max, hit);
+    bool hit_right = right->intersect(r, t_min, hit_left ? hit.t : t_max, hit);
 
     return hit_left || hit_right;
 }
 
 
-bool BvhNode::bounding_box(double time0, double time1, aabb& output_box) const {
+// 包遍历时活跃光线数少于 size / kPacketDivergeDivisor 就认为光线包已经发散，剩下的光线逐条遍历
+const int kPacketDivergeDivisor = 4;
+
+void BvhNode::hit_packet(const RayPacket& packet, uint32_t active, Real t_min, PacketHits& hits) const {
+    // 先用整包的视锥区间剔除，再逐条做包围盒测试得到新的活跃掩码
+    if (box.cull_packet(packet, t_min, hits.max_t(packet, active)))
+        return;
+    uint32_t box_mask = box.hit_packet(packet, active, t_min, hits.t);
+    if (!box_mask)
+        return;
+
+    if (packet_popcount(box_mask) * kPacketDivergeDivisor < packet.size) {
+        HittableObj::hit_packet(packet, box_mask, t_min, hits);
+        return;
+    }
+    left->hit_packet(packet, box_mask, t_min, hits);
+    right->hit_packet(packet, box_mask, t_min, hits);
+}
+
+// 遮挡测试和 hit_packet 一样剔除和判断发散，但左子树里被挡住的光线不再进右子树，全部挡住就不用看右子树
+uint32_t BvhNode::occluded_packet(const RayPacket& packet, uint32_t active, Real t_min, const Real* t_max) const {
+    Real max_t = -infinity;
+    for (int k = 0; k < packet.size; ++k)
+        if ((active & (1u << k)) && t_max[k] > max_t) max_t = t_max[k];
+    if (box.cull_packet(packet, t_min, max_t))
+        return 0;
+    uint32_t box_mask = box.hit_packet(packet, active, t_min, t_max);
+    if (!box_mask)
+        return 0;
+
+    if (packet_popcount(box_mask) * kPacketDivergeDivisor < packet.size)
+        return HittableObj::occluded_packet(packet, box_mask, t_min, t_max);
+    uint32_t blocked = left->occluded_packet(packet, box_mask, t_min, t_max);
+    if (blocked != box_mask)
+        blocked |= right->occluded_packet(packet, box_mask & ~blocked, t_min, t_max);
+    return blocked;
+}
+
+
+bool BvhNode::bounding_box(Real time0, Real time1, aabb& output_box) const {
     output_box = box;
     return true;
 }
@@ -35,22 +35,22 @@ inline void save_bvh_node(shared_ptr<HittableObj> node, std::ostream& out) {
     }
 }
 
-inline shared_ptr<HittableObj> load_bvh_node(std::istream& in, shared_ptr<Material> m) {
+inline shared_ptr<HittableObj> load_bvh_node(std::istream& in, shared_ptr<Material> m, Arena* arena = nullptr) {
     int type;
     in.read((char*)&type, sizeof(int));
     
     if (type == 0) {
-        auto node = make_shared<BvhNode>();
+        auto node = arena_make<BvhNode>(arena);
         in.read((char*)&node->box, sizeof(aabb));
-        node->left = load_bvh_node(in, m);
-        node->right = load_bvh_node(in, m);
+        node->left = load_bvh_node(in, m, arena);
+        node->right = load_bvh_node(in, m, arena);
         return node;
     } else if (type == 1) {
         Point3 v0, v1, v2;
         in.read((char*)&v0, sizeof(Point3));
         in.read((char*)&v1, sizeof(Point3));
         in.read((char*)&v2, sizeof(Point3));
-        return make_shared<Triangle>(v0, v1, v2, m);
+        return arena_make<Triangle>(arena, v0, v1, v2, m);
     }
     return nullptr;
 }
@@ -62,10 +62,10 @@ inline bool save_bvh_to_file(const std::string& filename, shared_ptr<HittableObj
     return true;
 }
 
-inline shared_ptr<HittableObj> load_bvh_from_file(const std::string& filename, shared_ptr<Material> m) {
+inline shared_ptr<HittableObj> load_bvh_from_file(const std::string& filename, shared_ptr<Material> m, Arena* arena = nullptr) {
     std::ifstream in(filename, std::ios::binary);
     if (!in) return nullptr;
-    return load_bvh_node(in, m);
+    return load_bvh_node(in, m, arena);
 }
 
 #endif
@@ -21,8 +21,8 @@ public:
         Point3 lookfrom,//从哪里看
         Point3 lookat,//往哪看
         Vec3   vup,//相机的上向量
-        double vfov, // 垂直视野 (vertical field-of-view)，以度为单位
-        double aspect_ratio
+        Real vfov, // 垂直视野 (vertical field-of-view)，以度为单位
+        Real aspect_ratio
     ) {
         auto theta = degrees_to_radians(vfov);
         auto h = tan(theta/2);
@@ -39,7 +39,7 @@ public:
         lower_left_corner = origin - horizontal/2 - vertical/2 - w;
     }
 
-    Ray get_ray(double s, double t) const {
+    Ray get_ray(Real s, Real t) const {
         return Ray(origin, lower_left_corner + s*horizontal + t*vertical - origin);
     }
 
@@ -0,0 +1,154 @@
+#ifndef DENOISER_H
+#define DENOISER_H
+
+#include "utils.h"
+#include "renderer_common.h"
+#include "gbuffer.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+#include <omp.h>
+
+/**
+* 降噪参数，sigma 越大对应的边缘越容易被抹过去
+*@param enabled      是否降噪
+*@param iterations   À-Trous 的层数，第 i 层的采样间隔是 2^i，5 层覆盖 ±62 像素
+*@param sigma_color  颜色（除掉反照率之后、压缩到 [0,1) 的辐照度）差异的尺度，每一层减半
+*@param sigma_normal 法线差异的尺度
+*@param sigma_depth  相对深度差异的尺度
+*@param sigma_albedo 反照率差异的尺度
+*@param firefly_ratio 亮度超过周围 8 个像素中位数这么多倍的像素当作萤火虫噪点压下去，<= 0 表示不处理
+*/
+struct DenoiseSettings {
+    bool enabled = false;
+    int iterations = 5;
+    Real sigma_color = 0.5;
+    Real sigma_normal = 0.3;
+    Real sigma_depth = 0.05;
+    Real sigma_albedo = 0.3;
+    Real firefly_ratio = 4;
+};
+
+// 反照率的下限，除反照率时防止除以 0（纯黑的表面）
+const Real kDenoiseMinAlbedo = 0.01;
+// B3 样条的一维核，5x5 的 À-Trous 核是它的外积
+const Real kAtrousKernel[3] = {3.0 / 8.0, 1.0 / 4.0, 1.0 / 16.0};
+
+/**
+* 萤火虫噪点：低 spp 下偶尔一条路径打中光源，一个像素比周围亮几十倍。
+* 颜色停止项会把它和周围隔开，滤波之后它还是一个亮点，所以先把亮度压到周围 8 个像素中位数的 ratio 倍
+*/
+inline void suppress_fireflies(int width, int height, std::vector<Color>& image, Real ratio) {
+    std::vector<Color> source = image;
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            Real around[8];
+            int count = 0;
+            for (int dy = -1; dy <= 1; ++dy)
+                for (int dx = -1; dx <= 1; ++dx) {
+                    const int xx = x + dx, yy = y + dy;
+                    if ((dx || dy) && xx >= 0 && xx < width && yy >= 0 && yy < height) around[count++] = luminance(source[yy * width + xx]);
+                }
+            if (count == 0) continue;
+            std::nth_element(around, around + count / 2, around + count);
+            const Real limit = ratio * around[count / 2];
+            const int p = y * width + x;
+            const Real lum = luminance(source[p]);
+            if (lum > limit) image[p] = source[p] * (limit / lum);
+        }
+    }
+}
+
+/**
+* 边缘保持的 À-Trous 小波降噪 (Dammertz et al. 2010)：在第一个交点的反照率、法线、深度引导下，
+* 一层一层地用间隔 2^i 的 5x5 B3 样条核做加权平均，邻居的权重乘上颜色、法线、深度、反照率四个边缘停止项，
+* 跨过几何边缘和材质边缘的邻居几乎不参与平均。
+* 滤波前先除掉反照率（纹理细节不会被抹掉），滤完再乘回来；颜色项在 x/(1+x) 压缩之后比较，个别很亮的噪点不会把周围的权重全部压成 0。
+* 每层按行并行，像素内的运算都是 Vec3 的 SIMD 运算，四个停止项合在一起只算一次 exp
+*@param width, height 图像尺寸
+*@param & hdr         输入输出，累加完的 HDR 图像（色调映射之前），第 0 行是图像顶部
+*@param & guides      同一次渲染的第一个交点缓冲
+*/
+inline void denoise_atrous(int width, int height, std::vector<Color>& hdr, const GBuffer& guides, const DenoiseSettings& settings) {
+    const int n = width * height;
+    std::vector<Color> albedo(n), current(n), next(n), compressed(n);
+    std::vector<Vec3> normal(n);
+    std::vector<Real> depth(n);
+    #pragma omp parallel for schedule(static)
+    for (int p = 0; p < n; ++p) {
+        albedo[p] = component_max(guides.albedo(p), Color(kDenoiseMinAlbedo, kDenoiseMinAlbedo, kDenoiseMinAlbedo));
+        normal[p] = guides.normal(p);
+        depth[p] = guides.depth(p);
+        current[p] = Color(hdr[p].x() / albedo[p].x(), hdr[p].y() / albedo[p].y(), hdr[p].z() / albedo[p].z());
+    }
+    if (settings.firefly_ratio > 0) suppress_fireflies(width, height, current, settings.firefly_ratio);
+
+    const Real inv_normal = 1 / (settings.sigma_normal * settings.sigma_normal);
+    const Real inv_albedo = 1 / (settings.sigma_albedo * settings.sigma_albedo);
+    const Real inv_depth = 1 / settings.sigma_depth;
+    Real sigma_color = settings.sigma_color;
+    // 间隔超过图像尺寸之后再加层也没有邻居了
+    for (int level = 0; level < settings.iterations && (1 << level) < std::max(width, height); ++level) {
+        const int step = 1 << level;
+        const Real inv_color = 1 / (sigma_color * sigma_color);
+        #pragma omp parallel for schedule(static)
+        for (int p = 0; p < n; ++p) {
+            const Color& c = current[p];
+            compressed[p] = c / (1 + luminance(c));
+        }
+        #pragma omp parallel for schedule(dynamic, 4)
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                const int p = y * width + x;
+                const Color cp = compressed[p];
+                const Vec3 np = normal[p];
+                const Color ap = albedo[p];
+                const Real dp = depth[p];
+                Color sum(0, 0, 0);
+                Real weight_sum = 0;
+                for (int dy = -2; dy <= 2; ++dy) {
+                    const int yy = y + dy * step;
+                    if (yy < 0 || yy >= height) continue;
+                    const Real ky = kAtrousKernel[std::abs(dy)];
+                    for (int dx = -2; dx <= 2; ++dx) {
+                        const int xx = x + dx * step;
+                        if (xx < 0 || xx >= width) continue;
+                        const int q = yy * width + xx;
+                        Real e = (cp - compressed[q]).length_squared() * inv_color
+                               + (np - normal[q]).length_squared() * inv_normal
+                               + (ap - albedo[q]).length_squared() * inv_albedo
+                               + std::fabs(dp - depth[q]) / (std::max(dp, depth[q]) + Real(1e-6)) * inv_depth;
+                        Real w = ky * kAtrousKernel[std::abs(dx)] * std::exp(-e);
+                        sum += w * current[q];
+                        weight_sum += w;
+                    }
+                }
+                // 中心像素自己的权重至少是 (3/8)^2，weight_sum 不会是 0
+                next[p] = sum / weight_sum;
+            }
+        }
+        current.swap(next);
+        sigma_color *= 0.5;
+    }
+
+    #pragma omp parallel for schedule(static)
+    for (int p = 0; p < n; ++p) hdr[p] = current[p] * albedo[p];
+}
+
+/**
+* 把累加完的 HDR 图像写进 8 位缓冲区：需要时先降噪，再色调映射 + Gamma 校正
+*@param & guides 第一个交点缓冲，降噪关闭时可以是空的
+*/
+inline void resolve_hdr(int width, int height, std::vector<Color>& hdr, const GBuffer& guides, const DenoiseSettings& settings,
+    std::vector<unsigned char>& buffer) {
+    if (settings.enabled) {
+        if (guides.pixel_count() == width * height) denoise_atrous(width, height, hdr, guides, settings);
+        else std::cerr << "没有第一个交点缓冲，跳过降噪\n";
+    }
+    buffer.resize(size_t(width) * height * 3);
+    for (int p = 0; p < width * height; ++p) store_pixel(buffer, p, hdr[p]);
+}
+
+#endif
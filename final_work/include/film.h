@@ -0,0 +1,290 @@
+#ifndef FILM_H
+#define FILM_H
+
+#include "utils.h"
+#include "renderer_common.h"
+#include "scene.h"
+#include "denoiser.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// 检查点文件的开头，格式变了就换版本号
+const char kFilmMagic[8] = {'R', 'T', 'F', 'I', 'L', 'M', '0', '1'};
+// 每次运行 (run) 占用的样本序号区间：第 r 次运行的样本序号从 r * kFilmRunStride 开始，
+// 不同 run 的样本互不相关，合并之后才是更多的独立样本
+const uint32_t kFilmRunStride = 1u << 24;
+// run 编号的上限，合并时用 64 位掩码记录哪些 run 已经在里面
+const int kFilmMaxRuns = 64;
+
+// 场景的指纹：物体数、每个物体的包围盒、材质数和每个光源的辐射亮度，续算或合并时用来确认是同一个场景
+inline uint64_t scene_signature(const Scene& scene) {
+    uint64_t h = mix_bits(scene.objects.size());
+    auto feed = [&h](Real x) {
+        double d = x;
+        uint64_t bits;
+        std::memcpy(&bits, &d, sizeof(bits));
+        h = mix_bits(h ^ bits);
+    };
+    for (const auto& object : scene.objects) {
+        aabb box;
+        if (!object->bounding_box(0, 0, box)) continue;
+        for (int a = 0; a < 3; ++a) {
+            feed(box.min()[a]);
+            feed(box.max()[a]);
+        }
+    }
+    h = mix_bits(h ^ scene.materials.size());
+    for (const Emitter& e : scene.emitters)
+        for (int a = 0; a < 3; ++a) feed(e.radiance[a]);
+    return h;
+}
+
+// 把一张 HDR 图存成 PFM（三通道 float，小端，从下往上逐行），不做色调映射；pixels 第 0 行是图像顶部
+inline bool save_pfm(const std::string& path, int w, int h, const std::vector<Color>& pixels) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        std::cerr << "无法写入 " << path << std::endl;
+        return false;
+    }
+    out << "PF\n" << w << " " << h << "\n-1.0\n";
+    std::vector<float> row(3 * size_t(w));
+    for (int y = h - 1; y >= 0; --y) {
+        for (int x = 0; x < w; ++x) {
+            const Color& c = pixels[y * w + x];
+            row[3 * x] = static_cast<float>(c.x());
+            row[3 * x + 1] = static_cast<float>(c.y());
+            row[3 * x + 2] = static_cast<float>(c.z());
+        }
+        out.write((char*)row.data(), row.size() * sizeof(float));
+    }
+    return bool(out);
+}
+
+/**
+* 把第一个交点缓冲存成几张 PFM (AOV)，放在主输出旁边：stem_albedo / _normal / _depth / _objid / _matid.pfm
+* 法线存原始的 [-1, 1] 分量，深度和编号三个通道相同，没击中的像素编号是 -1
+* 反照率、法线、深度是像素内所有样本的平均；物体编号和材质编号不能平均，取这个像素第一个记录的样本，
+* 也就是这次运行里样本序号最小的那个（各渲染器按样本序号往 GBuffer 里加，和线程数无关）。
+* 从检查点续算时只有这次运行的样本，PM 限时渲染时是第一轮的样本
+*@param stem 输出路径去掉扩展名
+*@param & guides 渲染时累加好的第一个交点缓冲，像素数要等于 w x h
+*@param & scene 用来把材质换成材质表里的编号
+*/
+inline bool save_aovs(const std::string& stem, int w, int h, const GBuffer& guides, const Scene& scene) {
+    const int n = w * h;
+    if (guides.pixel_count() != n) {
+        std::cerr << "没有第一个交点缓冲，不输出 AOV\n";
+        return false;
+    }
+    std::vector<Color> albedo(n), normal(n), depth(n), object_id(n), material_id(n);
+    for (int p = 0; p < n; ++p) {
+        albedo[p] = guides.albedo(p);
+        normal[p] = guides.normal(p);
+        Real d = guides.depth(p);
+        depth[p] = Color(d, d, d);
+        Real object = guides.object_id(p);
+        object_id[p] = Color(object, object, object);
+        Real material = guides.material(p) ? scene.material_id(guides.material(p)) : -1;
+        material_id[p] = Color(material, material, material);
+    }
+    return save_pfm(stem + "_albedo.pfm", w, h, albedo) && save_pfm(stem + "_normal.pfm", w, h, normal)
+        && save_pfm(stem + "_depth.pfm", w, h, depth) && save_pfm(stem + "_objid.pfm", w, h, object_id)
+        && save_pfm(stem + "_matid.pfm", w, h, material_id);
+}
+
+/**
+* HDR 胶片 (Film)：每个像素的辐射度之和（double，不做色调映射）和样本数，渐进式渲染一遍一遍往里累加
+* 整个状态可以存成检查点文件，进程被杀掉之后从最后一个检查点接着渲染；同一个场景的多次运行 (run) 可以合并
+*@param width, height      图像尺寸
+*@param max_depth, rr_min_bounce, sampler 渲染参数，续算和合并时必须一致
+*@param signature          场景指纹 (scene_signature)
+*@param run_id            这次运行的编号，决定样本序号从哪里开始 (sample_index)
+*@param run_mask          已经累加进来的 run 的集合，合并时防止同一个 run 的样本被加两次
+*@param sum, count        每个像素的 RGB 辐射度之和、样本数
+*/
+class Film {
+public:
+    Film() {}
+    Film(int w, int h, int depth, int rr, const std::string& sampler_name, uint64_t scene_sig, uint32_t run)
+        : width(w), height(h), max_depth(depth), rr_min_bounce(rr), sampler(sampler_name),
+          signature(scene_sig), run_id(run), run_mask(uint64_t(1) << run),
+          sum(3 * size_t(w) * h, 0.0), count(size_t(w) * h, 0) {}
+
+    int pixel_count() const { return width * height; }
+
+    // 这次运行第 n 个样本的序号
+    uint32_t sample_index(uint32_t n) const { return run_id * kFilmRunStride + n; }
+
+    void add(int pixel, const Color& c) {
+        sum[3 * pixel] += c.x();
+        sum[3 * pixel + 1] += c.y();
+        sum[3 * pixel + 2] += c.z();
+        ++count[pixel];
+    }
+
+    Color mean(int pixel) const {
+        if (count[pixel] == 0) return Color(0, 0, 0);
+        double inv = 1.0 / count[pixel];
+        return Color(sum[3 * pixel] * inv, sum[3 * pixel + 1] * inv, sum[3 * pixel + 2] * inv);
+    }
+
+    uint32_t min_count() const {
+        uint32_t m = UINT32_MAX;
+        for (uint32_t c : count) m = std::min(m, c);
+        return count.empty() ? 0 : m;
+    }
+
+    long long total_samples() const {
+        long long n = 0;
+        for (uint32_t c : count) n += c;
+        return n;
+    }
+
+    /**
+    判断另一张胶片能不能和这张续算或合并：尺寸、渲染参数和场景都要一样
+    *@param & why 不一致时写入原因
+    */
+    bool compatible(const Film& o, std::string& why) const {
+        if (width != o.width || height != o.height) why = "图像尺寸不同";
+        else if (max_depth != o.max_depth || rr_min_bounce != o.rr_min_bounce) why = "渲染参数 (max_depth / rr) 不同";
+        else if (sampler != o.sampler) why = "采样器不同 (" + sampler + " / " + o.sampler + ")";
+        else if (signature != o.signature) why = "场景不同";
+        else return true;
+        return false;
+    }
+
+    /**
+    判断能不能从另一张胶片（检查点）续算：除了 compatible 的条件，run 编号也要一样，
+    否则续算出来的样本序号接在别的 run 后面，和以后用这个编号渲染的运行撞车
+    *@param & why 不一致时写入原因
+    */
+    bool can_resume(const Film& o, std::string& why) const {
+        if (!compatible(o, why)) return false;
+        if (run_id != o.run_id) {
+            why = "run 编号不同 (" + std::to_string(run_id) + " / " + std::to_string(o.run_id) + ")";
+            return false;
+        }
+        return true;
+    }
+
+    // 合并另一次运行的样本，两边包含同一个 run 时拒绝（那些样本是相同的，加两次没有意义）
+    bool merge(const Film& o) {
+        std::string why;
+        if (!compatible(o, why)) {
+            std::cerr << "无法合并: " << why << std::endl;
+            return false;
+        }
+        if (run_mask & o.run_mask) {
+            std::cerr << "无法合并: 两边包含同一个 run 的样本，请用不同的 --run-id 渲染" << std::endl;
+            return false;
+        }
+        for (size_t i = 0; i < sum.size(); ++i) sum[i] += o.sum[i];
+        for (size_t i = 0; i < count.size(); ++i) count[i] += o.count[i];
+        run_mask |= o.run_mask;
+        return true;
+    }
+
+    // 先写临时文件再改名，写到一半被杀掉也不会损坏上一个检查点
+    bool save(const std::string& path) const {
+        std::string tmp = path + ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::binary);
+            if (!out) {
+                std::cerr << "无法写入检查点 " << tmp << std::endl;
+                return false;
+            }
+            char name[16] = {};
+            std::strncpy(name, sampler.c_str(), sizeof(name) - 1);
+            out.write(kFilmMagic, sizeof(kFilmMagic));
+            out.write((char*)&width, sizeof(int));
+            out.write((char*)&height, sizeof(int));
+            out.write((char*)&max_depth, sizeof(int));
+            out.write((char*)&rr_min_bounce, sizeof(int));
+            out.write(name, sizeof(name));
+            out.write((char*)&signature, sizeof(uint64_t));
+            out.write((char*)&run_id, sizeof(uint32_t));
+            out.write((char*)&run_mask, sizeof(uint64_t));
+            out.write((char*)count.data(), count.size() * sizeof(uint32_t));
+            out.write((char*)sum.data(), sum.size() * sizeof(double));
+            if (!out) {
+                std::cerr << "写入检查点 " << tmp << " 失败" << std::endl;
+                return false;
+            }
+        }
+        if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+            std::cerr << "无法把 " << tmp << " 改名为 " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool load(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            std::cerr << "无法打开 " << path << std::endl;
+            return false;
+        }
+        char magic[8];
+        in.read(magic, sizeof(magic));
+        if (!in || std::memcmp(magic, kFilmMagic, sizeof(magic)) != 0) {
+            std::cerr << path << " 不是检查点文件 (或者版本不对)" << std::endl;
+            return false;
+        }
+        char name[16];
+        in.read((char*)&width, sizeof(int));
+        in.read((char*)&height, sizeof(int));
+        in.read((char*)&max_depth, sizeof(int));
+        in.read((char*)&rr_min_bounce, sizeof(int));
+        in.read(name, sizeof(name));
+        in.read((char*)&signature, sizeof(uint64_t));
+        in.read((char*)&run_id, sizeof(uint32_t));
+        in.read((char*)&run_mask, sizeof(uint64_t));
+        if (!in || width <= 0 || height <= 0 || run_id >= uint32_t(kFilmMaxRuns)) {
+            std::cerr << path << " 文件头损坏" << std::endl;
+            return false;
+        }
+        name[sizeof(name) - 1] = '\0';
+        sampler = name;
+        count.resize(pixel_count());
+        sum.resize(3 * size_t(pixel_count()));
+        in.read((char*)count.data(), count.size() * sizeof(uint32_t));
+        in.read((char*)sum.data(), sum.size() * sizeof(double));
+        if (!in) {
+            std::cerr << path << " 数据不完整" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // 色调映射 + Gamma 校正到 8 位缓冲区；打开降噪时先用第一个交点缓冲引导降噪（胶片本身不变）
+    void resolve(std::vector<unsigned char>& buffer, const GBuffer& guides = GBuffer(), const DenoiseSettings& denoise = DenoiseSettings()) const {
+        std::vector<Color> hdr(pixel_count());
+        for (int p = 0; p < pixel_count(); ++p) hdr[p] = mean(p);
+        resolve_hdr(width, height, hdr, guides, denoise, buffer);
+    }
+
+    // 把每个像素的平均辐射度存成 PFM
+    bool write_pfm(const std::string& path) const {
+        std::vector<Color> pixels(pixel_count());
+        for (int p = 0; p < pixel_count(); ++p) pixels[p] = mean(p);
+        return save_pfm(path, width, height, pixels);
+    }
+
+    int width = 0;
+    int height = 0;
+    int max_depth = 0;
+    int rr_min_bounce = 0;
+    std::string sampler;
+    uint64_t signature = 0;
+    uint32_t run_id = 0;
+    uint64_t run_mask = 0;
+    std::vector<double> sum;
+    std::vector<uint32_t> count;
+};
+
+#endif
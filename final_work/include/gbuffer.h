@@ -0,0 +1,84 @@
+#ifndef GBUFFER_H
+#define GBUFFER_H
+
+#include "utils.h"
+#include "renderer_common.h"
+#include <algorithm>
+#include <vector>
+
+/**
+* 相机光线第一个交点的信息，降噪的引导和 AOV 输出都用它
+*@param albedo    表面的反照率（纹理求值之后），镜面和玻璃是 1，光源是 1，没击中也是 1
+*@param normal    朝向相机一侧的法线，没击中是 0
+*@param depth     交点到相机的距离，没击中是 0
+*@param object_id 击中的顶层物体编号 (prim_id)，没击中是 -1
+*@param material  击中的材质，输出时再换成场景材质表里的编号，没击中是 nullptr
+*/
+struct FirstHit {
+    Color albedo = Color(1, 1, 1);
+    Vec3 normal = Vec3(0, 0, 0);
+    Real depth = 0;
+    int object_id = -1;
+    const Material* material = nullptr;
+};
+
+// 从相机光线和它的第一个交点取出 FirstHit
+inline FirstHit first_hit(const Ray& r, const HitRecord& rec) {
+    FirstHit h;
+    std::pair<Refl_t, Color> feature = get_feature(rec);
+    // 光源的 get_feature 是发光颜色，可能远大于 1，不能当反照率
+    if (feature.first == DIFF && rec.mat_ptr && rec.mat_ptr->type != MaterialType::DiffuseLight) h.albedo = feature.second;
+    h.normal = rec.normal;
+    h.depth = rec.t * r.direction().length();
+    h.object_id = rec.prim_id;
+    h.material = rec.mat_ptr;
+    return h;
+}
+
+/**
+* 第一个交点的缓冲 (G-buffer)：每个像素把它所有样本的 FirstHit 加起来，取平均就是抗锯齿之后的引导图
+* 编号没法平均，物体编号和材质取这个像素第一个样本的（样本按序号累加，和线程数无关）
+* 每个像素同一时刻只由一个线程写（分块调度下像素不共享），不需要同步
+*@brief add(pixel, hit) 累加一个样本；albedo(p) / normal(p) / depth(p) 取平均，object_id(p) / material(p) 是第一个样本的，
+*       没有样本的像素是 FirstHit 的默认值
+*/
+class GBuffer {
+public:
+    void resize(int pixels) {
+        albedo_sum.assign(pixels, Color(0, 0, 0));
+        normal_sum.assign(pixels, Vec3(0, 0, 0));
+        depth_sum.assign(pixels, 0.0);
+        object_ids.assign(pixels, -1);
+        materials.assign(pixels, nullptr);
+        count.assign(pixels, 0);
+    }
+
+    int pixel_count() const { return static_cast<int>(count.size()); }
+
+    void add(int pixel, const FirstHit& h) {
+        albedo_sum[pixel] += h.albedo;
+        normal_sum[pixel] += h.normal;
+        depth_sum[pixel] += h.depth;
+        if (count[pixel] == 0) {
+            object_ids[pixel] = h.object_id;
+            materials[pixel] = h.material;
+        }
+        ++count[pixel];
+    }
+
+    Color albedo(int p) const { return count[p] ? albedo_sum[p] / count[p] : FirstHit().albedo; }
+    Vec3 normal(int p) const { return count[p] ? normal_sum[p] / count[p] : FirstHit().normal; }
+    Real depth(int p) const { return count[p] ? depth_sum[p] / count[p] : FirstHit().depth; }
+    int object_id(int p) const { return object_ids[p]; }
+    const Material* material(int p) const { return materials[p]; }
+
+private:
+    std::vector<Color> albedo_sum;
+    std::vector<Vec3> normal_sum;
+    std::vector<double> depth_sum;
+    std::vector<int> object_ids;
+    std::vector<const Material*> materials;
+    std::vector<int> count;
+};
+
+#endif
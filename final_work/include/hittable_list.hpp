@@ -25,8 +25,22 @@ public:
     //add 方法，向列表中添加一个支持光追的物体
     void add(shared_ptr<HittableObj> object) { objects.push_back(object); }
 
-    virtual bool hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const override;
-    virtual bool bounding_box(double time0, double time1, aabb& output_box) const override;
+    virtual bool intersect(const Ray& r, Real t_min, Real t_max, PrimHit& hit) const override;
+    virtual bool bounding_box(Real time0, Real time1, aabb& output_box) const override;
+    virtual void hit_packet(const RayPacket& packet, uint32_t active, Real t_min, PacketHits& hits) const override;
+    virtual uint32_t occluded_packet(const RayPacket& packet, uint32_t active, Real t_min, const Real* t_max) const override;
+    virtual void assign_prim_id(int id) override {
+        prim_id = id;
+        for (const auto& object : objects) object->assign_prim_id(id);
+    }
+    virtual void collect_materials(std::vector<const Material*>& out) const override {
+        for (const auto& object : objects) object->collect_materials(out);
+    }
+    virtual Real area() const override {
+        Real sum = 0;
+        for (const auto& object : objects) sum += object->area();
+        return sum;
+    }
 };
 
 //迭代检测光线与场景中所有物体的相交情况，这里还不涉及反射，只是检测相交，处理遮挡。t就是光线的参数。
@@ -34,26 +48,43 @@ public:
 *@param & r 入射光线
 *@param t_min 最小 t 值，防止自相交
 *@param t_max 最大 t 值 ，一开始是infty,会随着击中物体的距离变小而更新
-*@param & rec 用于存储相交信息的 HitRecord 结构体
+*@param & hit 用于存储最近交点的 PrimHit，拷贝它只是几个数，不涉及材质指针的引用计数
 *@return 如果光线与任意物体相交，返回 true 并填充
 */
-bool HittableObjList::hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const {
-    HitRecord temp_rec;
+bool HittableObjList::intersect(const Ray& r, Real t_min, Real t_max, PrimHit& hit) const {
+    PrimHit temp_hit;
     bool hitFirstObj = false;//是否击中第一个物体 
-    double closest2Camera = t_max;
+    Real closest2Camera = t_max;
     //注意这里传入的是引用，减小内存开销，这个在物体多的时候巨慢。
     for (const auto& object : objects) {
-        if (object->hit(r, t_min, closest2Camera, temp_rec)) {
+        if (object->intersect(r, t_min, closest2Camera, temp_hit)) {
             hitFirstObj = true;
-            closest2Camera = temp_rec.t;
-            rec = temp_rec;
+            closest2Camera = temp_hit.t;
+            hit = temp_hit;
         }
     }
 
     return hitFirstObj;
 }
 
-bool HittableObjList::bounding_box(double time0, double time1, aabb& output_box) const {
+// 光线包和每个物体整包求交，hits.t 随着更近的交点不断缩小
+void HittableObjList::hit_packet(const RayPacket& packet, uint32_t active, Real t_min, PacketHits& hits) const {
+    for (const auto& object : objects) {
+        object->hit_packet(packet, active, t_min, hits);
+    }
+}
+
+// 遮挡测试：被前面的物体挡住的光线不再和后面的物体测，全部挡住就停
+uint32_t HittableObjList::occluded_packet(const RayPacket& packet, uint32_t active, Real t_min, const Real* t_max) const {
+    uint32_t blocked = 0;
+    for (const auto& object : objects) {
+        blocked |= object->occluded_packet(packet, active & ~blocked, t_min, t_max);
+        if (blocked == active) break;
+    }
+    return blocked;
+}
+
+bool HittableObjList::bounding_box(Real time0, Real time1, aabb& output_box) const {
     if (objects.empty()) return false;
 
     aabb temp_box;
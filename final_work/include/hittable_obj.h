@@ -4,26 +4,33 @@
 #include "ray.h"
 #include "utils.h"
 #include "aabb.h"
+#include "ray_packet.h"
+#include <algorithm>
+#include <vector>
 
 class Material;
 
+class HittableObj;
+
 /**
 * 结构体，用于存储光线与物体相交时的信息
 *@param p         相交点位置
 *@param normal    相交点处的法线
-*@param mat_ptr   相交点处的材质指针
+*@param mat_ptr   相交点处的材质指针，不持有所有权（材质由物体的 shared_ptr 持有），拷贝时没有引用计数开销
 *@param t         光线参数 t，在光线方程 P(t) = origin + t*direction 中,一开始是无穷大。
 *@param front_face 布尔值，指示光线是否击中物体的前面
+*@param prim_id   击中图元的编号（场景顶层物体列表里的下标），没有编号时是 -1
 *@brief set_face_normal(r, outward_normal) 根据光线方向和外法线设置 front_face 和 normal
 */
 struct HitRecord {
     Point3 p;
     Vec3 normal;
-    shared_ptr<Material> mat_ptr;
-    double t;
-    double u;
-    double v;
+    const Material* mat_ptr = nullptr;
+    Real t;
+    Real u;
+    Real v;
     bool front_face;
+    int prim_id = -1;
     /**
     光线与物体相交时，设置法线方向和前后面标志
     *@param & r 入射光线
@@ -35,14 +42,87 @@ struct HitRecord {
         //如果光线击中了物体的前面，法线保持不变，否则取反
         normal = front_face ? outward_normal : -outward_normal;
     }
+    /**
+    从交点出发生成新光线，起点沿法线往 dir 所在的一侧偏移一点，防止自相交
+    偏移量和交点坐标的量级成正比，float 精度下大坐标处的交点误差也能盖住
+    *@param & dir 新光线的方向
+    */
+    inline Ray spawn_ray(const Vec3& dir) const {
+        Real scale = 1 + std::max({std::fabs(p.x()), std::fabs(p.y()), std::fabs(p.z())});
+        Vec3 offset = (kOriginOffset * scale) * normal;
+        return Ray(dot(dir, normal) > 0 ? p + offset : p - offset, dir);
+    }
+};
+
+/**
+* 轻量的求交结果：遍历过程中只记录 t、击中的图元和重心坐标，
+* 交点、法线、uv、材质这些等确定是最近交点之后再由图元的 surface_interaction 补全
+*@param t         光线参数 t
+*@param prim      击中的图元（叶子物体），不持有所有权
+*@param sub_index 图元内部的编号，比如 SphereSet 里的第几个球，普通图元是 0
+*@param b1,b2     重心坐标（三角形的 u,v），球体不用
+*/
+struct PrimHit {
+    Real t = infinity;
+    const HittableObj* prim = nullptr;
+    int sub_index = 0;
+    Real b1 = 0;
+    Real b2 = 0;
+};
+
+/**
+* 光线包的求交结果，每条光线一份
+*@param hit  每条光线最近交点的 PrimHit
+*@param t    每条光线当前最近交点的 t，初始为 infinity，遍历时作为该光线的 t_max
+*@param mask 击中了物体的光线掩码
+*@brief surface(packet, k, rec) 补全第 k 条光线的 HitRecord
+*/
+struct PacketHits {
+    PrimHit hit[RayPacket::kMaxSize];
+    Real t[RayPacket::kMaxSize];
+    uint32_t mask = 0;
+
+    PacketHits() {
+        for (int k = 0; k < RayPacket::kMaxSize; ++k) t[k] = infinity;
+    }
+
+    // 当前所有活跃光线 t 的最大值，视锥剔除用
+    Real max_t(const RayPacket& p, uint32_t active) const {
+        Real m = -infinity;
+        for (int k = 0; k < p.size; ++k)
+            if ((active & (1u << k)) && t[k] > m) m = t[k];
+        return m;
+    }
+
+    inline void surface(const RayPacket& p, int k, HitRecord& rec) const;
 };
 
 /** 
 * HittableObj 类，所有能发生光追的物体都应继承自此类
-*@brief hit(r, t_min, t_max, rec) 判断光线 r 是否与物体相交
+* 求交分成两步：intersect 只算 t 和图元编号（遍历中每个候选交点都要调用，必须便宜），
+* surface_interaction 只对最终的最近交点调用一次，计算交点、法线、uv 和材质
+*@brief hit(r, t_min, t_max, rec) 判断光线 r 是否与物体相交，等于 intersect + surface_interaction
 */
 class HittableObj {
 public:
+    /** 
+    *intersect 函数，判断光线与物体是否相交，只填 PrimHit
+    *@param & r 入射光线
+    *@param t_min 最小 t 值，防止自相交
+    *@param t_max 最大 t 值
+    *@param & hit 用于存储 t 和图元的 PrimHit
+    *@return 如果光线与物体相交，返回 true 并填充 hit，否则返回 false
+    */
+    virtual bool intersect(const Ray& r, Real t_min, Real t_max, PrimHit& hit) const = 0;
+
+    /**
+    延迟计算表面信息，只有叶子图元需要实现（物体列表和 BVH 返回的 hit.prim 都是叶子）
+    *@param & r 入射光线
+    *@param & hit intersect 得到的最近交点
+    *@param & rec 输出完整的 HitRecord
+    */
+    virtual void surface_interaction(const Ray& r, const PrimHit& hit, HitRecord& rec) const {}
+
     /** 
     *hit 函数，判断光线与物体是否相交
     *@param & r 入射光线
@@ -51,10 +131,75 @@ public:
     *@param & rec 用于存储相交信息的 HitRecord 结构体
     *@return 如果光线与物体相交，返回 true 并填充 rec，否则返回 false
     */
-    virtual bool hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const = 0;
+    bool hit(const Ray& r, Real t_min, Real t_max, HitRecord& rec) const {
+        PrimHit h;
+        if (!intersect(r, t_min, t_max, h)) return false;
+        h.prim->surface_interaction(r, h, rec);
+        rec.prim_id = h.prim->prim_id;
+        return true;
+    }
+
+    /**
+    设置图元编号，物体列表和 BVH 会把编号传给所有子物体，
+    这样嵌套在网格、BVH 里的三角形击中时也能报告它所属顶层物体的编号
+    */
+    virtual void assign_prim_id(int id) { prim_id = id; }
+
+    int prim_id = -1; // 所属顶层物体在场景物体列表里的下标
+
+    /**
+    收集物体用到的材质（不持有所有权），场景 commit 时用来建材质表、找出发光体
+    物体列表和 BVH 会递归收集子物体的材质
+    */
+    virtual void collect_materials(std::vector<const Material*>& out) const {}
+
+    // 表面积，发光体的功率和光源采样分布要用到，不支持做光源的物体返回 0
+    virtual Real area() const { return 0; }
+
+    virtual bool bounding_box(Real time0, Real time1, aabb& output_box) const = 0;
+    //intersect函数不应该在这里实现，因为每个具体的物体都有不同的相交逻辑，如果在这里实现就失去了多态性。
 
-    virtual bool bounding_box(double time0, double time1, aabb& output_box) const = 0;
-    //hit函数不应该在这里实现，因为每个具体的物体都有不同的相交逻辑，如果在这里实现就失去了多态性。
+    /**
+    光线包求交，只处理 active 里的光线，找到更近的交点就更新 hits
+    默认实现就是逐条调用 intersect，BVH、物体列表和球体会重写成整包处理
+    *@param & packet 光线包
+    *@param active 参与求交的光线掩码
+    *@param t_min 最小 t 值
+    *@param & hits 每条光线的求交结果，hits.t 同时是每条光线的 t_max
+    */
+    virtual void hit_packet(const RayPacket& packet, uint32_t active, Real t_min, PacketHits& hits) const {
+        for (int k = 0; k < packet.size; ++k) {
+            if (!(active & (1u << k))) continue;
+            if (intersect(packet.ray(k), t_min, hits.t[k], hits.hit[k])) {
+                hits.t[k] = hits.hit[k].t;
+                hits.mask |= (1u << k);
+            }
+        }
+    }
+
+    /**
+    光线包遮挡测试 (any-hit)：active 里的每条光线只问 (t_min, t_max[k]) 内有没有东西，不找最近交点
+    默认实现就是逐条调用 intersect，BVH、物体列表和球体会重写：已经被挡住的光线从活跃掩码里去掉，全被挡住就提前返回
+    *@param & packet 光线包
+    *@param active 参与测试的光线掩码
+    *@param t_min 最小 t 值
+    *@param t_max 每条光线的最大 t，长度为 RayPacket::kMaxSize
+    *@return 被挡住的光线掩码，是 active 的子集
+    */
+    virtual uint32_t occluded_packet(const RayPacket& packet, uint32_t active, Real t_min, const Real* t_max) const {
+        uint32_t blocked = 0;
+        for (int k = 0; k < packet.size; ++k) {
+            if (!(active & (1u << k))) continue;
+            PrimHit h;
+            if (intersect(packet.ray(k), t_min, t_max[k], h)) blocked |= (1u << k);
+        }
+        return blocked;
+    }
 };
 
+inline void PacketHits::surface(const RayPacket& p, int k, HitRecord& rec) const {
+    hit[k].prim->surface_interaction(p.ray(k), hit[k], rec);
+    rec.prim_id = hit[k].prim->prim_id;
+}
+
 #endif
@@ -5,20 +5,34 @@
 #include "ray.h"
 #include "hittable_obj.h"
 #include "texture.hpp"
+#include "sampler.h"
+#include "sampling.h"
 
 // struct HitRecord;
 
+// 材质类型标签：光子映射的几条路径按标签分支，用 static_cast 拿到具体材质，不走 RTTI
+enum class MaterialType { Lambertian, Metal, Dielectric, DiffuseLight };
+
 /**
 *材质基类，所有材质都应继承自此类
 *材质决定了光线与物体表面交互的方式。
+*@param type 材质类型标签，由子类构造时设置，之后不再改变
 *@brief emitted，表示材质发光（如光源材质）
 *@brief scatter，它决定了入射光线 (r_in) 如何变成成新的光线 (scatteredRay)，以及光线被衰减了多少 (attenuation或albedo)。
+*       随机决策从 sampler 取样本；不传 sampler 的版本用独立随机数，光子路径用
+*@brief eval / pdf，BSDF 的值和 scatter 采样方向的概率密度，路径追踪做光源采样 (NEE) 和 MIS 用
+*@brief is_specular，没有可以求值的 BSDF（镜面、折射、发光体），这种表面不做光源采样
 */
 class Material {
 public:
+    explicit Material(MaterialType t) : type(t) {}
+    virtual ~Material() {}
+
+    const MaterialType type;
+
     //emitted: 发射光线的颜色（对于自发光材质）,默认是黑色
     //这里用u,v参数是为了和纹理接口统一
-    virtual Color emitted(double u, double v, const Point3& p) const {
+    virtual Color emitted(Real u, Real v, const Point3& p) const {
         return Color(0, 0, 0);
     }
 
@@ -26,11 +40,40 @@ public:
     // rec: 撞击点记录（包含位置、法线等）
     // attenuation: 颜色衰减（反射率/颜色）
     // scatteredRay: 交互后的新光线
+    // sampler: 采样器，已经切到当前这次反弹的维度块
     virtual bool scatter(
-        const Ray& r_in, const HitRecord& rec, Color& attenuation, Ray& scatteredRay
+        const Ray& r_in, const HitRecord& rec, Color& attenuation, Ray& scatteredRay, Sampler& sampler
     ) const = 0;
+
+    bool scatter(const Ray& r_in, const HitRecord& rec, Color& attenuation, Ray& scatteredRay) const {
+        return scatter(r_in, rec, attenuation, scatteredRay, fallback_sampler());
+    }
+
+    // wo: 指向观察者的单位方向（入射光线反过来），wi: 指向光源的单位方向
+    // eval 返回 BSDF f_r(wo, wi)，不含余弦项
+    virtual Color eval(const HitRecord& rec, const Vec3& wo, const Vec3& wi) const {
+        return Color(0, 0, 0);
+    }
+
+    // scatter 采到 wi 的概率密度（对立体角）
+    virtual Real pdf(const HitRecord& rec, const Vec3& wo, const Vec3& wi) const {
+        return 0;
+    }
+
+    virtual bool is_specular() const {
+        return true;
+    }
 };
 
+/**
+* 按标签把材质指针转成具体类型，类型不对返回 nullptr，用法和 dynamic_cast 一样，但只比较一个整数
+* T 必须有 static constexpr MaterialType kType
+*/
+template <typename T>
+inline const T* material_as(const Material* m) {
+    return (m && m->type == T::kType) ? static_cast<const T*>(m) : nullptr;
+}
+
 /**
 * 漫射光源材质 (Diffuse Light)模拟自发光的材质，如灯光
 * DiffuseLight 构造函数：传入发光颜色或颜色指针
@@ -39,17 +82,19 @@ public:
 */
 class DiffuseLight : public Material {
 public:
+    static constexpr MaterialType kType = MaterialType::DiffuseLight;
+
     //传入颜色指针或者颜色值
-    DiffuseLight(shared_ptr<Texture> a) : emit(a) {}
-    DiffuseLight(Color c) : emit(make_shared<SolidColor>(c)) {}
+    DiffuseLight(shared_ptr<Texture> a) : Material(kType), emit(a) {}
+    DiffuseLight(Color c) : Material(kType), emit(make_shared<SolidColor>(c)) {}
 
     virtual bool scatter(
-        const Ray& r_in, const HitRecord& rec, Color& attenuation, Ray& scatteredRay) const override {
+        const Ray& r_in, const HitRecord& rec, Color& attenuation, Ray& scatteredRay, Sampler& sampler) const override {
         return false; // 光源不散射光线，只发光
     }
 
-    virtual Color emitted(double u, double v, const Point3& p) const override {
-        return emit->value(u, v, p);
+    virtual Color emitted(Real u, Real v, const Point3& p) const override {
+        return eval_texture(emit.get(), u, v, p);
     }
 
 public:
@@ -59,30 +104,53 @@ public:
 
 /*漫反射材质 (Lambertian)模拟粗糙表面，光线向各个方向随机散射
 * Lambertian 构造函数：传入漫反射颜色
-* scatter 函数实现：漫反射散射方向：法线方向 + 单位球内的随机向量
-* 这近似了朗伯余弦定律 (Lambert's Cosine Law)
+* scatter 函数实现：漫反射散射方向：以法线为轴的余弦加权半球采样
+* 这正好是朗伯余弦定律 (Lambert's Cosine Law) 的分布
 */
 class Lambertian : public Material {
 public:
+    static constexpr MaterialType kType = MaterialType::Lambertian;
+
     //构造函数，传入漫反射颜色
-    Lambertian(const Color& a) : albedo(make_shared<SolidColor>(a)) {}
-    Lambertian(shared_ptr<Texture> a) : albedo(a) {}
+    Lambertian(const Color& a) : Material(kType), albedo(make_shared<SolidColor>(a)) {}
+    Lambertian(shared_ptr<Texture> a) : Material(kType), albedo(a) {}
 
     //返回bool,修改scatterray的方向（但并不改颜色）
-    virtual bool scatter(const Ray& r_in, const HitRecord& rec, Color& attenuation, Ray& scatteredRay) const override {
-        // 漫反射散射方向：法线方向 + 单位球内的随机向量
-        // 这近似了朗伯余弦定律 (Lambert's Cosine Law)
-        auto scatter_direction = rec.normal + random_unit_vector();
+    virtual bool scatter(const Ray& r_in, const HitRecord& rec, Color& attenuation, Ray& scatteredRay, Sampler& sampler) const override {
+        // 漫反射散射方向：法线局部坐标系里的余弦加权半球采样，
+        // 和原来的 "法线 + 单位球面上的随机向量" 分布相同，但不会出现退化的零向量
+        return scatter_with_albedo(rec, eval_texture(albedo.get(), rec.u, rec.v, rec.p), attenuation, scatteredRay, sampler);
+    }
 
-        // 捕获退化散射方向（如果随机向量正好与法线相反，结果接近零）
-        if (scatter_direction.near_zero())
-            scatter_direction = rec.normal;
+    virtual Color eval(const HitRecord& rec, const Vec3& wo, const Vec3& wi) const override {
+        if (dot(wi, rec.normal) <= 0) return Color(0, 0, 0);
+        return eval_with_albedo(rec, eval_texture(albedo.get(), rec.u, rec.v, rec.p), wi);
+    }
+
+    // 反照率已经求好时的 scatter / eval（wavefront 按材质分组后用 eval_texture_batch 批量求纹理），随机数的用法和结果都不变
+    bool scatter_with_albedo(const HitRecord& rec, const Color& a, Color& attenuation, Ray& scatteredRay, Sampler& sampler) const {
+        Real u1, u2;
+        sampler.get_2d(u1, u2);
+        Vec3 scatter_direction = Onb(rec.normal).to_world(sample_cosine_hemisphere(u1, u2));
 
-        scatteredRay = Ray(rec.p, scatter_direction);
-        attenuation = albedo->value(rec.u, rec.v, rec.p);
+        scatteredRay = rec.spawn_ray(scatter_direction);
+        attenuation = a;
         return true;
     }
 
+    Color eval_with_albedo(const HitRecord& rec, const Color& a, const Vec3& wi) const {
+        if (dot(wi, rec.normal) <= 0) return Color(0, 0, 0);
+        return a * (1.0 / pi);
+    }
+
+    virtual Real pdf(const HitRecord& rec, const Vec3& wo, const Vec3& wi) const override {
+        return cosine_hemisphere_pdf(dot(wi, rec.normal));
+    }
+
+    virtual bool is_specular() const override {
+        return false;
+    }
+
 public:
     shared_ptr<Texture> albedo;
 };
@@ -94,17 +162,22 @@ public:
 */
 class Metal : public Material {
 public:
+    static constexpr MaterialType kType = MaterialType::Metal;
+
     //传入颜色和模糊因子f
-    Metal(const Color& a, double f) : albedo(a), fuzz(f < 1 ? f : 1) {}
+    Metal(const Color& a, Real f) : Material(kType), albedo(a), fuzz(f < 1 ? f : 1) {}
 
     virtual bool scatter(
-        const Ray& r_in, const HitRecord& rec, Color& attenuation, Ray& scatteredRay
+        const Ray& r_in, const HitRecord& rec, Color& attenuation, Ray& scatteredRay, Sampler& sampler
     ) const override {
         // 计算反射向量，直接用reflect函数
         Vec3 reflected = reflect(unit_vector(r_in.direction()), rec.normal);
         
-        // 加上模糊因子 (fuzz)
-        scatteredRay = Ray(rec.p, reflected + fuzz * random_in_unit_sphere());
+        // 加上模糊因子 (fuzz)：单位球内均匀的一点
+        Real u1, u2;
+        sampler.get_2d(u1, u2);
+        Vec3 in_sphere = sample_uniform_ball(u1, u2, sampler.get_1d());
+        scatteredRay = rec.spawn_ray(reflected + fuzz * in_sphere);
         attenuation = albedo;
         
         // 只有当散射光线与法线在同一侧时才算有效反射
@@ -113,7 +186,7 @@ public:
 
 public:
     Color albedo;
-    double fuzz;// 模糊因子，范围 [0, 1]
+    Real fuzz;// 模糊因子，范围 [0, 1]
 };
 
 /**  绝缘体/电介质材质 (Dielectric)模拟玻璃，发生折射和反射
@@ -122,47 +195,49 @@ public:
 */
 class Dielectric : public Material {
 public:
-    Dielectric(double index_of_refraction, Color absorb = Color(0,0,0)) //absorb用于Beer's Law
-        : ir(index_of_refraction), absorbance(absorb) {}//ir: 折射率之比
+    static constexpr MaterialType kType = MaterialType::Dielectric;
+
+    Dielectric(Real index_of_refraction, Color absorb = Color(0,0,0)) //absorb用于Beer's Law
+        : Material(kType), ir(index_of_refraction), absorbance(absorb) {}//ir: 折射率之比
 
     virtual bool scatter(
-        const Ray& r_in, const HitRecord& rec, Color& attenuation, Ray& scatteredRay
+        const Ray& r_in, const HitRecord& rec, Color& attenuation, Ray& scatteredRay, Sampler& sampler
     ) const override {       
         // 啤酒瓶定律（Beer's Law），这个对于有色玻璃才有用，我的透明玻璃球相当于else分支
         // 如果光线在介质内部传播 (!rec.front_face)，则根据距离衰减
         if (!rec.front_face) {
             // 距离是 rec.t，光线在介质中的传播距离
-            double r = exp(-absorbance.x() * rec.t);
-            double g = exp(-absorbance.y() * rec.t);
-            double b = exp(-absorbance.z() * rec.t);
+            Real r = exp(-absorbance.x() * rec.t);
+            Real g = exp(-absorbance.y() * rec.t);
+            Real b = exp(-absorbance.z() * rec.t);
             attenuation = Color(r, g, b);
         } else {//光不穿过介质就不被吸收
             attenuation = Color(1.0, 1.0, 1.0);
         }
         // 如果是光击中前向面（从外部射入），折射率比是 1.0/ir
         // 如果是光击中背面（从内部射出），折射率比是 ir
-        double refr_ratio = rec.front_face ? (1.0/ir) : ir;
+        Real refr_ratio = rec.front_face ? (1.0/ir) : ir;
 
         Vec3 unit_dir = unit_vector(r_in.direction());//入射光线单位向量
         // 计算 cos(theta) 和 sin(theta) 用于判断全内反射
         //注意这里的入射光线无论是反射还是折射，都是和法线夹钝角，所以unit_dir需要取负号。
-        double cos_theta = fmin(dot(-unit_dir, rec.normal), 1.0);
-        double sin_theta = sqrt(1.0 - cos_theta*cos_theta);
+        Real cos_theta = fmin(dot(-unit_dir, rec.normal), 1.0);
+        Real sin_theta = sqrt(1.0 - cos_theta*cos_theta);
         // 判断是否发生全内反射,当光线从高折射率介质射向低折射率介质，且入射角足够大时，无法折射 
         bool cannot_refract = refr_ratio * sin_theta > 1.0;
         Vec3 direction;
         // 菲涅尔效应 (Fresnel Effect) 近似
         //使用重要性采样 (Importance Sampling) ,参考 smallpt，人为增加反射的采样概率，然后通过权重补偿
-        double refl_prob = reflectance_schlick(cos_theta, refr_ratio);//用Schlick近似计算反射率
+        Real refl_prob = reflectance_schlick(cos_theta, refr_ratio);//用Schlick近似计算反射率
         if (cannot_refract) {
             direction = reflect(unit_dir, rec.normal);
         }
         else {
             // 保证至少有 25% 的概率采样反射
-            double P = 0.25 + 0.5 * refl_prob; 
-            double RP = refl_prob / P;  // 反射路径的权重补偿
-            double TP = (1.0 - refl_prob) / (1.0 - P); // 折射路径的权重补偿
-            if (random_double() < P) {//俄罗斯轮盘赌选择反射还是折射，这里和smallpt不一样
+            Real P = 0.25 + 0.5 * refl_prob; 
+            Real RP = refl_prob / P;  // 反射路径的权重补偿
+            Real TP = (1.0 - refl_prob) / (1.0 - P); // 折射路径的权重补偿
+            if (sampler.get_1d() < P) {//俄罗斯轮盘赌选择反射还是折射，这里和smallpt不一样
                 direction = reflect(unit_dir, rec.normal);
                 attenuation = attenuation * RP;
             } else {
@@ -170,15 +245,15 @@ public:
                 attenuation = attenuation * TP;
             }
         }
-        scatteredRay = Ray(rec.p, direction);
+        scatteredRay = rec.spawn_ray(direction);
         return true;
     }
 
 public:
-    double ir; // 折射率之比 (Index of Refraction)
+    Real ir; // 折射率之比 (Index of Refraction)
     Color absorbance; // 吸光度，用于 Beer's Law
     // Schlick 近似：计算菲涅尔反射率
-    static double reflectance_schlick(double cos, double ref_idx) {
+    static Real reflectance_schlick(Real cos, Real ref_idx) {
         auto r0 = (1-ref_idx) / (1+ref_idx);
         r0 = r0*r0;
         return r0 + (1-r0)*pow((1 - cos), 5);
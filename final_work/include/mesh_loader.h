@@ -3,14 +3,16 @@
 
 #include "triangle.h"
 #include "hittable_list.hpp"
+#include "arena.h"
 #include <fstream>
 #include <sstream>
 #include <vector>
 #include <string>
 
-inline shared_ptr<HittableObjList> load_obj(std::string filename, shared_ptr<Material> m, double scale, Point3 offset) {
+// arena 不为空时三角形都放进 arena 的三角形池，连续存放
+inline shared_ptr<HittableObjList> load_obj(std::string filename, shared_ptr<Material> m, Real scale, Point3 offset, Arena* arena = nullptr) {
     std::vector<Point3> vertices;
-    auto objects = make_shared<HittableObjList>();
+    auto objects = arena_make<HittableObjList>(arena);
 
     std::ifstream in(filename);
     if (!in.is_open()) {
@@ -22,7 +24,7 @@ inline shared_ptr<HittableObjList> load_obj(std::string filename, shared_ptr<Mat
     while (std::getline(in, line)) {
         if (line.substr(0, 2) == "v ") {
             std::istringstream s(line.substr(2));
-            double x, y, z;
+            Real x, y, z;
             s >> x >> y >> z;
             vertices.push_back(Point3(x * scale, y * scale, z * scale) + offset);
         } else if (line.substr(0, 2) == "f ") {
@@ -48,7 +50,7 @@ inline shared_ptr<HittableObjList> load_obj(std::string filename, shared_ptr<Mat
             if (face_indices.size() >= 3) {
                 // Simple triangulation for polygons
                 for (size_t i = 1; i < face_indices.size() - 1; ++i) {
-                    objects->add(make_shared<Triangle>(
+                    objects->add(arena_make<Triangle>(arena,
                         vertices[face_indices[0]],
                         vertices[face_indices[i]],
                         vertices[face_indices[i+1]],
@@ -14,7 +14,7 @@ public:
         d_ = -dot(normal_, point_);
     }
 
-    virtual bool hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const {
+    virtual bool hit(const Ray& r, Real t_min, Real t_max, HitRecord& rec) const {
         auto denom = dot(normal_, r.direction());
         if (fabs(denom) > 1e-6) { // 避免与平行光线相交
             auto t = -(dot(normal_, r.origin()) + d_) / denom;
@@ -22,7 +22,7 @@ public:
                 rec.t = t;
                 rec.p = r.at(t);
                 rec.set_face_normal(r, normal_);
-                rec.mat_ptr = mat_ptr;
+                rec.mat_ptr = mat_ptr.get();
                 return true;
             }
         }
@@ -31,6 +31,6 @@ public:
 private:
     Point3 point_; // 平面上的一点
     Vec3 normal_;  // 平面的法向量
-    double d_;     // 平面方程中的常数项
+    Real d_;     // 平面方程中的常数项
     shared_ptr<Material> mat_ptr; // 材质指针
 };
\ No newline at end of file
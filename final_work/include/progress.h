@@ -0,0 +1,155 @@
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <omp.h>
+
+// 后台线程刷新进度的间隔（秒）
+const double kProgressInterval = 0.5;
+
+// 进度报告的代数：每个 ProgressReporter 创建时加一，各线程攒的计数带着代数，旧代数的计数作废
+inline std::atomic<unsigned>& progress_epoch() {
+    static std::atomic<unsigned> epoch(0);
+    return epoch;
+}
+
+/**
+* 每个线程自己的光线数和光子数，渲染核心里只做普通的加法，不碰任何共享的东西；
+* ProgressReporter::add 的时候才把攒下的数并到这个线程的槽里
+*@param epoch 这些计数属于哪一代进度报告，和当前代数不同时说明是上一个报告没上交的，先清零再计
+*/
+struct ThreadCounters {
+    long long rays = 0;
+    long long photons = 0;
+    unsigned epoch = 0;
+};
+
+// 当前线程的计数，代数过期时清零（只多一次 relaxed 的读，不写共享内存）
+inline ThreadCounters& thread_counters() {
+    thread_local ThreadCounters counters;
+    unsigned epoch = progress_epoch().load(std::memory_order_relaxed);
+    if (counters.epoch != epoch) {
+        counters = ThreadCounters();
+        counters.epoch = epoch;
+    }
+    return counters;
+}
+
+inline void count_rays(long long n = 1) { thread_counters().rays += n; }
+inline void count_photons(long long n = 1) { thread_counters().photons += n; }
+
+/**
+* 进度报告：每个线程一个原子计数槽（对齐到缓存行，互不干扰），渲染线程只做 relaxed 的 fetch_add，
+* 一个后台线程每隔 interval 秒读一次所有槽，在 std::cerr 上刷新一行：完成百分比、剩余时间、Mrays/s、光子/s。
+* 渲染线程从不加锁、从不等输出；锁和条件变量只在后台线程和 finish() 之间用来提前叫醒它
+*@param label       行首的名字
+*@param total_work  总工作量（块数、样本数、光子数……，单位由调用方定），<= 0 表示未知
+*@param time_budget 限时渲染的预算（秒），> 0 时百分比和剩余时间按时间算
+*@param interval    刷新间隔（秒）
+*@brief add(work) 渲染线程做完 work 个单位后调用，顺便上交这个线程攒下的光线数和光子数
+*@brief finish()  停掉后台线程，打印最终的一行（析构时也会调用）
+*/
+class ProgressReporter {
+public:
+    ProgressReporter(const std::string& label, long long total_work, double time_budget = 0, double interval = kProgressInterval)
+        : label(label), total(total_work), budget(time_budget), interval(interval),
+          slots(std::max(omp_get_max_threads(), 1)), start(Clock::now()) {
+        // 换一代：所有线程之前没上交的计数都不算在这次里，各线程下次计数或上交时自己清零
+        progress_epoch().fetch_add(1, std::memory_order_relaxed);
+        reporter = std::thread([this] { run(); });
+    }
+
+    ~ProgressReporter() { finish(); }
+
+    ProgressReporter(const ProgressReporter&) = delete;
+    ProgressReporter& operator=(const ProgressReporter&) = delete;
+
+    void add(long long work = 1) {
+        Slot& slot = slots[static_cast<size_t>(omp_get_thread_num()) % slots.size()];
+        ThreadCounters& counters = thread_counters();
+        const unsigned epoch = counters.epoch;
+        slot.work.fetch_add(work, std::memory_order_relaxed);
+        slot.rays.fetch_add(counters.rays, std::memory_order_relaxed);
+        slot.photons.fetch_add(counters.photons, std::memory_order_relaxed);
+        counters = ThreadCounters();
+        counters.epoch = epoch;
+    }
+
+    void finish() {
+        if (!reporter.joinable()) return;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_one();
+        reporter.join();
+        print(true);
+    }
+
+    long long rays() const { return sum(&Slot::rays); }
+    long long photons() const { return sum(&Slot::photons); }
+    double seconds() const { return std::chrono::duration<double>(Clock::now() - start).count(); }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct alignas(64) Slot {
+        std::atomic<long long> work{0};
+        std::atomic<long long> rays{0};
+        std::atomic<long long> photons{0};
+    };
+
+    long long sum(std::atomic<long long> Slot::*field) const {
+        long long s = 0;
+        for (const Slot& slot : slots) s += (slot.*field).load(std::memory_order_relaxed);
+        return s;
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> guard(lock);
+        const auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(interval));
+        while (!wake.wait_for(guard, period, [this] { return stopping; })) print(false);
+    }
+
+    void print(bool done) const {
+        const double elapsed = std::max(seconds(), 1e-9);
+        const long long work = sum(&Slot::work);
+        const long long ray_count = rays();
+        const long long photon_count = photons();
+        double fraction = -1;
+        if (budget > 0) fraction = std::min(elapsed / budget, 1.0);
+        else if (total > 0) fraction = std::min(double(work) / total, 1.0);
+        if (done) fraction = 1;
+
+        char line[256];
+        int len = std::snprintf(line, sizeof(line), "\r%s", label.c_str());
+        if (fraction >= 0) len += std::snprintf(line + len, sizeof(line) - len, " %5.1f%%", 100 * fraction);
+        if (done) len += std::snprintf(line + len, sizeof(line) - len, " | 用时 %.1f 秒", elapsed);
+        else if (fraction > 0) len += std::snprintf(line + len, sizeof(line) - len, " | 剩余 %.1f 秒", elapsed * (1 - fraction) / fraction);
+        if (ray_count > 0) len += std::snprintf(line + len, sizeof(line) - len, " | %.2f Mrays/s", ray_count / elapsed / 1e6);
+        if (photon_count > 0) len += std::snprintf(line + len, sizeof(line) - len, " | %.2f M光子/s", photon_count / elapsed / 1e6);
+        std::cerr << line << "    " << (done ? "\n" : "") << std::flush;
+    }
+
+    std::string label;
+    long long total;
+    double budget;
+    double interval;
+    std::vector<Slot> slots;
+    Clock::time_point start;
+    std::thread reporter;
+    std::mutex lock;
+    std::condition_variable wake;
+    bool stopping = false;
+};
+
+#endif
@@ -19,7 +19,7 @@ public:
     Point3 origin() const  { return orig; }
     Vec3 direction() const { return dir; }
 
-    Point3 at(double t) const {
+    Point3 at(Real t) const {
         return orig + t*dir;//光沿直线传播
     }
 
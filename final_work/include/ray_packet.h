@@ -0,0 +1,71 @@
+#ifndef RAY_PACKET_H
+#define RAY_PACKET_H
+
+#include "ray.h"
+#include "utils.h"
+#include <cstdint>
+
+/**
+* 光线包 (Ray Packet)：把方向相近的一组光线（同一行的相机光线、同一点发出的 final gather 光线）
+* 按 SoA 存在一起，一次遍历场景，每个节点的包围盒测试对整组光线同时做
+*@param size   包的宽度，4/8/16
+*@param active 活跃掩码，第 k 位为 1 表示第 k 条光线还在参与遍历
+*@param ox..dz 起点和方向的 SoA 数组，idx..idz 是方向分量的倒数（包围盒测试用）
+*@brief set(k, r) 填入第 k 条光线；finalize() 填完之后调用，计算整包的视锥区间用于剔除
+*/
+struct RayPacket {
+    static constexpr int kMaxSize = 16;
+
+    int size = 0;
+    uint32_t active = 0;
+
+    alignas(64) Real ox[kMaxSize], oy[kMaxSize], oz[kMaxSize];
+    alignas(64) Real dx[kMaxSize], dy[kMaxSize], dz[kMaxSize];
+    alignas(64) Real idx[kMaxSize], idy[kMaxSize], idz[kMaxSize];
+
+    // 视锥（区间）：所有光线起点和方向倒数在每个轴上的范围。
+    // 对一个包围盒，用区间运算算出整包光线可能的进入/离开时间，进不去就整包剔除
+    bool frustum_valid = false;
+    Real o_lo[3], o_hi[3];
+    Real inv_lo[3], inv_hi[3];
+
+    RayPacket() {}
+    explicit RayPacket(int n) : size(n) {}
+
+    void set(int k, const Ray& r) {
+        ox[k] = r.orig.x(); oy[k] = r.orig.y(); oz[k] = r.orig.z();
+        dx[k] = r.dir.x();  dy[k] = r.dir.y();  dz[k] = r.dir.z();
+        idx[k] = 1 / dx[k]; idy[k] = 1 / dy[k]; idz[k] = 1 / dz[k];
+        active |= (1u << k);
+    }
+
+    Ray ray(int k) const {
+        return Ray(Point3(ox[k], oy[k], oz[k]), Vec3(dx[k], dy[k], dz[k]));
+    }
+
+    void finalize() {
+        frustum_valid = active != 0;
+        const Real* o[3] = {ox, oy, oz};
+        const Real* inv[3] = {idx, idy, idz};
+        for (int a = 0; a < 3; ++a) {
+            o_lo[a] = inv_lo[a] = infinity;
+            o_hi[a] = inv_hi[a] = -infinity;
+            for (int k = 0; k < size; ++k) {
+                if (!(active & (1u << k))) continue;
+                o_lo[a] = fmin(o_lo[a], o[a][k]);
+                o_hi[a] = fmax(o_hi[a], o[a][k]);
+                inv_lo[a] = fmin(inv_lo[a], inv[a][k]);
+                inv_hi[a] = fmax(inv_hi[a], inv[a][k]);
+            }
+            // 方向分量为 0 时倒数是无穷大，区间运算会出现 0*inf，这种包就不做视锥剔除
+            if (!std::isfinite(inv_lo[a]) || !std::isfinite(inv_hi[a])) frustum_valid = false;
+        }
+    }
+};
+
+// 活跃光线数，用来判断光线包是否已经发散
+inline int packet_popcount(uint32_t mask) {
+    return __builtin_popcount(mask);
+}
+
+#endif
@@ -0,0 +1,370 @@
+#ifndef RAY_STREAM_H
+#define RAY_STREAM_H
+
+#include "hittable_obj.h"
+#include "ray_packet.h"
+#include "utils.h"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include <omp.h>
+
+/**
+* 光线流 (Ray Stream)：一次提交一大批互相独立的光线，按 SoA 存放
+* 和单条 hit() 相比，调用方不用关心光线的顺序：内部先按方向卦限和起点的 Morton 码重排，
+* 方向相同、起点相近的光线排在一起，再按 RayPacket 打包整包遍历加速结构
+*@param origin, direction 光线
+*@param t_max             每条光线的最大 t，阴影光线填到光源的距离，普通光线是 infinity
+*@brief push(r, t_max) 追加一条光线；ray(i) 取回第 i 条
+*/
+struct RayStream {
+    std::vector<Point3> origin;
+    std::vector<Vec3> direction;
+    std::vector<Real> t_max;
+
+    size_t size() const { return origin.size(); }
+
+    void clear() {
+        origin.clear();
+        direction.clear();
+        t_max.clear();
+    }
+
+    void resize(size_t n) {
+        origin.resize(n);
+        direction.resize(n);
+        t_max.resize(n, infinity);
+    }
+
+    void push(const Ray& r, Real tmax = infinity) {
+        origin.push_back(r.origin());
+        direction.push_back(r.direction());
+        t_max.push_back(tmax);
+    }
+
+    Ray ray(size_t i) const { return Ray(origin[i], direction[i]); }
+};
+
+/**
+* 光线流的求交结果，和输入的光线一一对应（不是重排之后的顺序）
+*@param rec 第 i 条光线的最近交点，hit[i] 为 0 时内容无意义
+*@param hit 第 i 条光线是否击中
+*/
+struct HitStream {
+    std::vector<HitRecord> rec;
+    std::vector<char> hit;
+};
+
+// 排序键：高 3 位是方向的卦限，低 60 位是起点和方向 6 个分量各量化成 10 位后交错的 Morton 码，
+// 四趟 16 位的基数排序
+const int kStreamOctantShift = 60;
+const int kStreamMortonBits = 10;
+const int kStreamRadixBits = 16;
+const int kStreamRadixPasses = 4;
+// 一批光线里每条的方向和第一条的夹角余弦都不小于这个值才整包遍历，否则逐条求交：
+// 发散的光线打包时每个节点要对整包做包围盒测试，比逐条遍历还慢
+const Real kStreamCoherentCos = 0.95;
+// 光线数少于这个值时不做基数排序（每趟都要清零、前缀求和 64K 个桶），直接按 (键, 编号) 比较排序，结果一样
+const size_t kStreamRadixMinSize = 1 << 14;
+// 排序前从流里均匀抽这么多条光线估计相干性
+const int kStreamSampleSize = 256;
+// 起点包围盒的对角线超过抽样光线交点距离中位数的这个倍数，就认为起点是分散的
+const Real kStreamOriginSpread = 0.25;
+
+// 把 10 位整数的每一位隔 5 位展开（第 b 位移到第 6b 位）的查找表，6 个分量错开一位叠起来就是 6 维 Morton 码
+inline const std::vector<uint64_t>& morton_6d_table() {
+    static const std::vector<uint64_t> table = [] {
+        std::vector<uint64_t> t(1u << kStreamMortonBits);
+        for (uint32_t v = 0; v < t.size(); ++v)
+            for (int bit = 0; bit < kStreamMortonBits; ++bit)
+                t[v] |= uint64_t((v >> bit) & 1) << (6 * bit);
+        return t;
+    }();
+    return table;
+}
+
+// 6 维 Morton 码：6 个 10 位整数逐位交错，q[0] 的位在最高
+inline uint64_t morton_6d(const uint32_t q[6]) {
+    const std::vector<uint64_t>& spread = morton_6d_table();
+    uint64_t code = 0;
+    for (int a = 0; a < 6; ++a)
+        code |= spread[q[a]] << (5 - a);
+    return code;
+}
+
+/**
+* 算出光线流的遍历顺序：排序键高 3 位是方向的卦限（每个轴的符号），低位是起点（在整个流的包围盒里归一化）
+* 和方向分量的绝对值一起交错出的 6 维 Morton 码。起点分散的光线主要按起点聚在一起，
+* 同一个起点发出的光线（相机光线、final gather 光线）起点位都相同，自然按方向排序
+* 用稳定的 LSD 基数排序，相同键的光线保持原来的先后，顺序只取决于输入，和线程数无关
+*@param & rays  光线流
+*@param & order 输出，order[k] 是第 k 个遍历的光线编号
+*@param & keys  输出，order 里每条光线的排序键，打包时用来判断卦限有没有变
+*/
+inline void ray_stream_order(const RayStream& rays, std::vector<uint32_t>& order, std::vector<uint64_t>& keys) {
+    const size_t n = rays.size();
+    const int threads = omp_get_max_threads();
+    // 起点的包围盒：每个线程求自己那一段，再合起来（min / max 和合并顺序无关）
+    std::vector<Point3> thread_lo(threads, Point3(infinity, infinity, infinity));
+    std::vector<Point3> thread_hi(threads, Point3(-infinity, -infinity, -infinity));
+    #pragma omp parallel num_threads(threads)
+    {
+        const int t = omp_get_thread_num(), nt = omp_get_num_threads();
+        const size_t begin = n * t / nt, end = n * (t + 1) / nt;
+        for (size_t i = begin; i < end; ++i) {
+            thread_lo[t] = component_min(thread_lo[t], rays.origin[i]);
+            thread_hi[t] = component_max(thread_hi[t], rays.origin[i]);
+        }
+    }
+    Point3 lo = thread_lo[0], hi = thread_hi[0];
+    for (int t = 1; t < threads; ++t) {
+        lo = component_min(lo, thread_lo[t]);
+        hi = component_max(hi, thread_hi[t]);
+    }
+    const Real cells = Real((1 << kStreamMortonBits) - 1);
+    Real scale[3];
+    for (int a = 0; a < 3; ++a) scale[a] = hi[a] > lo[a] ? cells / (hi[a] - lo[a]) : 0;
+
+    std::vector<uint64_t> key(n);
+    #pragma omp parallel for schedule(static)
+    for (long long i = 0; i < static_cast<long long>(n); ++i) {
+        const Point3& o = rays.origin[i];
+        Vec3 d = unit_vector(rays.direction[i]);
+        uint64_t octant = (d.x() < 0 ? 1u : 0u) | (d.y() < 0 ? 2u : 0u) | (d.z() < 0 ? 4u : 0u);
+        uint32_t q[6];
+        for (int a = 0; a < 3; ++a) {
+            q[a] = static_cast<uint32_t>((o[a] - lo[a]) * scale[a]);
+            q[a + 3] = static_cast<uint32_t>(std::fabs(d[a]) * cells);
+        }
+        key[i] = (octant << kStreamOctantShift) | morton_6d(q);
+    }
+
+    order.resize(n);
+    #pragma omp parallel for schedule(static)
+    for (long long i = 0; i < static_cast<long long>(n); ++i) order[i] = static_cast<uint32_t>(i);
+    if (n < kStreamRadixMinSize) {
+        // 键相同时按编号排，和稳定的基数排序给出同样的顺序
+        std::sort(order.begin(), order.end(), [&key](uint32_t a, uint32_t b) {
+            return key[a] != key[b] ? key[a] < key[b] : a < b;
+        });
+        keys.resize(n);
+        for (size_t k = 0; k < n; ++k) keys[k] = key[order[k]];
+        return;
+    }
+    // 每一趟和 parallel_bucket_sort 一样：每个线程对 order 里自己那一段建直方图，按 (桶, 线程) 的顺序前缀求和，
+    // 再各自写出，桶内保持原来的先后，和串行的基数排序结果相同
+    const uint32_t buckets = 1u << kStreamRadixBits;
+    std::vector<uint32_t> count(size_t(buckets) * threads);
+    std::vector<uint32_t> tmp(n);
+    for (int pass = 0; pass < kStreamRadixPasses; ++pass) {
+        const int shift = pass * kStreamRadixBits;
+        #pragma omp parallel num_threads(threads)
+        {
+            const int t = omp_get_thread_num(), nt = omp_get_num_threads();
+            const size_t begin = n * t / nt, end = n * (t + 1) / nt;
+            #pragma omp for schedule(static)
+            for (long long c = 0; c < static_cast<long long>(count.size()); ++c) count[c] = 0;
+            for (size_t k = begin; k < end; ++k) ++count[size_t((key[order[k]] >> shift) & (buckets - 1)) * threads + t];
+            #pragma omp barrier
+            #pragma omp single
+            {
+                uint32_t sum = 0;
+                for (size_t c = 0; c < count.size(); ++c) {
+                    uint32_t v = count[c];
+                    count[c] = sum;
+                    sum += v;
+                }
+            }
+            for (size_t k = begin; k < end; ++k) {
+                uint32_t i = order[k];
+                tmp[count[size_t((key[i] >> shift) & (buckets - 1)) * threads + t]++] = i;
+            }
+        }
+        order.swap(tmp);
+    }
+    keys.resize(n);
+    #pragma omp parallel for schedule(static)
+    for (long long k = 0; k < static_cast<long long>(n); ++k) keys[k] = key[order[k]];
+}
+
+/**
+* 排序之前估计光线流是否值得打包：从流里均匀抽 kStreamSampleSize 条光线逐条求交，
+* 方向接近平行（单位方向的平均长度不小于 kStreamCoherentCos），或者起点集中（起点包围盒的对角线
+* 不超过交点距离中位数的 kStreamOriginSpread 倍，比如相机光线、final gather 光线）就打包；
+* 起点和方向都分散的（漫反射之后的次级光线、阴影光线）排完序同一个包里的光线起点也隔得很远，
+* 整包遍历比逐条还慢，重排本身也白做了
+*@param & world 加速结构
+*@param & rays  光线流
+*@param t_min   最小 t 值
+*@return 是否走排序打包的路径
+*/
+inline bool ray_stream_coherent(const HittableObj& world, const RayStream& rays, Real t_min) {
+    const size_t n = rays.size();
+    const size_t samples = std::min<size_t>(n, kStreamSampleSize);
+    Vec3 sum(0, 0, 0);
+    Point3 lo(infinity, infinity, infinity), hi(-infinity, -infinity, -infinity);
+    std::vector<Real> distance;
+    for (size_t s = 0; s < samples; ++s) {
+        size_t i = (2 * s + 1) * n / (2 * samples);
+        sum += unit_vector(rays.direction[i]);
+        lo = component_min(lo, rays.origin[i]);
+        hi = component_max(hi, rays.origin[i]);
+        PrimHit h;
+        if (world.intersect(rays.ray(i), t_min, rays.t_max[i], h)) distance.push_back(h.t * rays.direction[i].length());
+    }
+    if (sum.length() >= kStreamCoherentCos * samples) return true;
+    if (distance.empty()) return false;
+    std::nth_element(distance.begin(), distance.begin() + distance.size() / 2, distance.end());
+    return (hi - lo).length() <= kStreamOriginSpread * distance[distance.size() / 2];
+}
+
+/**
+* 把排好序的光线切成批：每批最多 RayPacket::kMaxSize 条，卦限变了就另起一批，保证包内光线方向符号一致、视锥剔除有效
+*@param & keys    ray_stream_order 输出的排序键
+*@param & batches 输出，第 b 批是 order[batches[b], batches[b+1])
+*/
+inline void ray_stream_batches(const std::vector<uint64_t>& keys, std::vector<size_t>& batches) {
+    batches.clear();
+    const size_t n = keys.size();
+    size_t start = 0;
+    for (size_t k = 0; k < n; ++k) {
+        bool octant_changed = (keys[k] >> kStreamOctantShift) != (keys[start] >> kStreamOctantShift);
+        if (k - start == RayPacket::kMaxSize || octant_changed) {
+            batches.push_back(start);
+            start = k;
+        }
+    }
+    batches.push_back(start);
+    batches.push_back(n);
+}
+
+/**
+* 按 order 里 [begin, end) 的光线填包（包的宽度已经是 end - begin），每条光线的 t_max 放进 t_max 数组
+*@return 方向是否足够一致，一致时已经调用过 finalize()，可以整包遍历
+*/
+inline bool fill_stream_batch(const RayStream& rays, const std::vector<uint32_t>& order,
+    size_t begin, size_t end, RayPacket& packet, Real* t_max) {
+    const Vec3 lead = unit_vector(rays.direction[order[begin]]);
+    bool coherent = true;
+    for (size_t k = begin; k < end; ++k) {
+        uint32_t i = order[k];
+        packet.set(static_cast<int>(k - begin), rays.ray(i));
+        t_max[k - begin] = rays.t_max[i];
+        if (dot(unit_vector(rays.direction[i]), lead) < kStreamCoherentCos) coherent = false;
+    }
+    if (coherent) packet.finalize();
+    return coherent;
+}
+
+/**
+* 求一批光线的最近交点：方向足够一致就整包遍历加速结构，否则逐条调用 intersect（基类的 hit_packet 就是逐条求交）
+*/
+inline void trace_stream_batch(const HittableObj& world, const RayStream& rays, const std::vector<uint32_t>& order,
+    size_t begin, size_t end, Real t_min, RayPacket& packet, PacketHits& hits) {
+    if (fill_stream_batch(rays, order, begin, end, packet, hits.t)) {
+        world.hit_packet(packet, packet.active, t_min, hits);
+    } else {
+        world.HittableObj::hit_packet(packet, packet.active, t_min, hits);
+    }
+}
+
+/**
+* 光线流求交：对流里每条光线求 (t_min, t_max[i]) 内的最近交点
+* 结果和逐条调用 world.hit() 相同（只有 t 完全相等的并列交点可能选到另一个），按输入顺序写回 out
+* ray_stream_coherent 判断不值得打包的流不排序，直接并行地逐条 hit()
+*@param & world 加速结构，一般是 scene.accel()
+*@param & rays  光线流
+*@param & out   输出，大小会调整成 rays.size()
+*@param t_min   最小 t 值
+*/
+inline void intersect_stream(const HittableObj& world, const RayStream& rays, HitStream& out, Real t_min = kRayTMin) {
+    const size_t n = rays.size();
+    out.rec.resize(n);
+    out.hit.assign(n, 0);
+    if (n == 0) return;
+
+    if (!ray_stream_coherent(world, rays, t_min)) {
+        #pragma omp parallel for schedule(dynamic, 1024)
+        for (long long i = 0; i < static_cast<long long>(n); ++i)
+            out.hit[i] = world.hit(rays.ray(i), t_min, rays.t_max[i], out.rec[i]);
+        return;
+    }
+
+    std::vector<uint32_t> order;
+    std::vector<uint64_t> keys;
+    std::vector<size_t> batches;
+    ray_stream_order(rays, order, keys);
+    ray_stream_batches(keys, batches);
+
+    const long long batch_count = static_cast<long long>(batches.size()) - 1;
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (long long b = 0; b < batch_count; ++b) {
+        RayPacket packet(static_cast<int>(batches[b + 1] - batches[b]));
+        PacketHits hits;
+        trace_stream_batch(world, rays, order, batches[b], batches[b + 1], t_min, packet, hits);
+        for (int k = 0; k < packet.size; ++k) {
+            if (!(hits.mask & (1u << k))) continue;
+            uint32_t i = order[batches[b] + k];
+            hits.surface(packet, k, out.rec[i]);
+            out.hit[i] = 1;
+        }
+    }
+}
+
+/**
+* 光线流遮挡测试：只关心 (t_min, t_max[i]) 内有没有东西，不算交点的表面信息
+* 整包遍历走 occluded_packet (any-hit)：被挡住的光线立刻退出遍历，整包都被挡住就停，不去找最近交点；
+* 不值得打包的流和 intersect_stream 一样逐条求交
+*@param & world 加速结构
+*@param & rays  光线流，阴影光线的 t_max 填到光源的距离
+*@param t_min   最小 t 值
+*@return 位掩码，第 i 条光线被挡住时第 i 位（第 i/64 个字的第 i%64 位）为 1
+*/
+inline std::vector<uint64_t> occluded_stream(const HittableObj& world, const RayStream& rays, Real t_min = kRayTMin) {
+    const size_t n = rays.size();
+    std::vector<uint64_t> mask((n + 63) / 64, 0);
+    if (n == 0) return mask;
+
+    if (!ray_stream_coherent(world, rays, t_min)) {
+        // 每次处理一个 64 位字里的光线，不同线程不会写同一个字
+        #pragma omp parallel for schedule(dynamic, 16)
+        for (long long w = 0; w < static_cast<long long>(mask.size()); ++w) {
+            const size_t end = std::min(n, size_t(w + 1) * 64);
+            for (size_t i = size_t(w) * 64; i < end; ++i) {
+                PrimHit h;
+                if (world.intersect(rays.ray(i), t_min, rays.t_max[i], h)) mask[w] |= uint64_t(1) << (i % 64);
+            }
+        }
+        return mask;
+    }
+
+    std::vector<uint32_t> order;
+    std::vector<uint64_t> keys;
+    std::vector<size_t> batches;
+    ray_stream_order(rays, order, keys);
+    ray_stream_batches(keys, batches);
+
+    // 不同批的光线可能落在同一个 64 位字里，先按光线写字节，最后再压成位
+    std::vector<char> blocked(n, 0);
+    const long long batch_count = static_cast<long long>(batches.size()) - 1;
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (long long b = 0; b < batch_count; ++b) {
+        RayPacket packet(static_cast<int>(batches[b + 1] - batches[b]));
+        Real t_max[RayPacket::kMaxSize];
+        uint32_t occluded = fill_stream_batch(rays, order, batches[b], batches[b + 1], packet, t_max)
+            ? world.occluded_packet(packet, packet.active, t_min, t_max)
+            : world.HittableObj::occluded_packet(packet, packet.active, t_min, t_max);
+        for (int k = 0; k < packet.size; ++k)
+            if (occluded & (1u << k)) blocked[order[batches[b] + k]] = 1;
+    }
+    for (size_t i = 0; i < n; ++i)
+        if (blocked[i]) mask[i / 64] |= uint64_t(1) << (i % 64);
+    return mask;
+}
+
+// 取 occluded_stream 返回的位掩码的第 i 位
+inline bool stream_bit(const std::vector<uint64_t>& mask, size_t i) {
+    return (mask[i / 64] >> (i % 64)) & 1;
+}
+
+#endif
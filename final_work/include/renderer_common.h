@@ -3,6 +3,7 @@
 
 #include "utils.h"
 #include "hittable_list.hpp"
+#include "scene.h"
 #include "material.hpp"
 #include "sphere.h"
 #include <algorithm>
@@ -15,47 +16,57 @@
 enum Refl_t { DIFF, SPEC, REFR };
 
 // 辅助函数：获取向量的最大分量
-inline double max_in_xyz(const Vec3& v) {
+inline Real max_in_xyz(const Vec3& v) {
     return std::max({v.x(), v.y(), v.z()});
 }
 
-// 射线求交，和hittableobj里的hit不一样，这里返回击中的物体索引和距离
-//有了索引就可以通过world.objects[索引]来获取具体的物体指针，然后再用它的hit函数获取HitRecord
-inline std::pair<int, double> nearest_hit(const Ray& ray, const HittableObjList& world) {
-    double closest_so_far = infinity;
-    int hit_idx = -1;
-    HitRecord temp_rec;
-    
-    for (int i = 0; i < world.objects.size(); ++i) {
-        if (world.objects[i]->hit(ray, 0.001, closest_so_far, temp_rec)) {
-            closest_so_far = temp_rec.t;
-            hit_idx = i;
-        }
-    }
-    
-    if (hit_idx != -1) return {hit_idx, closest_so_far};
-    return {-1, 0};
+// 颜色的亮度 (Rec. 709 系数)，俄罗斯轮盘赌按它决定存活概率
+inline Real luminance(const Color& c) {
+    return 0.2126 * c.x() + 0.7152 * c.y() + 0.0722 * c.z();
+}
+
+// 色调映射 + Gamma 校正，把一个 HDR 像素写进 8 位的 RGB 缓冲区，三个渲染器共用
+inline void store_pixel(std::vector<unsigned char>& buffer, int pixel_index, const Color& hdr) {
+    Color c = component_sqrt(aces_approx(hdr));
+    buffer[pixel_index*3]   = static_cast<unsigned char>(256 * clamp(c.x(), 0.0, 0.999));
+    buffer[pixel_index*3+1] = static_cast<unsigned char>(256 * clamp(c.y(), 0.0, 0.999));
+    buffer[pixel_index*3+2] = static_cast<unsigned char>(256 * clamp(c.z(), 0.0, 0.999));
+}
+
+// 向量按 x、y、z 字典序比较。并行追踪时光子、可见点插入容器的顺序取决于线程调度，
+// 按内容排个序之后，KD-Tree 和累加顺序就和线程数无关了
+inline bool vec_less(const Vec3& a, const Vec3& b) {
+    if (a.x() != b.x()) return a.x() < b.x();
+    if (a.y() != b.y()) return a.y() < b.y();
+    return a.z() < b.z();
+}
+
+// 射线求交，和hittableobj里的hit不一样，这里返回击中的物体索引（Scene::objects 的下标，没击中是 -1）
+// 在加速结构上只遍历一次，同时把完整的 HitRecord 填好，不用再对击中的物体调用一次 hit
+inline int nearest_hit(const Ray& ray, const HittableObj& accel, HitRecord& rec) {
+    if (!accel.hit(ray, kRayTMin, infinity, rec)) return -1;
+    return rec.prim_id;
 }
 
 // 辅助函数：返回一个二元组：材质类型和颜色
-inline std::pair<Refl_t, Color> get_feature(shared_ptr<Material> mat, const Point3& p) {
+// 按材质标签分支，每次击中只比较一次整数，不做 RTTI；纹理用交点真实的 uv 求值
+inline std::pair<Refl_t, Color> get_feature(const HitRecord& rec) {
+    const Material* mat = rec.mat_ptr;
     Color f(0,0,0);
     if (!mat) return {DIFF, f};
     
-    if (auto lam = std::dynamic_pointer_cast<Lambertian>(mat)) {
-        f = lam->albedo->value(0,0,p);//f就是albedo
+    switch (mat->type) {
+    case MaterialType::Lambertian:
+        f = eval_texture(static_cast<const Lambertian*>(mat)->albedo.get(), rec.u, rec.v, rec.p);//f就是albedo
         return {DIFF, f};
-    }
-    if (auto met = std::dynamic_pointer_cast<Metal>(mat)) {
-        f = met->albedo;
+    case MaterialType::Metal:
+        f = static_cast<const Metal*>(mat)->albedo;
         return {SPEC, f};
-    }
-    if (auto diel = std::dynamic_pointer_cast<Dielectric>(mat)) {
+    case MaterialType::Dielectric:
         f = Color(1,1,1); 
         return {REFR, f};
-    }
-    if (auto light = std::dynamic_pointer_cast<DiffuseLight>(mat)) {
-        f = light->emit->value(0,0,p);
+    case MaterialType::DiffuseLight:
+        f = eval_texture(static_cast<const DiffuseLight*>(mat)->emit.get(), rec.u, rec.v, rec.p);
         return {DIFF, f};
     }
     return {DIFF, f};
@@ -91,9 +102,9 @@ public:
     }
 
     // 搜索函数：查找距离 p 在 radius 范围内的所有对象，并对每个对象调用 callback
-    // Callback 签名: void(T* item, double dist_sq)
+    // Callback 签名: void(T* item, Real dist_sq)
     template<typename Func>
-    void search(const Point3& p, double radius, Func callback) const {
+    void search(const Point3& p, Real radius, Func callback) const {
         search_recursive(root, p, radius * radius, callback);
     }
 
@@ -139,11 +150,11 @@ private:
     }
 
     template<typename Func>
-    void search_recursive(KDNode<T>* node, const Point3& p, double radius_sq, Func callback) const {
+    void search_recursive(KDNode<T>* node, const Point3& p, Real radius_sq, Func callback) const {
         if (!node) return;
 
         // 剪枝：计算查询点到节点包围盒的最小距离平方
-        double dist_sq_box = 0;
+        Real dist_sq_box = 0;
         for (int i = 0; i < 3; ++i) {
             if (p[i] < node->min_box[i]) dist_sq_box += (node->min_box[i] - p[i]) * (node->min_box[i] - p[i]);
             else if (p[i] > node->max_box[i]) dist_sq_box += (p[i] - node->max_box[i]) * (p[i] - node->max_box[i]);
@@ -153,7 +164,7 @@ private:
         if (dist_sq_box > radius_sq) return;
 
         // 检查当前节点的对象
-        double dist_sq = (node->data->p - p).length_squared();
+        Real dist_sq = (node->data->p - p).length_squared();
         if (dist_sq <= radius_sq) {
             callback(node->data, dist_sq);
         }
@@ -2,91 +2,555 @@
 #define RENDERER_PATH_H
 
 #include "utils.h"
+#include "renderer_common.h"
 #include "hittable_list.hpp"
 #include "camera.h"
 #include "material.hpp"
+#include "sampler.h"
+#include "sampling.h"
+#include "scene.h"
+#include "film.h"
+#include "tile_scheduler.h"
+#include "progress.h"
+#include "gbuffer.h"
+#include "denoiser.h"
+#include <chrono>
 #include <iostream>
 #include <vector>
+#include <algorithm>
 #include <omp.h>
 
-// 递归光线追踪函数
-inline Color ray_color(const Ray& r, const HittableObj& world, int depth) {
-    HitRecord rec;//光线与物体的交点信息
-    // 0.001 是为了忽略非常接近零的撞击
-    if (world.hit(r, 0.001, infinity, rec)) {//world.hit返回true说明光线击中了物体
-        Ray scatteredRay;//与材质交互后的光线
-        Color attenuation;//albedo,颜色衰减
-        Color emitted = rec.mat_ptr->emitted(0, 0, rec.p);//(忽略这里的uv坐标)获取材质发光颜色
-
-        // 递归步骤：光线与材质交互并累积颜色
-        if (rec.mat_ptr->scatter(r, rec, attenuation, scatteredRay)) {//scatter返回true说明有交互
-            // 递归达到一定次数，轮盘赌决定是否终止路径
-            if (depth < 45) {
-                double p = 0.8; // 存活概率
-                if (random_double() > p)
-                    return emitted; // 终止路径
-                attenuation = attenuation / p; // 能量补偿
-            }
-            // 继续递归追踪和材质交互的光线
-            return emitted + attenuation * ray_color(scatteredRay, world, depth-1) ;
+// 没有击中物体时的背景色（环境光），调试的时候用，以防光源太暗看不清场景了
+inline Color background_color(const Ray& r) {
+    Vec3 unit_direction = unit_vector(r.direction());
+    auto t = 0.5*(unit_direction.y() + 1.0);
+    return (1.0-t)*Color(1.0, 1.0, 1.0) + t*Color(0.5, 0.7, 1.0);
+}
+
+/**
+* 路径上一个顶点的信息，BSDF 采样的光线击中光源时用它算 MIS 权重
+*@param p        上一个顶点的位置
+*@param pdf      在上一个顶点用 BSDF 采样出这条光线的概率密度（对立体角）
+*@param specular 上一个顶点是镜面/折射（或者是相机），这时没有做光源采样，击中光源要算全部的发光
+*/
+struct PathVertex {
+    Point3 p;
+    Real pdf = 0;
+    bool specular = true;
+};
+
+// 幂启发式 (power heuristic, beta = 2) 的 MIS 权重
+inline Real power_heuristic(Real pdf_a, Real pdf_b) {
+    Real a = pdf_a * pdf_a;
+    Real b = pdf_b * pdf_b;
+    return (a + b) > 0 ? a / (a + b) : 0;
+}
+
+// BSDF 采样击中了光源：上一个顶点已经对这个光源做过光源采样的话，按 MIS 权重只算一部分
+inline Color emitted_with_mis(const HitRecord& rec, const Scene& scene, const PathVertex& prev) {
+    Color emitted = rec.mat_ptr->emitted(0, 0, rec.p);//(忽略这里的uv坐标)获取材质发光颜色
+    int light_idx = scene.emitter_index(rec.prim_id);
+    if (!prev.specular && light_idx >= 0 && !emitted.near_zero()) {
+        const Emitter& light = scene.emitters[light_idx];
+        if (light.sphere) {
+            Real light_pdf = scene.emitter_pdf(light_idx) * sphere_solid_angle_pdf(light.sphere->center, light.sphere->radius, prev.p);
+            emitted = emitted * power_heuristic(prev.pdf, light_pdf);
         }
+    }
+    return emitted;
+}
+
+// 光源采样 (Next Event Estimation)：按功率选一个光源，在它朝向着色点的圆锥里采一点，
+// 用幂启发式和 BSDF 采样做 MIS。只生成阴影光线和没有遮挡时的贡献，可见性由调用方测
+// 目前只有球形光源能采样，其他发光体只能靠 BSDF 采样击中
+// albedo 不为空时 rec 的材质必须是 Lambertian，直接用这个已经求好的反照率，不再求纹理
+inline bool sample_light_ray(const Ray& r, const HitRecord& rec, const Scene& scene, Sampler& sampler,
+    Ray& shadow_ray, Real& t_max, Color& contribution, const Color* albedo = nullptr) {
+    Real lu, lv;
+    sampler.get_2d(lu, lv);
+    Real select_pdf;
+    int idx = scene.sample_emitter(sampler.get_1d(), select_pdf);
+    if (idx < 0) return false;
+    const Emitter& light = scene.emitters[idx];
+    if (!light.sphere) return false;
+
+    SphereLightSample ls;
+    if (!sample_sphere_solid_angle(light.sphere->center, light.sphere->radius, rec.p, lu, lv, ls)) return false;
+    Vec3 wo = -unit_vector(r.direction());
+    Color f = albedo ? static_cast<const Lambertian*>(rec.mat_ptr)->eval_with_albedo(rec, *albedo, ls.wi)
+                     : rec.mat_ptr->eval(rec, wo, ls.wi);
+    Real cos_theta = dot(rec.normal, ls.wi);
+    if (cos_theta <= 0 || f.near_zero()) return false;
+
+    Real light_pdf = select_pdf * ls.pdf;
+    Real weight = power_heuristic(light_pdf, rec.mat_ptr->pdf(rec, wo, ls.wi));
+    shadow_ray = rec.spawn_ray(ls.wi);
+    t_max = ls.dist - kRayTMin;
+    contribution = light.radiance * f * (cos_theta * weight / light_pdf);
+    return true;
+}
+
+inline Color sample_direct_light(const Ray& r, const HitRecord& rec, const Scene& scene, Sampler& sampler) {
+    Ray shadow_ray;
+    Real t_max;
+    Color contribution;
+    if (!sample_light_ray(r, rec, scene, sampler, shadow_ray, t_max, contribution)) return Color(0, 0, 0);
+    HitRecord shadow_rec;
+    count_rays();
+    if (scene.accel().hit(shadow_ray, kRayTMin, t_max, shadow_rec)) return Color(0, 0, 0);
+    return contribution;
+}
+
+// 在交点处按材质采样下一条光线，更新路径权重 beta 和上一个顶点的信息，再做俄罗斯轮盘赌。
+// 路径在这里结束时返回 false（材质不散射时顺便把调试用的环境光加进 L）
+// albedo 不为空时和 sample_light_ray 一样，rec 的材质必须是 Lambertian
+inline bool sample_next_ray(Ray& r, const HitRecord& rec, int bounce, int rr_min_bounce, Sampler& sampler,
+    Color& beta, PathVertex& prev, Color& L, const Color* albedo = nullptr) {
+    Ray scatteredRay;//与材质交互后的光线
+    Color attenuation;//albedo,颜色衰减
+    bool scattered = albedo ? static_cast<const Lambertian*>(rec.mat_ptr)->scatter_with_albedo(rec, *albedo, attenuation, scatteredRay, sampler)
+                            : rec.mat_ptr->scatter(r, rec, attenuation, scatteredRay, sampler);
+    if (!scattered) {
         // 增加环境光，调试的时候用，以防光源太暗看不清场景了
         Color ambient(0.1, 0.1, 0.1);
-        return emitted+ attenuation * ambient;
+        L += beta * attenuation * ambient;
+        return false;
+    }
+    beta = beta * attenuation;
+
+    // 俄罗斯轮盘赌：按路径权重的亮度决定存活概率
+    if (bounce >= rr_min_bounce) {
+        Real p = std::min(Real(0.95), luminance(beta));
+        if (p <= 0 || sampler.get_1d() >= p) return false;
+        beta = beta / p; // 能量补偿
+    }
+
+    prev.p = rec.p;
+    prev.specular = rec.mat_ptr->is_specular();
+    prev.pdf = prev.specular ? 0 : rec.mat_ptr->pdf(rec, -unit_vector(r.direction()), unit_vector(scatteredRay.direction()));
+    r = scatteredRay;
+    return true;
+}
+
+/**
+* 迭代的路径积分器：从已经求好的第一个交点出发，循环做 "发光 + 光源采样 + BSDF 采样下一条光线"，
+* 路径权重 (throughput) 显式地乘在 beta 里，没有递归，栈深度和路径长度无关。
+* 第 rr_min_bounce 次反弹之后做俄罗斯轮盘赌，存活概率取 beta 的亮度（最多 0.95）：
+* 已经很暗的路径早早结束，亮的路径继续走，存活时除以存活概率，期望不变
+*@param r, rec         相机光线和它的第一个交点
+*@param max_depth     最多反弹次数
+*@param rr_min_bounce 从第几次反弹开始轮盘赌
+*/
+inline Color trace_path(Ray r, HitRecord rec, const Scene& scene, int max_depth, int rr_min_bounce, Sampler& sampler) {
+    Color L(0, 0, 0);
+    Color beta(1, 1, 1);
+    PathVertex prev;
+    for (int bounce = 0; ; ++bounce) {
+        sampler.next_bounce(); // 每次反弹用一块新的维度
+        L += beta * emitted_with_mis(rec, scene, prev);
+        if (bounce >= max_depth) break;
+
+        // 非镜面的表面做一次光源采样
+        if (!rec.mat_ptr->is_specular()) L += beta * sample_direct_light(r, rec, scene, sampler);
+
+        // 光线与材质交互，得到下一条光线
+        if (!sample_next_ray(r, rec, bounce, rr_min_bounce, sampler, beta, prev, L)) break;
+
+        // kRayTMin 是为了忽略非常接近零的撞击
+        count_rays();
+        if (!scene.accel().hit(r, kRayTMin, infinity, rec)) {
+            // 环境光，同上
+            L += beta * background_color(r);
+            break;
+        }
+    }
+    return L;
+}
+
+// 相机光线包的宽度：同一行相邻的 kCameraPacket 个像素、同一个采样序号的光线一起求交
+const int kCameraPacket = 8;
+
+/**
+* 同一行的 n 个像素各追踪一个样本：相机光线高度相干，打成一个包整包遍历场景，之后每条光线各自继续追踪
+* 像素内抖动用采样器相机块的前两维，后面每次反弹各用一块
+*@param pixels  像素编号（行优先，第 0 行在图像顶部），都在同一行
+*@param samples 每个像素用它的第几个样本
+*@param out     每个像素这个样本的辐射度
+*@param gbuffer 不为空时顺便把第一个交点累加进去（只多一次纹理求值）
+*/
+inline void trace_camera_packet(const Scene& scene, const Camera& cam, int image_width, int image_height,
+    int n, const int* pixels, const int* samples, int max_depth, int rr_min_bounce, Sampler& sampler, Color* out,
+    GBuffer* gbuffer = nullptr) {
+    RayPacket packet(n);
+    for (int k = 0; k < n; ++k) {
+        sampler.start_pixel_sample(pixels[k], samples[k]);
+        Real du, dv;
+        sampler.get_2d(du, dv);
+        int col = pixels[k] % image_width;
+        int j = image_height - 1 - pixels[k] / image_width;
+        auto u = (col + du) / (image_width-1);
+        auto v = (j + dv) / (image_height-1);
+        packet.set(k, cam.get_ray(u, v));
+    }
+    packet.finalize();
+    PacketHits hits;
+    count_rays(n);
+    scene.accel().hit_packet(packet, packet.active, kRayTMin, hits);
+    for (int k = 0; k < n; ++k) {
+        Ray r = packet.ray(k);
+        sampler.start_pixel_sample(pixels[k], samples[k]);
+        if (hits.mask & (1u << k)) {
+            HitRecord rec;
+            hits.surface(packet, k, rec);
+            if (gbuffer) gbuffer->add(pixels[k], first_hit(r, rec));
+            out[k] = trace_path(r, rec, scene, max_depth, rr_min_bounce, sampler);
+        } else {
+            if (gbuffer) gbuffer->add(pixels[k], FirstHit());
+            out[k] = background_color(r);
+        }
     }
-    // 环境光，同上
-    Vec3 unit_direction = unit_vector(r.direction());
-    auto t = 0.5*(unit_direction.y() + 1.0);
-    return (1.0-t)*Color(1.0, 1.0, 1.0) + t*Color(0.5, 0.7, 1.0);
 }
 
+/**
+* 路径追踪：图像切成块交给分块调度器，块内每一行按 kCameraPacket 个像素一组打包追踪相机光线
+* 所有样本累加完之后（需要时先降噪）再统一色调映射
+*@param & tiles   块的大小和遍历顺序
+*@param & denoise 降噪参数，打开时要传 gbuffer 作为引导
+*@param gbuffer   不为空时同一遍里顺便记录第一个交点（降噪引导、AOV 输出），按像素数重新分配
+*/
 inline void render_path_tracing(
-    const HittableObjList& world, 
+    const Scene& scene, 
     const Camera& cam, 
     int image_width, 
     int image_height, 
     int samples_per_pixel, 
     int max_depth,
-    std::vector<unsigned char>& buffer
+    int rr_min_bounce,
+    const Sampler& sampler_proto,
+    std::vector<unsigned char>& buffer,
+    const TileSettings& tiles = TileSettings(),
+    const DenoiseSettings& denoise = DenoiseSettings(),
+    GBuffer* gbuffer = nullptr
 ) {
-    std::cout << "开始光追渲染" << std::endl;
+    std::cout << "开始光追渲染, 采样器: " << sampler_proto.name() << ", 分块: " << tiles.size << " (" << tile_order_name(tiles.order) << ")" << std::endl;
     
-    buffer.resize(image_width * image_height * 3);
-    int height_remain = image_height;
+    std::vector<Color> hdr(image_width * image_height);
+    if (gbuffer) gbuffer->resize(image_width * image_height);
+    std::vector<Tile> tile_list = make_tiles(image_width, image_height, tiles);
+    TileScheduler scheduler(tile_list, omp_get_max_threads());
+    ProgressReporter progress("光追", 1LL * image_width * image_height * samples_per_pixel);
 
-    #pragma omp parallel for schedule(dynamic, 1)
-    for (int j = image_height-1; j >= 0; --j) {
-        #pragma omp critical
+    #pragma omp parallel
+    {
+    // 采样器有状态，每个线程一份
+    std::unique_ptr<Sampler> sampler = sampler_proto.clone(samples_per_pixel);
+    Tile tile;
+    while (scheduler.next(omp_get_thread_num(), tile)) {
+        for (int row = tile.y0; row < tile.y1; ++row) {
+            for (int i0 = tile.x0; i0 < tile.x1; i0 += kCameraPacket) {
+                int n = std::min(kCameraPacket, tile.x1 - i0);
+                int pixel_base = row * image_width + i0;
+                Color pixel_color[kCameraPacket];
+                int pixels[kCameraPacket], samples[kCameraPacket];
+                for (int k = 0; k < n; ++k) pixels[k] = pixel_base + k;
+                for (int s = 0; s < samples_per_pixel; ++s) {
+                    Color radiance[kCameraPacket];
+                    for (int k = 0; k < n; ++k) samples[k] = s;
+                    trace_camera_packet(scene, cam, image_width, image_height, n, pixels, samples, max_depth, rr_min_bounce, *sampler, radiance, gbuffer);
+                    for (int k = 0; k < n; ++k) pixel_color[k] += radiance[k];
+                }
+
+                auto scale = 1.0 / samples_per_pixel;
+                for (int k = 0; k < n; ++k)
+                    hdr[pixel_base + k] = pixel_color[k] * scale;
+            }
+        }
+        progress.add(1LL * (tile.x1 - tile.x0) * (tile.y1 - tile.y0) * samples_per_pixel);
+    }
+    }
+    progress.finish();
+    // (降噪 +) Tone Mapping色调映射 + Gamma矫正
+    resolve_hdr(image_width, image_height, hdr, gbuffer ? *gbuffer : GBuffer(), denoise, buffer);
+    std::cout << "光追渲染完成。\n";
+}
+
+// 相对误差的分母下限：很暗的像素绝对误差已经看不出来，不按相对误差一直加样本
+const Real kAdaptiveMinLuminance = 0.05;
+// 单个像素最多用平均预算的多少倍
+const int kAdaptiveMaxFactor = 8;
+// 第一轮之后每一轮最多给 1/kAdaptiveRoundFraction 的像素加样本，误差最大的优先，加完重新排
+const int kAdaptiveRoundFraction = 4;
+
+/**
+* 像素的在线统计：颜色的和，以及亮度的均值和二阶中心矩之和（Welford 算法，一遍更新，数值稳定）
+*@brief relative_error() 均值的标准误差除以均值，样本不够两个时是无穷大
+*/
+struct PixelStats {
+    Color sum;
+    Real mean = 0;
+    Real m2 = 0;
+    int n = 0;
+
+    void add(const Color& c) {
+        sum += c;
+        ++n;
+        Real y = luminance(c);
+        Real delta = y - mean;
+        mean += delta / n;
+        m2 += delta * (y - mean);
+    }
+
+    Real relative_error() const {
+        if (n < 2) return infinity;
+        Real variance = m2 / (n - 1);
+        return std::sqrt(variance / n) / std::max(mean, kAdaptiveMinLuminance);
+    }
+};
+
+/**
+* 自适应采样的参数
+*@param threshold 像素的相对误差低于它就不再加样本，<= 0 表示不开自适应
+*@param min_spp   第一轮每个像素的样本数，0 表示取平均预算的 1/4（至少 4 个）
+*/
+struct AdaptiveSettings {
+    Real threshold = 0;
+    int min_spp = 0;
+};
+
+/**
+* 自适应采样的路径追踪：总预算还是 宽 x 高 x samples_per_pixel 个样本，但不平均分给每个像素。
+* 第一轮每个像素 min_spp 个样本，之后每一轮只给相对误差还高于阈值的像素再加 min_spp 个（预算不够时误差大的优先），
+* 收敛的像素（平坦的墙）省下来的预算都流向噪声大的地方（焦散、玻璃球下面），直到预算用完或者所有像素都收敛。
+* 每个像素的样本序号是连续的，采样器按 (像素, 样本) 定位，所以结果和线程数无关
+*@param & sample_counts 输出每个像素最后用了多少个样本（样本数分布图）
+*@param & denoise       降噪参数
+*@param gbuffer         不为空时记录第一个交点，同 render_path_tracing
+*/
+inline void render_path_tracing_adaptive(
+    const Scene& scene,
+    const Camera& cam,
+    int image_width,
+    int image_height,
+    int samples_per_pixel,
+    int max_depth,
+    int rr_min_bounce,
+    const Sampler& sampler_proto,
+    const AdaptiveSettings& settings,
+    std::vector<unsigned char>& buffer,
+    std::vector<int>& sample_counts,
+    const DenoiseSettings& denoise = DenoiseSettings(),
+    GBuffer* gbuffer = nullptr
+) {
+    const int pixel_count = image_width * image_height;
+    if (gbuffer) gbuffer->resize(pixel_count);
+    const int min_spp = settings.min_spp > 0 ? settings.min_spp
+                                             : std::min(samples_per_pixel, std::max(4, samples_per_pixel / 4));
+    const int max_spp = samples_per_pixel * kAdaptiveMaxFactor;
+    const long long budget = 1LL * pixel_count * samples_per_pixel;
+    std::cout << "开始自适应光追渲染, 采样器: " << sampler_proto.name() << ", 阈值: " << settings.threshold
+              << ", 每轮: " << min_spp << " spp, 单像素上限: " << max_spp << " spp" << std::endl;
+
+    std::vector<PixelStats> stats(pixel_count);
+    std::vector<int> active(pixel_count);
+    for (int p = 0; p < pixel_count; ++p) active[p] = p;
+    std::vector<Real> pixel_error(pixel_count), window_error(pixel_count);
+    std::vector<int> groups;
+    long long used = 0;
+    int rounds = 0;
+    ProgressReporter progress("自适应光追", budget);
+
+    for (int round = 0; !active.empty(); ++round) {
+        // 活跃像素按行切成最多 kCameraPacket 个一组，同一组的光线打成一个包
+        groups.clear();
+        for (int a = 0; a < static_cast<int>(active.size()); ++a)
+            if (groups.empty() || a - groups.back() == kCameraPacket || active[a] / image_width != active[groups.back()] / image_width)
+                groups.push_back(a);
+        groups.push_back(static_cast<int>(active.size()));
+        const int group_count = static_cast<int>(groups.size()) - 1;
+
+        long long round_samples = 0;
+        #pragma omp parallel reduction(+:round_samples)
         {
-            --height_remain;
-                std::cerr << "\r剩余高度height: " << height_remain << ' ' << std::flush;
+        std::unique_ptr<Sampler> sampler = sampler_proto.clone(max_spp);
+        #pragma omp for schedule(dynamic, 4)
+        for (int g = 0; g < group_count; ++g) {
+            int pixels[kCameraPacket], samples[kCameraPacket], lanes[kCameraPacket];
+            Color radiance[kCameraPacket];
+            long long group_samples = 0;
+            for (int r = 0; r < min_spp; ++r) {
+                // 到了单像素上限的像素不再参与这一轮剩下的样本
+                int n = 0;
+                for (int a = groups[g]; a < groups[g + 1]; ++a) {
+                    const PixelStats& st = stats[active[a]];
+                    if (st.n >= max_spp) continue;
+                    lanes[n] = active[a];
+                    pixels[n] = active[a];
+                    samples[n] = st.n;
+                    ++n;
+                }
+                if (n == 0) break;
+                trace_camera_packet(scene, cam, image_width, image_height, n, pixels, samples, max_depth, rr_min_bounce, *sampler, radiance, gbuffer);
+                for (int k = 0; k < n; ++k) stats[lanes[k]].add(radiance[k]);
+                group_samples += n;
+            }
+            round_samples += group_samples;
+            progress.add(group_samples);
+        }
         }
+        used += round_samples;
+
+        // 像素的误差取它 3x3 邻域里的最大值：少量样本恰好都没打到焦散的像素，会被邻居拉回活跃集合，不会过早判成收敛
+        #pragma omp parallel for schedule(static)
+        for (int p = 0; p < pixel_count; ++p) pixel_error[p] = stats[p].relative_error();
+        #pragma omp parallel for schedule(static)
+        for (int p = 0; p < pixel_count; ++p) {
+            int x = p % image_width, y = p / image_width;
+            Real e = 0;
+            for (int dy = -1; dy <= 1; ++dy)
+                for (int dx = -1; dx <= 1; ++dx) {
+                    int xx = x + dx, yy = y + dy;
+                    if (xx < 0 || yy < 0 || xx >= image_width || yy >= image_height) continue;
+                    e = std::max(e, pixel_error[yy * image_width + xx]);
+                }
+            window_error[p] = e;
+        }
+
+        // 下一轮只留误差还高于阈值的像素；剩下的预算不够每个像素一整轮时，误差最大的像素优先
+        std::vector<int> next;
+        for (int p = 0; p < pixel_count; ++p)
+            if (stats[p].n < max_spp && window_error[p] > settings.threshold) next.push_back(p);
+        const long long remaining = budget - used;
+        size_t keep = std::min<size_t>(static_cast<size_t>(remaining / min_spp), std::max(1, pixel_count / kAdaptiveRoundFraction));
+        if (next.size() > keep) {
+            std::sort(next.begin(), next.end(), [&](int a, int b) {
+                if (window_error[a] != window_error[b]) return window_error[a] > window_error[b];
+                return a < b;
+            });
+            next.resize(keep);
+            std::sort(next.begin(), next.end());
+        }
+        active.swap(next);
+        rounds = round + 1;
+    }
+    progress.finish();
+
+    std::vector<Color> hdr(pixel_count);
+    sample_counts.resize(pixel_count);
+    for (int p = 0; p < pixel_count; ++p) {
+        sample_counts[p] = stats[p].n;
+        hdr[p] = stats[p].sum / std::max(stats[p].n, 1);
+    }
+    resolve_hdr(image_width, image_height, hdr, gbuffer ? *gbuffer : GBuffer(), denoise, buffer);
+    std::cout << "自适应光追渲染完成, " << rounds << " 轮, 平均 " << double(used) / pixel_count << " spp。\n";
+}
 
-        for (int i = 0; i < image_width; ++i) {
-            Color pixel_color(0, 0, 0);
-            for (int s = 0; s < samples_per_pixel; ++s) {
-                auto u = (i + random_double()) / (image_width-1);
-                auto v = (j + random_double()) / (image_height-1);
-                Ray r = cam.get_ray(u, v);
-                pixel_color += ray_color(r, world, max_depth);
+/**
+* 渐进式路径追踪：每一遍 (pass) 给每个像素加 pass_spp 个样本，累加进 HDR 胶片，直到每个像素都有 samples_per_pixel 个。
+* 胶片里已经有样本（从检查点续算）时接着往后加，样本序号就是胶片里的样本数，
+* 每个像素按样本顺序累加，所以中途被杀掉再续算的结果和一次渲染完逐位相同。
+* 一遍结束时距离上次存检查点超过 checkpoint_interval 秒就存一次，全部完成时再存一次
+*@param samples_per_pixel    目标样本数
+*@param pass_spp            每一遍每个像素的样本数
+*@param & film               累加的胶片，可以是从检查点读出来的
+*@param & checkpoint         检查点文件路径，空字符串表示不存
+*@param checkpoint_interval 两次存检查点之间最少隔多少秒
+*@param time_budget         时间预算（秒），> 0 时不看 samples_per_pixel，一遍一遍算到预算用完：
+*                           按上一遍的耗时估计下一遍能不能在截止前算完，算不完就不开始；
+*                           估计偏了也会在截止时停在块边界上，只要已经有一整遍，剩下的块就不再加样本
+*@param & tiles             块的大小和遍历顺序
+*@param gbuffer            不为空时把这次运行的样本的第一个交点累加进去（降噪引导、AOV 输出），按像素数重新分配
+*/
+inline void render_path_tracing_progressive(
+    const Scene& scene,
+    const Camera& cam,
+    int samples_per_pixel,
+    int pass_spp,
+    int max_depth,
+    int rr_min_bounce,
+    const Sampler& sampler_proto,
+    Film& film,
+    const std::string& checkpoint,
+    double checkpoint_interval,
+    double time_budget = 0,
+    const TileSettings& tiles = TileSettings(),
+    GBuffer* gbuffer = nullptr
+) {
+    typedef std::chrono::steady_clock Clock;
+    const int image_width = film.width;
+    const int image_height = film.height;
+    const bool timed = time_budget > 0;
+    if (gbuffer) gbuffer->resize(image_width * image_height);
+    // 限时模式下样本数只受 run 的样本序号区间限制
+    const uint32_t target = timed ? kFilmRunStride : static_cast<uint32_t>(samples_per_pixel);
+    std::cout << "开始渐进式光追渲染, 采样器: " << sampler_proto.name() << ", 每遍 " << pass_spp << " spp, 已有 "
+              << film.min_count() << " spp, ";
+    if (timed) std::cout << "时间预算 " << time_budget << " 秒" << std::endl;
+    else std::cout << "目标 " << target << " spp" << std::endl;
+    const Clock::time_point start = Clock::now();
+    const Clock::time_point deadline = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(time_budget));
+    const long long start_samples = film.total_samples();
+    auto last_checkpoint = start;
+    double last_pass_seconds = 0;
+    int passes = 0;
+    const std::vector<Tile> tile_list = make_tiles(image_width, image_height, tiles);
+    long long remaining = 0;
+    for (uint32_t c : film.count) remaining += c < target ? target - c : 0;
+    ProgressReporter progress("渐进式光追", timed ? 0 : remaining, time_budget);
+
+    for (int pass = 0; film.min_count() < target; ++pass) {
+        const Clock::time_point pass_start = Clock::now();
+        // 已经有一整遍时才允许因为时间停下，否则图像会缺块
+        const bool can_stop = timed && film.min_count() > 0;
+        if (can_stop && pass_start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(last_pass_seconds)) > deadline) break;
+        TileScheduler scheduler(tile_list, omp_get_max_threads());
+        #pragma omp parallel
+        {
+        std::unique_ptr<Sampler> sampler = sampler_proto.clone(samples_per_pixel);
+        Tile tile;
+        while (scheduler.next(omp_get_thread_num(), tile)) {
+            if (can_stop && Clock::now() > deadline) continue;
+            long long tile_samples = 0;
+            for (int row = tile.y0; row < tile.y1; ++row)
+            for (int i0 = tile.x0; i0 < tile.x1; i0 += kCameraPacket) {
+                int pixels[kCameraPacket], samples[kCameraPacket];
+                Color radiance[kCameraPacket];
+                for (int r = 0; r < pass_spp; ++r) {
+                    int n = 0;
+                    for (int p = row * image_width + i0; p < row * image_width + std::min(i0 + kCameraPacket, tile.x1); ++p) {
+                        if (film.count[p] >= target) continue;
+                        pixels[n] = p;
+                        samples[n] = static_cast<int>(film.sample_index(film.count[p]));
+                        ++n;
+                    }
+                    if (n == 0) break;
+                    trace_camera_packet(scene, cam, image_width, image_height, n, pixels, samples, max_depth, rr_min_bounce, *sampler, radiance, gbuffer);
+                    for (int k = 0; k < n; ++k) film.add(pixels[k], radiance[k]);
+                    tile_samples += n;
+                }
             }
-            
-            // Tone Mapping色调映射 + Gamma矫正
-            auto scale = 1.0 / samples_per_pixel;
-            Vec3 color = pixel_color * scale;
-            color = aces_approx(color);
-
-            auto r = sqrt(color.x());
-            auto g = sqrt(color.y());
-            auto b = sqrt(color.z());
-
-            int index = ((image_height - 1 - j) * image_width + i) * 3;
-            buffer[index] = static_cast<unsigned char>(256 * clamp(r, 0.0, 0.999));
-            buffer[index+1] = static_cast<unsigned char>(256 * clamp(g, 0.0, 0.999));
-            buffer[index+2] = static_cast<unsigned char>(256 * clamp(b, 0.0, 0.999));
+            progress.add(tile_samples);
         }
+        }
+
+        auto now = Clock::now();
+        last_pass_seconds = std::chrono::duration<double>(now - pass_start).count();
+        passes = pass + 1;
+        bool done = film.min_count() >= target;
+        if (!checkpoint.empty() && (done || std::chrono::duration<double>(now - last_checkpoint).count() >= checkpoint_interval)) {
+            film.save(checkpoint);
+            last_checkpoint = now;
+        }
+        if (timed && now >= deadline) break;
     }
-    std::cout << "\n光追渲染完成。\n";
+    // 限时模式是因为时间停下的，最后的状态还没存
+    if (timed && !checkpoint.empty()) film.save(checkpoint);
+    progress.finish();
+
+    const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    const long long samples = film.total_samples() - start_samples;
+    std::cout << "渐进式光追渲染完成, " << passes << " 遍, 本次 " << samples << " 个样本, 用时 " << seconds << " 秒, "
+              << samples / std::max(seconds, 1e-9) / 1e6 << " M样本/秒, 平均 "
+              << double(film.total_samples()) / film.pixel_count() << " spp (最少 " << film.min_count() << ")\n";
 }
 
 #endif
@@ -7,12 +7,19 @@
 #include "camera.h"
 #include "material.hpp"
 #include "sphere.h" 
+#include "sampler.h"
+#include "sampling.h"
+#include "denoiser.h"
+#include "tile_scheduler.h"
+#include "progress.h"
 #include <vector>
 #include <list>
+#include <chrono>
 #include <cmath>
 #include <iostream>
 #include <omp.h>
 #include <algorithm>
+#include <atomic>
 
 // 光子结构体
 struct Photon {
@@ -22,10 +29,10 @@ struct Photon {
 };
 
 // 估算辐射度：查找附近的 N 个光子
-inline Color estimate_radiance(const KDTree<Photon>& map, const Point3& p, const Vec3& normal, double radius) {
+inline Color estimate_radiance(const KDTree<Photon>& map, const Point3& p, const Vec3& normal, Real radius) {
     Color flux(0,0,0);
     int count = 0;
-    map.search(p, radius, [&](Photon* photon, double dist_sq) {
+    map.search(p, radius, [&](Photon* photon, Real dist_sq) {
         if (dot(normal, photon->dir) < 0) { // 法线检查
             flux += photon->power;
             count++;
@@ -40,14 +47,15 @@ inline Color estimate_radiance(const KDTree<Photon>& map, const Point3& p, const
 // pass1光子追踪：发射光子并存储在 photon map 中
 // 标志in_caustic_path: 标记当前光子是否处于从光源出发的折射/反射路径中 (L S ...)
 inline void trace_photon_pm(Ray ray, int dep, Color power, std::vector<Photon>& global_photons, 
-    std::vector<Photon>& caustic_photons, const HittableObjList& world, bool in_caustic_path) {
+    std::vector<Photon>& caustic_photons, const HittableObj& world, bool in_caustic_path) {
     if (max_in_xyz(power) < 1e-9) return;// 如果辐射通量的最大分量小于1e-9,说明该光子已经被材质所吸收，直接返回
     HitRecord rec;
-    if (!world.hit(ray, 0.001, infinity, rec)) return;//如果射到世界world外面了，也返回
+    count_rays();
+    if (!world.hit(ray, kRayTMin, infinity, rec)) return;//如果射到世界world外面了，也返回
     // 1. 判断是否需要存储光子
     // 如果是漫反射表面 (且不是光源)，则存储光子
-    std::pair<Refl_t, Color> feature = get_feature(rec.mat_ptr, rec.p);
-    bool is_diffuse_light = (std::dynamic_pointer_cast<DiffuseLight>(rec.mat_ptr) != nullptr);
+    std::pair<Refl_t, Color> feature = get_feature(rec);
+    bool is_diffuse_light = (material_as<DiffuseLight>(rec.mat_ptr) != nullptr);
     if (feature.first == DIFF && !is_diffuse_light) {
         if (in_caustic_path) {
             // 路径: L ...S D caustic 存入 Caustic Map
@@ -65,7 +73,7 @@ inline void trace_photon_pm(Ray ray, int dep, Color power, std::vector<Photon>&
         Color new_power = power * attenuation;
         
         // 俄罗斯轮盘赌 (Russian Roulette)
-        double p_survive = max_in_xyz(attenuation);
+        Real p_survive = max_in_xyz(attenuation);
         if (p_survive > 1.0) p_survive = 1.0;
         
         if (++dep > 5) {
@@ -85,17 +93,29 @@ inline void trace_photon_pm(Ray ray, int dep, Color power, std::vector<Photon>&
     }
 }
 
+inline Color eye_shade_hit(const Ray& ray, const HitRecord& rec, int dep, int max_depth, Sampler& sampler, const HittableObj& world, const std::vector<Emitter>& lights, const KDTree<Photon>& global_map, const KDTree<Photon>& caustic_map, Real global_radius, Real caustic_radius, int fg_samples, bool gather_only);
+
+// Final Gather 光线包的宽度：同一个着色点发出的光线一起求交
+const int kGatherPacket = 16;
+
 // pass2光线追踪：使用光子图估算辐射度
 // 标志gather_only: 如果为 true，表示当前是 Final Gather 的次级光线，击中漫反射表面时直接查询光子图
-inline Color eye_trace_estimate(Ray ray, int dep, int max_depth, const HittableObjList& world, const std::vector<shared_ptr<HittableObj>>& lights, const KDTree<Photon>& global_map, const KDTree<Photon>& caustic_map, double global_radius, double caustic_radius, bool gather_only = false) {
+inline Color eye_trace_estimate(Ray ray, int dep, int max_depth, Sampler& sampler, const HittableObj& world, const std::vector<Emitter>& lights, const KDTree<Photon>& global_map, const KDTree<Photon>& caustic_map, Real global_radius, Real caustic_radius, int fg_samples, bool gather_only = false) {
     HitRecord rec;
-    if (!world.hit(ray, 0.001, infinity, rec)) return Color(0,0,0); // 背景色
+    count_rays();
+    if (!world.hit(ray, kRayTMin, infinity, rec)) return Color(0,0,0); // 背景色
+    return eye_shade_hit(ray, rec, dep, max_depth, sampler, world, lights, global_map, caustic_map, global_radius, caustic_radius, fg_samples, gather_only);
+}
+
+// 已经求好交点之后的着色，Final Gather 的光线包求交之后从这里接着算
+inline Color eye_shade_hit(const Ray& ray, const HitRecord& rec, int dep, int max_depth, Sampler& sampler, const HittableObj& world, const std::vector<Emitter>& lights, const KDTree<Photon>& global_map, const KDTree<Photon>& caustic_map, Real global_radius, Real caustic_radius, int fg_samples, bool gather_only) {
+    sampler.start_bounce(dep); // 这次反弹的随机决策用第 dep 块维度
     //photon 信息：
     Point3 x = rec.p;//photon的位置=光线撞到的点
     Vec3 n = rec.normal;//photon撞到的表面的法线=光线撞到的表面的法线
     Vec3 nl = dot(n, ray.direction()) < 0 ? n : -n;//调整法线方向，使其指向入射光线的一侧
     
-    std::pair<Refl_t, Color> feature = get_feature(rec.mat_ptr, x);
+    std::pair<Refl_t, Color> feature = get_feature(rec);
     Color f = feature.second;
     
     if (feature.first == DIFF) {
@@ -103,8 +123,8 @@ inline Color eye_trace_estimate(Ray ray, int dep, int max_depth, const HittableO
         if (gather_only) {
             // 检查是否是光源
             Color emitted(0,0,0);
-            if (auto diff_light = std::dynamic_pointer_cast<DiffuseLight>(rec.mat_ptr)) {
-                emitted = diff_light->emit->value(0,0, x);
+            if (auto diff_light = material_as<DiffuseLight>(rec.mat_ptr)) {
+                emitted = eval_texture(diff_light->emit.get(), rec.u, rec.v, x);
             }
             // 查询全局光子图
             Color irradiance = estimate_radiance(global_map, x, nl, global_radius);
@@ -114,31 +134,24 @@ inline Color eye_trace_estimate(Ray ray, int dep, int max_depth, const HittableO
         Color direct(0,0,0);
         for (const auto& light : lights) {
             // 假设光源是球体 (Sphere)
-            if (auto sphere = std::dynamic_pointer_cast<Sphere>(light)) {
-                // 在光源上采样一点
-                Vec3 point_on_light = sphere->center + random_unit_vector() * sphere->radius;
-                Vec3 to_light = point_on_light - x;
-                double dist_sq = to_light.length_squared();
-                double dist = sqrt(dist_sq);
-                Vec3 light_dir = to_light / dist;
+            if (const Sphere* sphere = light.sphere) {
+                // 在光源朝向着色点的那个圆锥里按立体角采样一点，样本不会落到光源背面
+                Real lu, lv;
+                sampler.get_2d(lu, lv);
+                SphereLightSample ls;
+                if (!sample_sphere_solid_angle(sphere->center, sphere->radius, x, lu, lv, ls)) continue;
+                Vec3 light_dir = ls.wi;
                 if (dot(nl, light_dir) > 0) { // 面向光源
-                    Ray shadow_ray(x, light_dir);
+                    Ray shadow_ray = rec.spawn_ray(light_dir);
                     HitRecord shadow_rec;
                     // 检查可见性 (Shadow Ray)
-                    if (!world.hit(shadow_ray, 0.001, dist - 0.001, shadow_rec)) {
-                        // 可见
-                        if (auto diff_light = std::dynamic_pointer_cast<DiffuseLight>(sphere->mat_ptr)) {
-                            Color Le = diff_light->emit->value(0,0, point_on_light);
-                            double cos_theta = dot(nl, light_dir);
-                            Vec3 light_normal = unit_vector(point_on_light - sphere->center);
-                            double cos_theta_light = dot(-light_dir, light_normal);  
-                            if (cos_theta_light > 0) {
-                                double area = 4 * pi * sphere->radius * sphere->radius;
-                                // Lo = Le * f_r * cos_theta * (cos_theta_light * Area / dist^2)
-                                // f_r = albedo / pi
-                                direct += Le * f * (1.0/pi) * cos_theta * cos_theta_light * area / dist_sq;
-                            }
-                        }
+                    count_rays();
+                    if (!world.hit(shadow_ray, kRayTMin, ls.dist - kRayTMin, shadow_rec)) {
+                        // 可见，Le 在 Scene::commit 时已经算好
+                        Color Le = light.radiance;
+                        Real cos_theta = dot(nl, light_dir);
+                        // Lo = Le * f_r * cos_theta / pdf，pdf 是对立体角的；f_r = albedo / pi
+                        direct += Le * f * (1.0/pi) * cos_theta / ls.pdf;
                     }
                 }
             }
@@ -150,20 +163,41 @@ inline Color eye_trace_estimate(Ray ray, int dep, int max_depth, const HittableO
         // 向半球空间发射许多条主光线。当这些光线击中周围环境时，从主光变成了次级光线,在那个击中点查询光子图，获取那里的辐射度，
         // 然后将其作为入射光计算当前点的颜色。最后对所有次级光线的结果取平均。
         //相当于做了一次单反弹的路径追踪
+        // 每条 gather 光线是一个单独的样本：gather 采样器的样本数是 fg_samples，第 i 条光线就是第 i 个样本，
+        // 半球方向用它相机块的两维，低差异序列下同样的噪声水平需要的 gather 光线少很多
         Color indirect(0,0,0);
-        int fg_samples = 512; // Final Gather 采样数，越多越好但越慢
-        for (int i = 0; i < fg_samples; ++i) {
-            // 半球余弦采样
-            double r1 = 2 * pi * random_double();
-            double r2 = random_double();
-            double r2s = sqrt(r2);
-            Vec3 u = unit_vector(cross((fabs(nl.x()) > .1 ? Vec3(0, 1, 0) : Vec3(1, 0, 0)), nl));
-            Vec3 v = cross(nl, u);
-            Vec3 d = unit_vector(u * cos(r1) * r2s + v * sin(r1) * r2s + nl * sqrt(1 - r2));
-            // 发射主光线，设置 gather_only = true
-            Color Li = eye_trace_estimate(Ray(x, d), dep + 1, max_depth, world, lights, global_map, 
-            caustic_map, global_radius, caustic_radius, true);
-            indirect += Li * f;
+        std::unique_ptr<Sampler> gather = sampler.clone(fg_samples);
+        uint64_t gather_key = hash_combine(sampler.pixel_key(), (static_cast<uint64_t>(sampler.sample_index()) << 8) | dep);
+        Vec3 u = unit_vector(cross((fabs(nl.x()) > .1 ? Vec3(0, 1, 0) : Vec3(1, 0, 0)), nl));
+        Vec3 v = cross(nl, u);
+        // 这些光线都从同一点出发，kGatherPacket 条打成一个包一起遍历场景
+        for (int i0 = 0; i0 < fg_samples; i0 += kGatherPacket) {
+            int n = std::min(kGatherPacket, fg_samples - i0);
+            RayPacket packet(n);
+            for (int k = 0; k < n; ++k) {
+                // 半球余弦采样
+                gather->start_pixel_sample(gather_key, i0 + k);
+                Real r1, r2;
+                gather->get_2d(r1, r2);
+                r1 *= 2 * pi;
+                Real r2s = sqrt(r2);
+                Vec3 d = unit_vector(u * cos(r1) * r2s + v * sin(r1) * r2s + nl * sqrt(1 - r2));
+                packet.set(k, rec.spawn_ray(d));
+            }
+            packet.finalize();
+            PacketHits hits;
+            count_rays(n);
+            world.hit_packet(packet, packet.active, kRayTMin, hits);
+            for (int k = 0; k < n; ++k) {
+                if (!(hits.mask & (1u << k))) continue; // 背景色是黑的
+                HitRecord gather_rec;
+                hits.surface(packet, k, gather_rec);
+                // 发射主光线，设置 gather_only = true；次级路径接着用这条 gather 光线自己的样本
+                gather->start_pixel_sample(gather_key, i0 + k);
+                Color Li = eye_shade_hit(packet.ray(k), gather_rec, dep + 1, max_depth, *gather, world, lights, global_map,
+                caustic_map, global_radius, caustic_radius, fg_samples, true);
+                indirect += Li * f;
+            }
         }
         indirect = indirect / fg_samples;
         
@@ -171,37 +205,37 @@ inline Color eye_trace_estimate(Ray ray, int dep, int max_depth, const HittableO
 
     } else if (feature.first == SPEC) {
         if (dep > max_depth) return Color(0,0,0);//超过最大递归深度就返回黑色
-        Ray reflray = Ray(x, reflect(ray.direction(), n));
+        Ray reflray = rec.spawn_ray(reflect(ray.direction(), n));
         // 镜面反射继续递归，保持 gather_only 状态
-        return f * eye_trace_estimate(reflray, dep + 1, max_depth, world, lights, global_map, caustic_map, global_radius, caustic_radius, gather_only);
+        return f * eye_trace_estimate(reflray, dep + 1, max_depth, sampler, world, lights, global_map, caustic_map, global_radius, caustic_radius, fg_samples, gather_only);
     } else if (feature.first == REFR) {
         if (dep > max_depth) return Color(0,0,0);//超过最大递归深度就返回黑色   
-        double refraction_ratio = dot(n, ray.direction()) < 0 ? (1.0/1.5) : 1.5;
+        Real refraction_ratio = dot(n, ray.direction()) < 0 ? (1.0/1.5) : 1.5;
         Vec3 unit_dir = unit_vector(ray.direction());
-        double cos_theta = fmin(dot(-unit_dir, nl), 1.0);
-        double sin_theta = sqrt(1.0 - cos_theta*cos_theta);
+        Real cos_theta = fmin(dot(-unit_dir, nl), 1.0);
+        Real sin_theta = sqrt(1.0 - cos_theta*cos_theta);
         bool cannot_refract = refraction_ratio * sin_theta > 1.0;
         
         Vec3 d_refracted;
         if (!cannot_refract) d_refracted = refract(unit_dir, nl, refraction_ratio);
         
         if (cannot_refract) {
-            return f * eye_trace_estimate(Ray(x, reflect(unit_dir, nl)), dep + 1, max_depth, world, lights, global_map, caustic_map, global_radius, caustic_radius, gather_only);
+            return f * eye_trace_estimate(rec.spawn_ray(reflect(unit_dir, nl)), dep + 1, max_depth, sampler, world, lights, global_map, caustic_map, global_radius, caustic_radius, fg_samples, gather_only);
         } else {
             auto r0 = (1-1.5)/(1+1.5); r0 = r0*r0;
-            double Re = r0 + (1-r0)*pow((1 - cos_theta), 5);
-            double Tr = 1 - Re;
-            double P = .25 + .5 * Re;
+            Real Re = r0 + (1-r0)*pow((1 - cos_theta), 5);
+            Real Tr = 1 - Re;
+            Real P = .25 + .5 * Re;
             
             if (dep < 3) {
-                Color reflection = eye_trace_estimate(Ray(x, reflect(unit_dir, nl)), dep + 1, max_depth, world, lights, global_map, caustic_map, global_radius, caustic_radius, gather_only);
-                Color refraction = eye_trace_estimate(Ray(x, d_refracted), dep + 1, max_depth, world, lights, global_map, caustic_map, global_radius, caustic_radius, gather_only);
+                Color reflection = eye_trace_estimate(rec.spawn_ray(reflect(unit_dir, nl)), dep + 1, max_depth, sampler, world, lights, global_map, caustic_map, global_radius, caustic_radius, fg_samples, gather_only);
+                Color refraction = eye_trace_estimate(rec.spawn_ray(d_refracted), dep + 1, max_depth, sampler, world, lights, global_map, caustic_map, global_radius, caustic_radius, fg_samples, gather_only);
                 return f * (Re * reflection + Tr * refraction);
             } else {
-                if (random_double() < P) {
-                    return f * (Re/P) * eye_trace_estimate(Ray(x, reflect(unit_dir, nl)), dep + 1, max_depth, world, lights, global_map, caustic_map, global_radius, caustic_radius, gather_only);
+                if (sampler.get_1d() < P) {
+                    return f * (Re/P) * eye_trace_estimate(rec.spawn_ray(reflect(unit_dir, nl)), dep + 1, max_depth, sampler, world, lights, global_map, caustic_map, global_radius, caustic_radius, fg_samples, gather_only);
                 } else {
-                    return f * (Tr/(1-P)) * eye_trace_estimate(Ray(x, d_refracted), dep + 1, max_depth, world, lights, global_map, caustic_map, global_radius, caustic_radius, gather_only);
+                    return f * (Tr/(1-P)) * eye_trace_estimate(rec.spawn_ray(d_refracted), dep + 1, max_depth, sampler, world, lights, global_map, caustic_map, global_radius, caustic_radius, fg_samples, gather_only);
                 }
             }
         }
@@ -209,20 +243,50 @@ inline Color eye_trace_estimate(Ray ray, int dep, int max_depth, const HittableO
     return Color(0,0,0);
 }
 
-// PM 主渲染函数
-inline void render_pm(
-    const HittableObjList& world, 
-    const std::vector<shared_ptr<HittableObj>>& lights,
+typedef std::chrono::steady_clock PmClock;
+
+// 光子按这么多个一批分给线程，每个线程也攒够一批才上交一次进度（一次 add 是三次原子加）
+const int kPmPhotonBatch = 64;
+
+/**
+* PM 单次渲染（一轮）：用 num_photons 个光子和 fg_samples 条 final gather 光线渲染一整张 HDR 图像，final_image 第 0 行是图像顶部
+* 第 round 轮的光子用自己的随机数流，视线用像素的第 round 个样本，不同轮的图像互相独立，可以直接平均
+* 限时的时候光子阶段只用到截止前剩余时间的一半就停止发射（另一半留给不能打断的光子图构建和视线阶段），
+* 已经发射的光子按实际数目放大能量；到了 deadline 视线阶段剩下的块不做 final gather，
+* 直接在第一个漫反射交点查全局光子图（便宜得多，噪声大一些），图像仍然是完整的
+*@param gbuffer  不为空时记录第一个交点，第 0 轮时按像素数重新分配，之后的轮接着累加
+*@param round    第几轮
+*@param deadline 截止时间，默认不限时
+*@param photons_emitted 不为空时写入实际发射的光子数
+*@return 这一轮是否在截止前完整做完
+*/
+inline bool render_pm_image(
+    const Scene& scene, 
     const Camera& cam, 
     int image_width, 
     int image_height, 
     int num_photons, 
     int max_depth,
-    double radius,
-    std::vector<unsigned char>& buffer
+    Real radius,
+    const Sampler& sampler_proto,
+    int fg_samples,
+    std::vector<Color>& final_image,
+    const TileSettings& tiles = TileSettings(),
+    GBuffer* gbuffer = nullptr,
+    int round = 0,
+    PmClock::time_point deadline = PmClock::time_point::max(),
+    long long* photons_emitted = nullptr
 ) {
+    const bool timed = deadline != PmClock::time_point::max();
+    const PmClock::time_point photon_deadline = timed ? PmClock::now() + (deadline - PmClock::now()) / 2 : deadline;
+    std::atomic<bool> out_of_time(false);
     std::cout << "pm渲染中" << std::endl;
     std::cout << "光子总数: " << num_photons << ", 查询半径: " << radius << std::endl;
+    std::cout << "采样器: " << sampler_proto.name() << ", Final Gather 光线数: " << fg_samples << std::endl;
+
+    // 光子和视线的每次弹射、阴影测试、final gather 都在 commit 好的加速结构上求交
+    const HittableObj& world = scene.accel();
+    const std::vector<Emitter>& lights = scene.emitters;
 
     // 1. Photon Pass
     std::cout << "Pass1:光子图的构建..." << std::endl;
@@ -231,65 +295,187 @@ inline void render_pm(
     global_photons.reserve(num_photons);
     caustic_photons.reserve(num_photons / 4); // 预估焦散光子较少
     
-    #pragma omp parallel for schedule(dynamic, 1)
+    ProgressReporter photon_progress("光子", num_photons);
+    long long emitted = 0;
+    #pragma omp parallel
+    {
+    int pending = 0; // 这个线程还没上交给进度报告的光子数
+    #pragma omp for schedule(dynamic, kPmPhotonBatch) reduction(+:emitted) nowait
     for (int i = 0; i < num_photons; ++i) {
-        if (lights.empty()) continue;
-        int light_idx = static_cast<int>(random_double(0, lights.size()-0.01));
-        auto light = lights[light_idx];
-        if (auto sphere = std::dynamic_pointer_cast<Sphere>(light)) {
-            Point3 origin = sphere->center + random_unit_vector() * sphere->radius;
-            Vec3 dir = random_unit_vector();
-            if (dot(dir, origin - sphere->center) < 0) dir = -dir;
+        if (lights.empty() || out_of_time.load(std::memory_order_relaxed)) continue;
+        // 限时的时候每 256 个光子看一次表
+        if (timed && (i & 255) == 0 && PmClock::now() > photon_deadline) {
+            out_of_time.store(true, std::memory_order_relaxed);
+            continue;
+        }
+        ++emitted;
+        rng_begin_sample(kRngPhotonStream + uint64_t(round) * num_photons + i, 0); // 每个光子一条随机数流
+        // 按功率选光源，光子能量要除以选中它的概率
+        Real light_pdf;
+        const Emitter& light = lights[scene.sample_emitter(random_double(), light_pdf)];
+        if (const Sphere* sphere = light.sphere) {
+            // 球面上均匀取发射点，方向按漫射光源的余弦分布，和 power = Le * area * pi 一致
+            Real u1 = random_double(), u2 = random_double();
+            Vec3 light_normal = sample_uniform_sphere(u1, u2);
+            Point3 origin = sphere->center + light_normal * sphere->radius;
+            Real u3 = random_double(), u4 = random_double();
+            Vec3 dir = Onb(light_normal).to_world(sample_cosine_hemisphere(u3, u4));
             
-            Color L = std::dynamic_pointer_cast<DiffuseLight>(sphere->mat_ptr)->emit->value(0,0,origin);
-            double area = 4 * pi * sphere->radius * sphere->radius;
-            Color photon_power = L * area * pi / num_photons;
+            Color photon_power = light.power / (light_pdf * num_photons);
             
             // 初始 in_caustic_path = true，因为从光源出来
+            count_photons();
             trace_photon_pm(Ray(origin, dir), 0, photon_power, global_photons, caustic_photons, world, true);
         }
+        if (++pending == kPmPhotonBatch) {
+            photon_progress.add(pending);
+            pending = 0;
+        }
     }
+    photon_progress.add(pending);
+    }
+    photon_progress.finish();
+    // 光子插入的顺序取决于线程调度，排序后光子图和线程数无关
+    auto photon_less = [](const Photon& a, const Photon& b) {
+        if (vec_less(a.p, b.p)) return true;
+        if (vec_less(b.p, a.p)) return false;
+        if (vec_less(a.dir, b.dir)) return true;
+        if (vec_less(b.dir, a.dir)) return false;
+        return vec_less(a.power, b.power);
+    };
+    std::sort(global_photons.begin(), global_photons.end(), photon_less);
+    std::sort(caustic_photons.begin(), caustic_photons.end(), photon_less);
+    if (emitted > 0 && emitted < num_photons) {
+        // 到点时只发射了一部分，光子能量是按 num_photons 分的，按实际发射的数目放大
+        Real scale = Real(num_photons) / emitted;
+        for (Photon& p : global_photons) p.power *= scale;
+        for (Photon& p : caustic_photons) p.power *= scale;
+        std::cout << "到达时间预算，只发射了 " << emitted << " 个光子" << std::endl;
+    }
+    if (photons_emitted) *photons_emitted = emitted;
     std::cout << "全局光照的光子数量: " << global_photons.size() << std::endl;
     std::cout << "焦散的光子数量: " << caustic_photons.size() << std::endl;
 
     // 2. 构建光子图
     std::cout << "构建光子图中" << std::endl;
     // Global Map 
-    double global_radius = radius; 
+    Real global_radius = radius; 
     KDTree<Photon> global_map(global_photons);
 
     // Caustic Map cell_size可以小一点，让焦散图更精细
-    double caustic_radius = radius*0.8;
+    Real caustic_radius = radius*0.8;
     KDTree<Photon> caustic_map(caustic_photons);
 
     // 3. Eye Pass (Render)
     std::cout << "pass2: 渲染图像中" << std::endl;
-    std::vector<Color> final_image(image_width * image_height);
-    
-    #pragma omp parallel for schedule(dynamic, 1)
-    for (int j = image_height-1; j >= 0; --j) {
-        for (int i = 0; i < image_width; ++i) {
-            auto u = (i + random_double()) / (image_width-1);
-            auto v = (j + random_double()) / (image_height-1);
-            Ray r = cam.get_ray(u, v);
-            
-            Color pixel_color = eye_trace_estimate(r, 0, max_depth, world, lights, global_map, caustic_map, global_radius, caustic_radius);
-            final_image[(image_height - 1 - j) * image_width + i] = pixel_color;
+    final_image.assign(image_width * image_height, Color(0, 0, 0));
+    if (gbuffer && round == 0) gbuffer->resize(image_width * image_height);
+    std::atomic<bool> eye_out_of_time(false);
+
+    // final gather 的开销集中在少数区域，按块调度，相邻的块先后落在同一个线程上，查询的光子图也是同一片
+    TileScheduler scheduler(make_tiles(image_width, image_height, tiles), omp_get_max_threads());
+    ProgressReporter eye_progress("视线", image_width * image_height);
+    #pragma omp parallel
+    {
+    std::unique_ptr<Sampler> sampler = sampler_proto.clone(1); // 每个像素一条视线
+    Tile tile;
+    while (scheduler.next(omp_get_thread_num(), tile)) {
+        if (timed && !eye_out_of_time.load(std::memory_order_relaxed) && PmClock::now() > deadline)
+            eye_out_of_time.store(true, std::memory_order_relaxed);
+        // 超时之后的块不做 final gather，第一个漫反射交点直接查光子图
+        const bool quick = eye_out_of_time.load(std::memory_order_relaxed);
+        for (int row = tile.y0; row < tile.y1; ++row) {
+            int j = image_height - 1 - row;
+            for (int i = tile.x0; i < tile.x1; ++i) {
+                sampler->start_pixel_sample(row * image_width + i, round);
+                Real du, dv;
+                sampler->get_2d(du, dv);
+                auto u = (i + du) / (image_width-1);
+                auto v = (j + dv) / (image_height-1);
+                Ray r = cam.get_ray(u, v);
+                
+                // 第一个交点在这里求，顺便记进 G-buffer，再交给 eye_shade_hit，和 eye_trace_estimate 一样
+                HitRecord rec;
+                count_rays();
+                Color pixel_color(0, 0, 0);
+                if (world.hit(r, kRayTMin, infinity, rec)) {
+                    if (gbuffer) gbuffer->add(row * image_width + i, first_hit(r, rec));
+                    pixel_color = eye_shade_hit(r, rec, 0, max_depth, *sampler, world, lights, global_map, caustic_map, global_radius, caustic_radius, fg_samples, quick);
+                } else if (gbuffer) {
+                    gbuffer->add(row * image_width + i, FirstHit());
+                }
+                final_image[row * image_width + i] = pixel_color;
+            }
         }
+        eye_progress.add((tile.x1 - tile.x0) * (tile.y1 - tile.y0));
     }
+    }
+    eye_progress.finish();
+    if (eye_out_of_time.load()) std::cout << "到达时间预算，剩下的块没有做 final gather" << std::endl;
+    return !out_of_time.load() && !eye_out_of_time.load();
+}
 
-    buffer.assign(image_width * image_height * 3, 0);
-    for (int i = 0; i < image_width * image_height; ++i) {
-        Color c = final_image[i];
-        c = aces_approx(c);
-        auto r = sqrt(c.x());
-        auto g = sqrt(c.y());
-        auto b = sqrt(c.z());
-        buffer[i*3] = static_cast<unsigned char>(256 * clamp(r, 0.0, 0.999));
-        buffer[i*3+1] = static_cast<unsigned char>(256 * clamp(g, 0.0, 0.999));
-        buffer[i*3+2] = static_cast<unsigned char>(256 * clamp(b, 0.0, 0.999));
+/**
+* 光子映射渲染
+* time_budget > 0 时渐进地渲染：每轮用同样的 num_photons 个光子和 fg_samples 条 final gather 光线（各轮的随机数互相独立），
+* 完整做完的各轮图像取平均，噪声随轮数下降。同样规模的下一轮按上一轮的耗时估计，预计超时就不开始；
+* 截止时间也传进每一轮里，第一轮就超时时按 render_pm_image 的规则提前收尾，之后的轮没做完就丢掉
+*@param time_budget 时间预算（秒），<= 0 时只渲染一轮
+*@param & tiles     视线阶段分块的大小和遍历顺序
+*@param & denoise   降噪参数，打开时要传 gbuffer 作为引导
+*@param gbuffer     不为空时在视线阶段记录第一个交点（降噪引导、AOV 输出），限时模式下累加所有轮
+*/
+inline void render_pm(
+    const Scene& scene, 
+    const Camera& cam, 
+    int image_width, 
+    int image_height, 
+    int num_photons, 
+    int max_depth,
+    Real radius,
+    const Sampler& sampler_proto,
+    int fg_samples,
+    std::vector<unsigned char>& buffer,
+    double time_budget = 0,
+    const TileSettings& tiles = TileSettings(),
+    const DenoiseSettings& denoise = DenoiseSettings(),
+    GBuffer* gbuffer = nullptr
+) {
+    typedef std::chrono::steady_clock Clock;
+    const Clock::time_point start = Clock::now();
+    std::vector<Color> final_image;
+    int rounds = 1;
+    long long total_photons = num_photons;
+    if (time_budget <= 0) {
+        render_pm_image(scene, cam, image_width, image_height, num_photons, max_depth, radius, sampler_proto, fg_samples, final_image, tiles, gbuffer);
+    } else {
+        std::cout << "pm时间预算: " << time_budget << " 秒" << std::endl;
+        const Clock::time_point deadline = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(time_budget));
+        std::vector<Color> round_image;
+        double round_seconds = 0;
+        bool complete = true;
+        long long photons = 0;
+        for (int round = 0; complete; ++round) {
+            const Clock::time_point round_start = Clock::now();
+            double elapsed = std::chrono::duration<double>(round_start - start).count();
+            if (round > 0 && elapsed + round_seconds > time_budget) break;
+            std::cout << "第 " << round + 1 << " 轮" << std::endl;
+            complete = render_pm_image(scene, cam, image_width, image_height, num_photons, max_depth, radius, sampler_proto, fg_samples,
+                                       round == 0 ? final_image : round_image, tiles, gbuffer, round, deadline, &photons);
+            round_seconds = std::chrono::duration<double>(Clock::now() - round_start).count();
+            if (round == 0) total_photons = photons;
+            if (round == 0 || !complete) continue; // 第一轮不管做没做完都要用；之后没做完的轮丢掉
+            total_photons += photons;
+            for (int p = 0; p < image_width * image_height; ++p) final_image[p] += round_image[p];
+            ++rounds;
+        }
+        for (int p = 0; p < image_width * image_height; ++p) final_image[p] /= rounds;
     }
-    std::cout << "完成" << std::endl;
+
+    resolve_hdr(image_width, image_height, final_image, gbuffer ? *gbuffer : GBuffer(), denoise, buffer);
+    const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    std::cout << "完成, 最终图像平均了 " << rounds << " 轮, 每轮 " << num_photons << " 个光子、" << fg_samples << " 条 final gather 光线; 共 "
+              << total_photons << " 个光子, 用时 " << seconds << " 秒, " << total_photons / std::max(seconds, 1e-9) / 1e6 << " M光子/秒" << std::endl;
 }
 
 #endif
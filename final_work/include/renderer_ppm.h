@@ -7,8 +7,14 @@
 #include "camera.h"
 #include "material.hpp"
 #include "sphere.h" 
+#include "sampler.h"
+#include "sampling.h"
+#include "denoiser.h"
+#include "tile_scheduler.h"
+#include "progress.h"
 #include <vector>
 #include <list>
+#include <chrono>
 #include <cmath>
 #include <iostream>
 #include <omp.h>
@@ -23,46 +29,55 @@ struct HitPoint {
     int pixel_index;    // 对应的图像像素索引
     
     // PPM 统计数据
-    double r2;          // 当前光子搜索半径的平方，这里用平方避免乘的那个系数开根号
-    double n_new;       // 当前迭代收集到的光子数量
+    Real r2;          // 当前光子搜索半径的平方，这里用平方避免乘的那个系数开根号
+    Real n_new;       // 当前迭代收集到的光子数量
     Color flux_new;     // 当前迭代收集到的光子能量 (Flux)
     
-    double n_accum;     // 累积收集的光子数量 (经过半径缩减修正)
+    Real n_accum;     // 累积收集的光子数量 (经过半径缩减修正)
     Color flux_accum;   // 累积收集的光子能量 (经过半径缩减修正)
     
-    HitPoint(Point3 p_, Vec3 n_, Color tr_, int idx_, double r2_)
+    HitPoint(Point3 p_, Vec3 n_, Color tr_, int idx_, Real r2_)
         : p(p_), normal(n_), throughput(tr_), pixel_index(idx_), r2(r2_),
           n_new(0), flux_new(0,0,0), n_accum(0), flux_accum(0,0,0) {}
 };
 
+// 一次迭代里光子落在漫反射面上的记录。光子先全部追踪完，排序后建 KD-Tree，
+// 再由每个 HitPoint 去收集自己半径内的光子：每个 HitPoint 只由一个线程累加，顺序固定，结果和线程数无关
+struct PhotonHit {
+    Point3 p;     // 位置
+    Vec3 dir;     // 入射方向
+    Color power;  // 通量
+};
+
 // 第一步：Eye Pass (视线追踪)
 // 从相机发射光线，记录与漫反射表面的交点 (HitPoint)
 // 改进：增加 max_depth 参数防止无限递归；对玻璃材质使用分支追踪而非俄罗斯轮盘赌
-inline void trace_eye_path(Ray ray, int dep, int max_depth, int pixel_index, const HittableObjList& world, Color throughput, std::vector<HitPoint>& hit_points, double initial_radius, std::vector<Color>& direct_buffer, int width) {
+// gbuffer 只在相机光线 (dep == 0) 那一层传进来，记录第一个交点
+inline void trace_eye_path(Ray ray, int dep, int max_depth, int pixel_index, const HittableObj& world, Color throughput, std::vector<HitPoint>& hit_points, Real initial_radius, std::vector<Color>& direct_buffer, int width, GBuffer* gbuffer = nullptr) {
     if (dep > max_depth) return;
     if (max_in_xyz(throughput) < 1e-4) return;
     
-    std::pair<int, double> intersect_result = nearest_hit(ray, world);
-    if (intersect_result.first == -1) return;
-    
-    HittableObj* obj = world.objects[intersect_result.first].get();
-    Point3 x = ray.at(intersect_result.second);
-    
     HitRecord rec;
-    obj->hit(ray, 0.001, infinity, rec);
+    count_rays();
+    if (nearest_hit(ray, world, rec) == -1) {
+        if (gbuffer) gbuffer->add(pixel_index, FirstHit());
+        return;
+    }
+    if (gbuffer) gbuffer->add(pixel_index, first_hit(ray, rec));
+    Point3 x = rec.p;
 
     Vec3 n = rec.normal;
     Vec3 nl = dot(n, ray.direction()) < 0 ? n : -n;
     
     // 检查是否击中光源 (直接光照)
-    if (auto light = std::dynamic_pointer_cast<DiffuseLight>(rec.mat_ptr)) {
-        Color emitted = light->emit->value(0,0,x);
+    if (auto light = material_as<DiffuseLight>(rec.mat_ptr)) {
+        Color emitted = eval_texture(light->emit.get(), rec.u, rec.v, x);
         // 直接将光源贡献写入 direct_buffer
         direct_buffer[pixel_index] += throughput * emitted;
         return; // 光源通常不进行漫反射散射
     }
 
-    std::pair<Refl_t, Color> feature = get_feature(rec.mat_ptr, x);
+    std::pair<Refl_t, Color> feature = get_feature(rec);
     Color f = feature.second;
     
     if (feature.first == DIFF) {
@@ -72,30 +87,30 @@ inline void trace_eye_path(Ray ray, int dep, int max_depth, int pixel_index, con
         return;
     } else if (feature.first == SPEC) {
         // 镜面反射：继续递归追踪
-        Ray reflray = Ray(x, reflect(ray.direction(), n));
+        Ray reflray = rec.spawn_ray(reflect(ray.direction(), n));
         trace_eye_path(reflray, dep + 1, max_depth, pixel_index, world, throughput * f, hit_points, initial_radius, direct_buffer, width);
     } else if (feature.first == REFR) {
         // 折射/介质：计算菲涅尔项
-        double ir ; // 折射率
+        Real ir ; // 折射率
         Color transmission = Color(1,1,1); // 默认透射颜色
         
         // 获取材质的具体参数
-        if (auto diel = std::dynamic_pointer_cast<Dielectric>(rec.mat_ptr)) {
+        if (auto diel = material_as<Dielectric>(rec.mat_ptr)) {
             ir = diel->ir;
             // Beer's Law: 计算介质内部吸收
             if (dot(n, ray.direction()) > 0) { // 如果是从内部射出 (dot > 0)
                  // rec.t 是光线在介质内部传播的距离
-                 double r = exp(-diel->absorbance.x() * rec.t);
-                 double g = exp(-diel->absorbance.y() * rec.t);
-                 double b = exp(-diel->absorbance.z() * rec.t);
+                 Real r = exp(-diel->absorbance.x() * rec.t);
+                 Real g = exp(-diel->absorbance.y() * rec.t);
+                 Real b = exp(-diel->absorbance.z() * rec.t);
                  transmission = Color(r, g, b);
             }
         }
 
-        double refraction_ratio = dot(n, ray.direction()) < 0 ? (1.0/ir) : ir;
+        Real refraction_ratio = dot(n, ray.direction()) < 0 ? (1.0/ir) : ir;
         Vec3 unit_dir = unit_vector(ray.direction());
-        double cos_theta = fmin(dot(-unit_dir, nl), 1.0);
-        double sin_theta = sqrt(1.0 - cos_theta*cos_theta);
+        Real cos_theta = fmin(dot(-unit_dir, nl), 1.0);
+        Real sin_theta = sqrt(1.0 - cos_theta*cos_theta);
         bool cannot_refract = refraction_ratio * sin_theta > 1.0;
         
         Vec3 d_refracted;
@@ -106,22 +121,22 @@ inline void trace_eye_path(Ray ray, int dep, int max_depth, int pixel_index, con
 
         if (cannot_refract) {
             // 全反射
-            trace_eye_path(Ray(x, reflect(unit_dir, nl)), dep + 1, max_depth, pixel_index, world, current_throughput, hit_points, initial_radius, direct_buffer, width);
+            trace_eye_path(rec.spawn_ray(reflect(unit_dir, nl)), dep + 1, max_depth, pixel_index, world, current_throughput, hit_points, initial_radius, direct_buffer, width);
         } else {
             auto r0 = (1-ir)/(1+ir); r0 = r0*r0;
-            double Re = r0 + (1-r0)*pow((1 - cos_theta), 5);
-            double Tr = 1 - Re;
+            Real Re = r0 + (1-r0)*pow((1 - cos_theta), 5);
+            Real Tr = 1 - Re;
             
             // 改进：分支追踪 (Branching)
             // 同时追踪反射和折射，按菲涅尔权重分配 throughput
             
             // 反射路径
             if (Re > 0.001) // 优化：权重太小就不追踪
-                trace_eye_path(Ray(x, reflect(unit_dir, nl)), dep + 1, max_depth, pixel_index, world, current_throughput * Re, hit_points, initial_radius, direct_buffer, width);
+                trace_eye_path(rec.spawn_ray(reflect(unit_dir, nl)), dep + 1, max_depth, pixel_index, world, current_throughput * Re, hit_points, initial_radius, direct_buffer, width);
             
             // 折射路径
             if (Tr > 0.001)
-                trace_eye_path(Ray(x, d_refracted), dep + 1, max_depth, pixel_index, world, current_throughput * Tr, hit_points, initial_radius, direct_buffer, width);
+                trace_eye_path(rec.spawn_ray(d_refracted), dep + 1, max_depth, pixel_index, world, current_throughput * Tr, hit_points, initial_radius, direct_buffer, width);
         }
     }
 }
@@ -129,37 +144,18 @@ inline void trace_eye_path(Ray ray, int dep, int max_depth, int pixel_index, con
 // 第二步：Photon Pass (光子追踪)
 // 从光源发射光子，当光子击中漫反射表面时，更新附近的 HitPoint
 // 使用 Material里的scatter 进行重要性采样，统一光照传输逻辑
-inline void trace_photon_ppm(Ray ray, int dep, Color power, KDTree<HitPoint>& tree, const HittableObjList& world, double max_dist_sq) {
+inline void trace_photon_ppm(Ray ray, int dep, Color power, std::vector<PhotonHit>& photon_hits, const HittableObj& world) {
     if (max_in_xyz(power) < 1e-8) return;
     
-    std::pair<int, double> intersect_result = nearest_hit(ray, world);
-    if (intersect_result.first == -1) return;
-    
-    HittableObj* obj = world.objects[intersect_result.first].get();
-    Point3 x = ray.at(intersect_result.second);
-    
     HitRecord rec;
-    obj->hit(ray, 0.001, infinity, rec);
+    count_rays();
+    if (nearest_hit(ray, world, rec) == -1) return;
+    Point3 x = rec.p;
     
     // 是漫反射表面，存储光子
-    if (std::dynamic_pointer_cast<DiffuseLight>(rec.mat_ptr) == nullptr) {
-        std::pair<Refl_t, Color> feature = get_feature(rec.mat_ptr, x);
-        if (feature.first == DIFF) {
-            tree.search(x, sqrt(max_dist_sq), [&](HitPoint* hp, double dist_sq) {
-                if (dist_sq <= hp->r2) {
-                    if (dot(hp->normal, ray.direction()) < 0) {
-                        #pragma omp atomic
-                        hp->n_new += 1;
-                        #pragma omp atomic
-                        hp->flux_new.e[0] += power.e[0];
-                        #pragma omp atomic
-                        hp->flux_new.e[1] += power.e[1];
-                        #pragma omp atomic
-                        hp->flux_new.e[2] += power.e[2];
-                    }
-                }
-            });
-        }
+    if (material_as<DiffuseLight>(rec.mat_ptr) == nullptr) {
+        std::pair<Refl_t, Color> feature = get_feature(rec);
+        if (feature.first == DIFF) photon_hits.push_back({x, ray.direction(), power});
     }
 
     // 使用材质的 scatter 函数决定光子的下一次反弹，材质里面按理说是不符合物理规律的，但如果严格按照物理规律来玻璃球的噪点非常多。
@@ -170,7 +166,7 @@ inline void trace_photon_ppm(Ray ray, int dep, Color power, KDTree<HitPoint>& tr
         // attenuation 包含了 BRDF * Cosine / PDF
         Color new_power = power * attenuation;
         // 俄罗斯轮盘赌 (Russian Roulette) 决定光子是否存活，使用衰减系数的最大分量作为存活概率
-        double p_survive = max_in_xyz(attenuation);
+        Real p_survive = max_in_xyz(attenuation);
         if (p_survive > 1.0) p_survive = 1.0; // 概率不能超过 1
         
         if (++dep > 5) {
@@ -181,87 +177,163 @@ inline void trace_photon_ppm(Ray ray, int dep, Color power, KDTree<HitPoint>& tr
             }
         }
         
-        trace_photon_ppm(scattered, dep, new_power, tree, world, max_dist_sq);
+        trace_photon_ppm(scattered, dep, new_power, photon_hits, world);
     }
 }
 
 // PPM 主渲染函数
+// time_budget > 0 时不固定迭代次数，一直迭代到时间预算用完：按上一次迭代的耗时估计下一次能不能在截止前做完，至少迭代一次
 inline void render_ppm(
-    const HittableObjList& world, 
-    const std::vector<shared_ptr<HittableObj>>& lights,
+    const Scene& scene, 
     const Camera& cam, 
     int image_width, 
     int image_height, 
     int total_photon_num, // 总光子数
     int max_depth,
-    double initial_radius,
-    std::vector<unsigned char>& buffer
+    Real initial_radius,
+    const Sampler& sampler_proto,
+    std::vector<unsigned char>& buffer,
+    double time_budget = 0, // 时间预算（秒）
+    const TileSettings& tiles = TileSettings(), // 视线阶段分块的大小和遍历顺序
+    const DenoiseSettings& denoise = DenoiseSettings(), // 降噪参数，打开时要传 gbuffer 作为引导
+    GBuffer* gbuffer = nullptr // 不为空时在视线阶段记录第一个交点（降噪引导、AOV 输出）
 ) {
+    typedef std::chrono::steady_clock Clock;
     std::cout << "开始渐进式光子映射 (PPM)" << std::endl;
     
     // PPM 参数
-    int iterations = 100; // 迭代次数
+    int iterations = 100; // 迭代次数，限时模式下只用来定每次迭代的光子数
     int photons_per_iter = total_photon_num / iterations; // 每次迭代发射的光子数
-    double alpha = 0.85; // 半径缩减参数
+    Real alpha = 0.85; // 半径缩减参数
+    const bool timed = time_budget > 0;
     
-    std::cout << "ppm迭代次数： " << iterations << ", 每次迭代光子数: " << photons_per_iter << std::endl;
+    if (timed) std::cout << "ppm时间预算： " << time_budget << " 秒, 每次迭代光子数: " << photons_per_iter << std::endl;
+    else std::cout << "ppm迭代次数： " << iterations << ", 每次迭代光子数: " << photons_per_iter << std::endl;
+    const Clock::time_point start = Clock::now();
+
+    // 视线和光子的每次弹射都在 commit 好的加速结构上求交一次
+    const HittableObj& world = scene.accel();
+    const std::vector<Emitter>& lights = scene.emitters;
 
     // 1. 视线追踪阶段
     std::cout << "视线追踪阶段" << std::endl;
     std::vector<HitPoint> hit_points;
     std::vector<Color> direct_buffer(image_width * image_height, Color(0,0,0)); // 暂未使用
+    if (gbuffer) gbuffer->resize(image_width * image_height);
     
-    #pragma omp parallel for schedule(dynamic, 1)
-    for (int j = image_height-1; j >= 0; --j) {
-        for (int i = 0; i < image_width; ++i) {
-            auto u = (i + random_double()) / (image_width-1);
-            auto v = (j + random_double()) / (image_height-1);
-            Ray r = cam.get_ray(u, v);
-            
-            int pixel_index = ((image_height - 1 - j) * image_width + i);
-            trace_eye_path(r, 0, max_depth, pixel_index, world, Color(1,1,1), hit_points, initial_radius, direct_buffer, image_width);
+    TileScheduler scheduler(make_tiles(image_width, image_height, tiles), omp_get_max_threads());
+    ProgressReporter eye_progress("视线", image_width * image_height);
+    #pragma omp parallel
+    {
+    std::unique_ptr<Sampler> sampler = sampler_proto.clone(1); // 每个像素一条视线，只用来做像素抖动
+    Tile tile;
+    while (scheduler.next(omp_get_thread_num(), tile)) {
+        for (int row = tile.y0; row < tile.y1; ++row) {
+            int j = image_height - 1 - row;
+            for (int i = tile.x0; i < tile.x1; ++i) {
+                int pixel_index = row * image_width + i;
+                sampler->start_pixel_sample(pixel_index, 0);
+                Real du, dv;
+                sampler->get_2d(du, dv);
+                auto u = (i + du) / (image_width-1);
+                auto v = (j + dv) / (image_height-1);
+                Ray r = cam.get_ray(u, v);
+
+                trace_eye_path(r, 0, max_depth, pixel_index, world, Color(1,1,1), hit_points, initial_radius, direct_buffer, image_width, gbuffer);
+            }
         }
+        eye_progress.add((tile.x1 - tile.x0) * (tile.y1 - tile.y0));
     }
+    }
+    eye_progress.finish();
+    // 可见点插入的顺序取决于线程调度，按像素和位置排序后就和线程数无关了
+    // （不用 stable_sort：它的临时缓冲区不保证 Vec3 需要的对齐）
+    std::sort(hit_points.begin(), hit_points.end(), [](const HitPoint& a, const HitPoint& b) {
+        if (a.pixel_index != b.pixel_index) return a.pixel_index < b.pixel_index;
+        if (vec_less(a.p, b.p)) return true;
+        if (vec_less(b.p, a.p)) return false;
+        return vec_less(a.throughput, b.throughput);
+    });
     std::cout << "得到的可见点数： " << hit_points.size() << std::endl;
-    
-    // 构建 KD-Tree (只需构建一次)
-    KDTree<HitPoint> tree(hit_points);
 
     // 2. 迭代阶段
-    for (int iter = 0; iter < iterations; ++iter) {
-        std::cout << "\r迭代第" << iter + 1 << "次 " << iter + 1 << "/" << iterations << std::flush;
+    double last_iter_seconds = 0;
+    int completed = 0;
+    // 进度按迭代次数算，限时模式按时间算；光子数由各线程每次迭代结束时上交
+    ProgressReporter progress("PPM 迭代", timed ? 0 : iterations, time_budget);
+    // 光子追踪时每个线程写自己的数组，记下每个光子的沉积在哪个线程的哪一段，
+    // 追踪完按光子编号拼起来：不用加锁，顺序只取决于光子编号，和线程数无关
+    const int threads = omp_get_max_threads();
+    std::vector<std::vector<PhotonHit>> thread_hits(threads);
+    std::vector<int> photon_thread(photons_per_iter);
+    std::vector<size_t> photon_begin(photons_per_iter), photon_count(photons_per_iter);
+    for (int iter = 0; timed || iter < iterations; ++iter) {
+        const Clock::time_point iter_start = Clock::now();
+        if (timed && iter > 0 && std::chrono::duration<double>(iter_start - start).count() + last_iter_seconds > time_budget) break;
         
-        // 计算当前最大的搜索半径平方，用于 KD-Tree 剪枝
-        double max_r2 = 0;
-        for (const auto& hp : hit_points) {
-            if (hp.r2 > max_r2) max_r2 = hp.r2;
-        }
-
         // 光子追踪阶段
-        #pragma omp parallel for schedule(dynamic, 1)
+        std::fill(photon_count.begin(), photon_count.end(), 0);
+        #pragma omp parallel num_threads(threads)
+        {
+        const int t = omp_get_thread_num();
+        std::vector<PhotonHit>& local_hits = thread_hits[t];
+        local_hits.clear();
+        #pragma omp for schedule(dynamic, 1) nowait
         for (int i = 0; i < photons_per_iter; ++i) {
-            if (lights.empty()) continue;//可以试试多个光源，目前场景里面就一个。
-            int light_idx = static_cast<int>(random_double(0, lights.size()-0.01));
-            auto light = lights[light_idx];
-            if (auto sphere = std::dynamic_pointer_cast<Sphere>(light)) {
-                // 从光源表面随机发射光子
-                Point3 origin = sphere->center + random_unit_vector() * sphere->radius;
-                Vec3 dir = random_unit_vector();
-                if (dot(dir, origin - sphere->center) < 0) dir = -dir;
-                Color L = std::dynamic_pointer_cast<DiffuseLight>(sphere->mat_ptr)->emit->value(0,0,origin);
-                double area = 4 * pi * sphere->radius * sphere->radius;
-                Color photon_power = L * area * pi / photons_per_iter; // 单个光子的能量，需要除以每次迭代的光子数    
-                trace_photon_ppm(Ray(origin, dir), 0, photon_power, tree, world, max_r2);
+            if (lights.empty()) continue;
+            rng_begin_sample(kRngPhotonStream + i, iter); // 每次迭代的每个光子一条随机数流
+            // 按功率选光源，光子能量要除以选中它的概率
+            Real light_pdf;
+            const Emitter& light = lights[scene.sample_emitter(random_double(), light_pdf)];
+            if (const Sphere* sphere = light.sphere) {
+                // 从光源表面随机发射光子，方向按漫射光源的余弦分布
+                Real u1 = random_double(), u2 = random_double();
+                Vec3 light_normal = sample_uniform_sphere(u1, u2);
+                Point3 origin = sphere->center + light_normal * sphere->radius;
+                Real u3 = random_double(), u4 = random_double();
+                Vec3 dir = Onb(light_normal).to_world(sample_cosine_hemisphere(u3, u4));
+                Color photon_power = light.power / (light_pdf * photons_per_iter); // 单个光子的能量，需要除以每次迭代的光子数
+                count_photons();
+                photon_thread[i] = t;
+                photon_begin[i] = local_hits.size();
+                trace_photon_ppm(Ray(origin, dir), 0, photon_power, local_hits, world);
+                photon_count[i] = local_hits.size() - photon_begin[i];
             }
         }
+        progress.add(0);
+        }
+
+        // 按光子编号拼接各线程的沉积
+        std::vector<size_t> photon_offset(photons_per_iter + 1, 0);
+        for (int i = 0; i < photons_per_iter; ++i) photon_offset[i + 1] = photon_offset[i] + photon_count[i];
+        std::vector<PhotonHit> photon_hits(photon_offset[photons_per_iter]);
+        #pragma omp parallel for schedule(static)
+        for (int i = 0; i < photons_per_iter; ++i) {
+            if (photon_count[i] == 0) continue;
+            const std::vector<PhotonHit>& src = thread_hits[photon_thread[i]];
+            std::copy(src.begin() + photon_begin[i], src.begin() + photon_begin[i] + photon_count[i], photon_hits.begin() + photon_offset[i]);
+        }
+
+        // 光子收集：每个 HitPoint 在自己的半径内找光子
+        KDTree<PhotonHit> photon_tree(photon_hits);
+        #pragma omp parallel for schedule(dynamic, 64)
+        for (int h = 0; h < static_cast<int>(hit_points.size()); ++h) {
+            HitPoint& hp = hit_points[h];
+            photon_tree.search(hp.p, sqrt(hp.r2), [&](PhotonHit* ph, Real dist_sq) {
+                if (dist_sq <= hp.r2 && dot(hp.normal, ph->dir) < 0) {
+                    hp.n_new += 1;
+                    hp.flux_new += ph->power;
+                }
+            });
+        }
         // 更新 HitPoint 统计数据并缩减半径
         for (auto& hp : hit_points) {
             if (hp.n_new > 0) {
-                double N = hp.n_accum;
-                double M = hp.n_new;
+                Real N = hp.n_accum;
+                Real M = hp.n_new;
                 // 半径缩减公式
                 // R_{i+1}^2 = R_i^2 * (N + alpha * M) / (N + M)
-                double ratio = (N + alpha * M) / (N + M);
+                Real ratio = (N + alpha * M) / (N + M);
                 
                 hp.r2 *= ratio;
                 // 累积能量也需要按比例缩放，以保持密度估计的一致性
@@ -274,7 +346,12 @@ inline void render_ppm(
                 hp.flux_new = Color(0,0,0);
             }
         }
+        ++completed;
+        progress.add(1);
+        last_iter_seconds = std::chrono::duration<double>(Clock::now() - iter_start).count();
     }
+    iterations = completed;
+    progress.finish();
     
     // 3.重建最终图像
     std::vector<Color> final_image(image_width * image_height, Color(0,0,0));
@@ -298,19 +375,12 @@ inline void render_ppm(
         }
     }
     
-    // 写入缓冲区 
-    buffer.assign(image_width * image_height * 3, 0);
-    for (int i = 0; i < image_width * image_height; ++i) {
-        Color c = final_image[i];
-        c = aces_approx(c);
-        auto r = sqrt(c.x());
-        auto g = sqrt(c.y());
-        auto b = sqrt(c.z());
-        buffer[i*3] = static_cast<unsigned char>(256 * clamp(r, 0.0, 0.999));
-        buffer[i*3+1] = static_cast<unsigned char>(256 * clamp(g, 0.0, 0.999));
-        buffer[i*3+2] = static_cast<unsigned char>(256 * clamp(b, 0.0, 0.999));
-    }
-    std::cout << "渲染完成" << std::endl;
+    // (降噪 +) 写入缓冲区 
+    resolve_hdr(image_width, image_height, final_image, gbuffer ? *gbuffer : GBuffer(), denoise, buffer);
+    const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    const long long photons = 1LL * photons_per_iter * iterations;
+    std::cout << "渲染完成, 迭代 " << iterations << " 次, 共 " << photons << " 个光子, 用时 " << seconds << " 秒, "
+              << photons / std::max(seconds, 1e-9) / 1e6 << " M光子/秒" << std::endl;
 }
 
 #endif
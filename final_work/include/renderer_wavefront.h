@@ -0,0 +1,344 @@
+#ifndef RENDERER_WAVEFRONT_H
+#define RENDERER_WAVEFRONT_H
+
+#include "utils.h"
+#include "renderer_common.h"
+#include "renderer_path.h"
+#include "camera.h"
+#include "material.hpp"
+#include "progress.h"
+#include "ray_stream.h"
+#include "sampler.h"
+#include "scene.h"
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <omp.h>
+
+// 一批同时推进的路径数
+const int kWavefrontBatch = 1 << 20;
+// 着色前批量求纹理时每次处理的路径数，u/v/p 先收集到这么大的栈数组里
+const int kWavefrontTextureChunk = 256;
+
+/**
+* 并行的稳定计数排序：把 items 按 bucket_of(item) 分进 bucket_count 个桶，桶内保持原来的先后，bucket_of 返回 -1 的丢掉
+* 每个线程对自己那一段连续的输入建直方图，按 (桶, 线程) 的顺序做前缀和得到每个线程在每个桶里的写入起点，再各自写出，
+* 结果和串行的计数排序相同，和线程数无关。只有一个桶时就是并行的流压缩 (stream compaction)
+*@param & items      输入的路径编号
+*@param bucket_count 桶数
+*@param bucket_of    路径编号 -> 桶号
+*@param & out        输出，大小调整成留下的元素个数
+*@param & histogram  临时空间，(桶, 线程) 的计数，跨调用复用
+*@param bucket_start 不为空时输出每个桶在 out 里的起点，长度 bucket_count + 1
+*/
+template <typename BucketOf>
+inline void parallel_bucket_sort(const std::vector<int>& items, int bucket_count, BucketOf bucket_of,
+    std::vector<int>& out, std::vector<int>& histogram, std::vector<int>* bucket_start = nullptr) {
+    const int m = static_cast<int>(items.size());
+    const int threads = omp_get_max_threads();
+    histogram.assign(size_t(bucket_count) * threads, 0);
+    #pragma omp parallel num_threads(threads)
+    {
+        const int t = omp_get_thread_num(), nt = omp_get_num_threads();
+        const int begin = static_cast<int>(1LL * m * t / nt), end = static_cast<int>(1LL * m * (t + 1) / nt);
+        for (int k = begin; k < end; ++k) {
+            int b = bucket_of(items[k]);
+            if (b >= 0) ++histogram[size_t(b) * threads + t];
+        }
+        #pragma omp barrier
+        #pragma omp single
+        {
+            int sum = 0;
+            for (size_t c = 0; c < histogram.size(); ++c) {
+                int count = histogram[c];
+                histogram[c] = sum;
+                sum += count;
+            }
+            out.resize(sum);
+            if (bucket_start) {
+                bucket_start->resize(bucket_count + 1);
+                for (int b = 0; b < bucket_count; ++b) (*bucket_start)[b] = histogram[size_t(b) * threads];
+                (*bucket_start)[bucket_count] = sum;
+            }
+        }
+        for (int k = begin; k < end; ++k) {
+            int b = bucket_of(items[k]);
+            if (b >= 0) out[histogram[size_t(b) * threads + t]++] = items[k];
+        }
+    }
+}
+
+/**
+* 一批路径的状态，按 SoA 存放，每个阶段只碰自己用到的那几个数组
+*@param origin, direction 当前光线
+*@param beta              路径权重 (throughput)
+*@param L                 这条路径目前累计的辐射度
+*@param prev              上一个顶点，MIS 用
+*@param pixel, sample     路径属于哪个像素的第几个样本
+*@param rec, hit          求交阶段的结果
+*@param alive             着色之后路径是否还继续
+*@param shadow_*          着色阶段生成的阴影光线，贡献已经乘上了当时的 beta
+*/
+struct PathQueue {
+    std::vector<Point3> origin;
+    std::vector<Vec3> direction;
+    std::vector<Color> beta;
+    std::vector<Color> L;
+    std::vector<PathVertex> prev;
+    std::vector<int> pixel;
+    std::vector<int> sample;
+    std::vector<HitRecord> rec;
+    std::vector<char> hit;
+    std::vector<char> alive;
+    std::vector<char> has_shadow;
+    std::vector<Point3> shadow_origin;
+    std::vector<Vec3> shadow_dir;
+    std::vector<Real> shadow_t_max;
+    std::vector<Color> shadow_contribution;
+
+    void resize(size_t n) {
+        origin.resize(n);
+        direction.resize(n);
+        beta.resize(n);
+        L.resize(n);
+        prev.resize(n);
+        pixel.resize(n);
+        sample.resize(n);
+        rec.resize(n);
+        hit.resize(n);
+        alive.resize(n);
+        has_shadow.resize(n);
+        shadow_origin.resize(n);
+        shadow_dir.resize(n);
+        shadow_t_max.resize(n);
+        shadow_contribution.resize(n);
+    }
+
+    Ray ray(int i) const { return Ray(origin[i], direction[i]); }
+};
+
+/**
+* Wavefront 路径追踪：和 render_path_tracing 算的是同一个估计量（NEE + MIS + 轮盘赌），
+* 但不是一条路径一条路径地走到底，而是一大批路径按阶段一起推进：
+*    1. generate  生成相机光线
+*    2. intersect 所有活跃路径作为一个光线流求交 (intersect_stream)
+*    3. sort      没击中的路径加上背景后退出，剩下的按材质编号计数排序（每个线程一份直方图 + 前缀和），同一种材质的着色放在一起做
+*    4. shade     Lambertian 的反照率按材质分段用 eval_texture_batch 批量求好，再做发光 (MIS)、生成阴影光线、采样下一条光线、轮盘赌
+*    5. shadow    所有阴影光线作为一个光线流测遮挡 (occluded_stream)，没被挡住的贡献加到路径上
+*    6. accumulate 一批路径全部结束后加到像素上，按像素并行，同一个像素的样本按序号相加
+* 每个阶段都是对一段连续数组的并行循环，压缩和排序也是并行的稳定计数排序，没有递归；
+* 采样器按 (像素, 样本, 反弹) 定位，每个线程一个、整个渲染只分配一次，结果和线程数无关
+*@param & denoise 降噪参数，打开时要传 gbuffer 作为引导
+*@param gbuffer 不为空时在第一次 sort 里按像素并行记录第一个交点（AOV 输出），同一个像素的样本按序号进入，按像素数重新分配
+*/
+inline void render_wavefront(
+    const Scene& scene,
+    const Camera& cam,
+    int image_width,
+    int image_height,
+    int samples_per_pixel,
+    int max_depth,
+    int rr_min_bounce,
+    const Sampler& sampler_proto,
+    std::vector<unsigned char>& buffer,
+    const DenoiseSettings& denoise = DenoiseSettings(),
+    GBuffer* gbuffer = nullptr
+) {
+    const HittableObj& world = scene.accel();
+    const long long total_paths = 1LL * image_width * image_height * samples_per_pixel;
+    const int batch = static_cast<int>(std::min<long long>(kWavefrontBatch, total_paths));
+    std::cout << "开始 wavefront 路径追踪, 采样器: " << sampler_proto.name()
+              << ", 路径总数: " << total_paths << ", 每批: " << batch << std::endl;
+
+    const int material_count = static_cast<int>(scene.materials.size());
+    std::vector<Color> film(image_width * image_height, Color(0, 0, 0));
+    PathQueue q;
+    q.resize(batch);
+    std::vector<int> active, sorted, shadows, histogram;
+    RayStream stream;
+    HitStream stream_hits;
+    std::vector<int> material_of(batch);
+    std::vector<int> bucket_start;
+    std::vector<Color> albedo(batch); // 按 sorted 里的位置存，只有 Lambertian 的段有意义
+    std::vector<const Lambertian*> lambertian(material_count, nullptr);
+    for (int b = 0; b < material_count; ++b) lambertian[b] = material_as<Lambertian>(scene.materials[b]);
+    ProgressReporter progress("wavefront", total_paths);
+    if (gbuffer) gbuffer->resize(image_width * image_height);
+    // 每个线程一个采样器，所有批次、所有反弹共用
+    std::vector<std::unique_ptr<Sampler>> samplers(omp_get_max_threads());
+    for (auto& s : samplers) s = sampler_proto.clone(samples_per_pixel);
+
+    for (long long first = 0; first < total_paths; first += batch) {
+        const int n = static_cast<int>(std::min<long long>(batch, total_paths - first));
+        // 这一批覆盖的像素区间，按像素并行的阶段用：第 p 个像素的路径是 [p*spp - first, (p+1)*spp - first) 和 [0, n) 的交集
+        const int first_pixel = static_cast<int>(first / samples_per_pixel);
+        const int last_pixel = static_cast<int>((first + n - 1) / samples_per_pixel);
+
+        // 1. generate：路径编号按像素连续排，同一个像素的样本挨在一起
+        #pragma omp parallel
+        {
+        Sampler* sampler = samplers[omp_get_thread_num()].get();
+        #pragma omp for schedule(static)
+        for (int i = 0; i < n; ++i) {
+            long long path = first + i;
+            int pixel = static_cast<int>(path / samples_per_pixel);
+            int s = static_cast<int>(path % samples_per_pixel);
+            int row = pixel / image_width;
+            int col = pixel % image_width;
+            int j = image_height - 1 - row;
+            sampler->start_pixel_sample(pixel, s);
+            Real du, dv;
+            sampler->get_2d(du, dv);
+            Ray r = cam.get_ray((col + du) / (image_width-1), (j + dv) / (image_height-1));
+            q.origin[i] = r.origin();
+            q.direction[i] = r.direction();
+            q.beta[i] = Color(1, 1, 1);
+            q.L[i] = Color(0, 0, 0);
+            q.prev[i] = PathVertex();
+            q.pixel[i] = pixel;
+            q.sample[i] = s;
+        }
+        }
+        active.resize(n);
+        for (int i = 0; i < n; ++i) active[i] = i;
+
+        for (int bounce = 0; !active.empty(); ++bounce) {
+            const int m = static_cast<int>(active.size());
+
+            // 2. intersect：活跃路径的光线作为一个光线流提交，内部按方向和起点重排后整包遍历
+            stream.resize(m);
+            #pragma omp parallel for schedule(static)
+            for (int k = 0; k < m; ++k) {
+                int i = active[k];
+                stream.origin[k] = q.origin[i];
+                stream.direction[k] = q.direction[i];
+                stream.t_max[k] = infinity;
+            }
+            intersect_stream(world, stream, stream_hits);
+            count_rays(m);
+            #pragma omp parallel for schedule(static)
+            for (int k = 0; k < m; ++k) {
+                int i = active[k];
+                q.hit[i] = stream_hits.hit[k];
+                if (q.hit[i]) q.rec[i] = stream_hits.rec[k];
+            }
+
+            // 3. sort：没击中的加背景后退出；击中的按材质编号做稳定的计数排序
+            #pragma omp parallel for schedule(static)
+            for (int k = 0; k < m; ++k) {
+                int i = active[k];
+                if (!q.hit[i]) {
+                    q.L[i] += q.beta[i] * background_color(q.ray(i));
+                    material_of[i] = -1;
+                    continue;
+                }
+                int id = scene.material_id(q.rec[i].mat_ptr);
+                material_of[i] = (id < 0) ? material_count : id; // 不在材质表里的放最后
+            }
+            // 第一次反弹时 active 就是路径顺序，按像素并行记录第一个交点，同一个像素的样本按序号进 G-buffer
+            if (gbuffer && bounce == 0) {
+                #pragma omp parallel for schedule(static)
+                for (int p = first_pixel; p <= last_pixel; ++p) {
+                    int begin = static_cast<int>(std::max<long long>(0, 1LL * p * samples_per_pixel - first));
+                    int end = static_cast<int>(std::min<long long>(n, 1LL * (p + 1) * samples_per_pixel - first));
+                    for (int i = begin; i < end; ++i)
+                        gbuffer->add(p, q.hit[i] ? first_hit(q.ray(i), q.rec[i]) : FirstHit());
+                }
+            }
+            parallel_bucket_sort(active, material_count + 1, [&](int i) { return material_of[i]; }, sorted, histogram, &bucket_start);
+            const int hits = static_cast<int>(sorted.size());
+
+            // 4. shade：同一种材质的路径连续着色
+            #pragma omp parallel
+            {
+            // 同一种材质的路径在 sorted 里是连续的一段，Lambertian 的纹理对整段只分支一次
+            for (int b = 0; b < material_count; ++b) {
+                if (!lambertian[b]) continue;
+                const Texture* texture = lambertian[b]->albedo.get();
+                #pragma omp for schedule(static)
+                for (int c = bucket_start[b]; c < bucket_start[b + 1]; c += kWavefrontTextureChunk) {
+                    const int len = std::min(kWavefrontTextureChunk, bucket_start[b + 1] - c);
+                    Real u[kWavefrontTextureChunk], v[kWavefrontTextureChunk];
+                    Point3 p[kWavefrontTextureChunk];
+                    for (int k = 0; k < len; ++k) {
+                        const HitRecord& rec = q.rec[sorted[c + k]];
+                        u[k] = rec.u;
+                        v[k] = rec.v;
+                        p[k] = rec.p;
+                    }
+                    eval_texture_batch(texture, len, u, v, p, &albedo[c]);
+                }
+            }
+            Sampler* sampler = samplers[omp_get_thread_num()].get();
+            #pragma omp for schedule(static)
+            for (int k = 0; k < hits; ++k) {
+                int i = sorted[k];
+                const Color* a = (material_of[i] < material_count && lambertian[material_of[i]]) ? &albedo[k] : nullptr;
+                const HitRecord& rec = q.rec[i];
+                Ray r = q.ray(i);
+                sampler->resume_bounce(q.pixel[i], q.sample[i], bounce);
+                q.L[i] += q.beta[i] * emitted_with_mis(rec, scene, q.prev[i]);
+                q.has_shadow[i] = 0;
+                q.alive[i] = 0;
+                if (bounce >= max_depth) continue;
+
+                // 非镜面的表面生成一条阴影光线，留到阴影阶段一起测
+                Ray shadow_ray;
+                Real t_max;
+                Color contribution;
+                if (!rec.mat_ptr->is_specular() && sample_light_ray(r, rec, scene, *sampler, shadow_ray, t_max, contribution, a)) {
+                    q.has_shadow[i] = 1;
+                    q.shadow_origin[i] = shadow_ray.origin();
+                    q.shadow_dir[i] = shadow_ray.direction();
+                    q.shadow_t_max[i] = t_max;
+                    q.shadow_contribution[i] = q.beta[i] * contribution;
+                }
+
+                if (sample_next_ray(r, rec, bounce, rr_min_bounce, *sampler, q.beta[i], q.prev[i], q.L[i], a)) {
+                    q.alive[i] = 1;
+                    q.origin[i] = r.origin();
+                    q.direction[i] = r.direction();
+                }
+            }
+            }
+
+            // 5. shadow：把阴影光线压紧成一个光线流，一起测遮挡
+            parallel_bucket_sort(sorted, 1, [&](int i) { return q.has_shadow[i] ? 0 : -1; }, shadows, histogram);
+            const int shadow_count = static_cast<int>(shadows.size());
+            stream.resize(shadow_count);
+            #pragma omp parallel for schedule(static)
+            for (int k = 0; k < shadow_count; ++k) {
+                int i = shadows[k];
+                stream.origin[k] = q.shadow_origin[i];
+                stream.direction[k] = q.shadow_dir[i];
+                stream.t_max[k] = q.shadow_t_max[i];
+            }
+            std::vector<uint64_t> blocked = occluded_stream(world, stream);
+            count_rays(shadow_count);
+            #pragma omp parallel for schedule(static)
+            for (int k = 0; k < shadow_count; ++k)
+                if (!stream_bit(blocked, k)) q.L[shadows[k]] += q.shadow_contribution[shadows[k]];
+
+            // 还活着的路径按材质顺序进入下一轮
+            parallel_bucket_sort(sorted, 1, [&](int i) { return q.alive[i] ? 0 : -1; }, active, histogram);
+        }
+
+        // 6. accumulate：按像素并行，同一个像素的样本按序号相加，和线程调度无关
+        #pragma omp parallel for schedule(static)
+        for (int p = first_pixel; p <= last_pixel; ++p) {
+            int begin = static_cast<int>(std::max<long long>(0, 1LL * p * samples_per_pixel - first));
+            int end = static_cast<int>(std::min<long long>(n, 1LL * (p + 1) * samples_per_pixel - first));
+            for (int i = begin; i < end; ++i) film[p] += q.L[i];
+        }
+        progress.add(n);
+    }
+    progress.finish();
+
+    auto scale = 1.0 / samples_per_pixel;
+    for (int i = 0; i < image_width * image_height; ++i) film[i] *= scale;
+    resolve_hdr(image_width, image_height, film, gbuffer ? *gbuffer : GBuffer(), denoise, buffer);
+    std::cout << "wavefront 路径追踪完成。\n";
+}
+
+#endif
@@ -0,0 +1,495 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include "utils.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// 比 1 小的最大浮点数，采样值统一截到 [0,1)
+const Real kOneMinusEpsilon = Real(1) - std::numeric_limits<Real>::epsilon() / 2;
+
+// 32 位整数映射到 [0,1)
+inline Real u32_to_unit(uint32_t x) {
+    Real r = static_cast<Real>(x * 0x1p-32);
+    return r < kOneMinusEpsilon ? r : kOneMinusEpsilon;
+}
+
+// 两个 64 位值混合成一个哈希，给每个 (像素, 维度) 派生独立的种子
+inline uint64_t hash_combine(uint64_t a, uint64_t b) {
+    return mix_bits(a ^ mix_bits(b));
+}
+
+/**
+* Sampler 类：采样器接口，渲染器里所有按像素采样的随机决策（像素抖动、散射方向、光源上的点、
+* final gather 方向、分支选择）都从这里取 [0,1) 的样本，而不是各自调 random_double()。
+* 维度按用途分块：每个像素样本开头 kCameraDims 维给相机（像素抖动 + 镜头），
+* 之后每次反弹 kBounceDims 维（光源采样 3 维 + 散射方向 2 维 + 分支/轮盘赌），一块用完之后退回到独立随机数。
+* 成对的两维总是从块内的偶数位置开始，Sobol 的 4 维一组不会被拆开。
+* 这样同一次反弹的同一个决策在所有样本里用的是同一维，分层/低差异序列才能起作用。
+* 每个线程各 clone 一份，采样器有状态，不能在线程之间共享
+*@param spp 每个像素的样本数，分层和低差异序列按它来分配
+*@brief start_pixel_sample(key, index) 开始像素 key 的第 index 个样本，回到相机那一块维度
+*@brief start_bounce(b) / next_bounce() 切到第 b 次（下一次）反弹的那一块维度
+*@brief resume_bounce(key, index, b) 直接从某个样本的第 b 次反弹开始
+*@brief get_1d() / get_2d(u, v) 取下一维 / 下两维样本
+*@brief clone(spp) 同类型、新样本数的采样器，给每个线程和 final gather 用
+*/
+class Sampler {
+public:
+    static constexpr int kCameraDims = 4;
+    static constexpr int kBounceDims = 8;
+
+    explicit Sampler(int spp) : spp(spp > 0 ? spp : 1) {}
+    virtual ~Sampler() {}
+
+    virtual std::unique_ptr<Sampler> clone(int spp) const = 0;
+    virtual const char* name() const = 0;
+
+    int samples_per_pixel() const { return spp; }
+    uint64_t pixel_key() const { return pixel; }
+    int sample_index() const { return index; }
+
+    void start_pixel_sample(uint64_t key, int sample) {
+        pixel = key;
+        index = sample;
+        bounce = -1;
+        base = 0;
+        slot = 0;
+        limit = kCameraDims;
+        // 超出维度块的请求退回到独立随机数，这条流也按 (像素, 样本) 定下来，结果和线程数无关
+        rng_begin_sample(key, sample);
+    }
+
+    void start_bounce(int b) {
+        bounce = b;
+        base = kCameraDims + b * kBounceDims;
+        slot = 0;
+        limit = kBounceDims;
+    }
+
+    void next_bounce() { start_bounce(bounce + 1); }
+
+    // 在另一个时刻（另一个线程）接着做像素 key 第 sample 个样本的第 b 次反弹，wavefront 模式按阶段推进路径时用；
+    // 退回用的随机数流按反弹号错开，各次反弹不会拿到同样的独立随机数
+    void resume_bounce(uint64_t key, int sample, int b) {
+        pixel = key;
+        index = sample;
+        rng_begin_sample(key, sample, static_cast<uint64_t>(b + 1) << 16);
+        start_bounce(b);
+    }
+
+    Real get_1d() {
+        if (slot < limit) return sample_1d(base + slot++);
+        return random_double();
+    }
+
+    void get_2d(Real& u, Real& v) {
+        slot += slot & 1;
+        if (slot + 1 < limit) {
+            sample_2d(base + slot, u, v);
+            slot += 2;
+        } else {
+            u = random_double();
+            v = random_double();
+        }
+    }
+
+protected:
+    // 当前样本第 dim 维的值，dim 是全局维度编号
+    virtual Real sample_1d(int dim) = 0;
+    // 成对使用的两维 (dim, dim+1)，分层采样按二维网格分层
+    virtual void sample_2d(int dim, Real& u, Real& v) {
+        u = sample_1d(dim);
+        v = sample_1d(dim + 1);
+    }
+
+    int spp;
+    uint64_t pixel = 0;
+    int index = 0;
+
+private:
+    int bounce = -1;
+    int base = 0;
+    int slot = 0;
+    int limit = 0; // 没有 start_pixel_sample 过的采样器所有维度都是独立随机数
+};
+
+// 独立随机采样：每一维都是独立的均匀随机数，和原来直接调 random_double() 一样
+class IndependentSampler : public Sampler {
+public:
+    explicit IndependentSampler(int spp) : Sampler(spp) {}
+
+    virtual std::unique_ptr<Sampler> clone(int n) const override {
+        return std::unique_ptr<Sampler>(new IndependentSampler(n));
+    }
+    virtual const char* name() const override { return "independent"; }
+
+protected:
+    virtual Real sample_1d(int dim) override { return random_double(); }
+};
+
+// 每个线程一个没有开始过像素样本的独立采样器，光子路径这类不按像素采样的地方用
+inline Sampler& fallback_sampler() {
+    static thread_local IndependentSampler sampler(1);
+    return sampler;
+}
+
+/**
+* Kensler 的哈希置换 (Correlated Multi-Jittered Sampling, 2013)：把 i 在 [0, l) 里按种子 p 打乱，不用存置换表
+*/
+inline uint32_t permute(uint32_t i, uint32_t l, uint32_t p) {
+    uint32_t w = l - 1;
+    w |= w >> 1;
+    w |= w >> 2;
+    w |= w >> 4;
+    w |= w >> 8;
+    w |= w >> 16;
+    do {
+        i ^= p;             i *= 0xe170893d;
+        i ^= p >> 16;
+        i ^= (i & w) >> 4;
+        i ^= p >> 8;        i *= 0x0929eb3f;
+        i ^= p >> 23;
+        i ^= (i & w) >> 1;  i *= 1 | p >> 27;
+                            i *= 0x6935fa69;
+        i ^= (i & w) >> 11; i *= 0x74dcb303;
+        i ^= (i & w) >> 2;  i *= 0x9e501cc3;
+        i ^= (i & w) >> 2;  i *= 0xc860a3df;
+        i &= w;
+        i ^= i >> 5;
+    } while (i >= l);
+    return (i + p) % l;
+}
+
+/**
+* 分层采样：每一维把 [0,1) 分成 spp 层，第 index 个样本落在按 (像素, 维度) 打乱后的那一层里再抖动；
+* 成对的两维按 nx*ny 的二维网格分层。不同维度的层各自打乱，维度之间不相关
+*/
+class StratifiedSampler : public Sampler {
+public:
+    explicit StratifiedSampler(int spp) : Sampler(spp) {
+        nx = static_cast<int>(std::sqrt(static_cast<double>(this->spp)));
+        ny = (this->spp + nx - 1) / nx;
+    }
+
+    virtual std::unique_ptr<Sampler> clone(int n) const override {
+        return std::unique_ptr<Sampler>(new StratifiedSampler(n));
+    }
+    virtual const char* name() const override { return "stratified"; }
+
+protected:
+    virtual Real sample_1d(int dim) override {
+        uint64_t h = hash_combine(pixel, static_cast<uint64_t>(dim));
+        uint32_t stratum = permute(static_cast<uint32_t>(index % spp), spp, static_cast<uint32_t>(h));
+        Real jitter = u32_to_unit(static_cast<uint32_t>(hash_combine(h, index) >> 32));
+        Real x = (stratum + jitter) / spp;
+        return x < kOneMinusEpsilon ? x : kOneMinusEpsilon;
+    }
+
+    virtual void sample_2d(int dim, Real& u, Real& v) override {
+        uint64_t h = hash_combine(pixel, static_cast<uint64_t>(dim));
+        uint32_t cell = permute(static_cast<uint32_t>(index % spp), nx * ny, static_cast<uint32_t>(h));
+        uint64_t j = hash_combine(h, index);
+        u = (cell % nx + u32_to_unit(static_cast<uint32_t>(j))) / nx;
+        v = (cell / nx + u32_to_unit(static_cast<uint32_t>(j >> 32))) / ny;
+        if (u > kOneMinusEpsilon) u = kOneMinusEpsilon;
+        if (v > kOneMinusEpsilon) v = kOneMinusEpsilon;
+    }
+
+private:
+    int nx, ny; // 二维分层的网格，nx*ny >= spp
+};
+
+// 前 n 个素数，Halton 序列每一维一个底数
+inline const std::vector<int>& halton_primes() {
+    static const std::vector<int> primes = [] {
+        std::vector<int> p;
+        for (int n = 2; p.size() < 256; ++n) {
+            bool is_prime = true;
+            for (int q : p) {
+                if (q * q > n) break;
+                if (n % q == 0) { is_prime = false; break; }
+            }
+            if (is_prime) p.push_back(n);
+        }
+        return p;
+    }();
+    return primes;
+}
+
+// 以 base 为底的根式反演 (radical inverse)
+inline Real radical_inverse(int base, uint64_t a) {
+    const double inv_base = 1.0 / base;
+    double inv_base_n = 1;
+    uint64_t reversed = 0;
+    while (a) {
+        uint64_t next = a / base;
+        reversed = reversed * base + (a - next * base);
+        inv_base_n *= inv_base;
+        a = next;
+    }
+    Real x = static_cast<Real>(reversed * inv_base_n);
+    return x < kOneMinusEpsilon ? x : kOneMinusEpsilon;
+}
+
+/**
+* Halton 序列：第 dim 维用第 dim 个素数作底的根式反演，所有像素共用同一个序列，
+* 每个像素每一维加一个哈希出来的 Cranley-Patterson 平移，去掉像素之间的相关。
+* 素数表之外的维度退回到独立随机数
+*/
+class HaltonSampler : public Sampler {
+public:
+    explicit HaltonSampler(int spp) : Sampler(spp) {}
+
+    virtual std::unique_ptr<Sampler> clone(int n) const override {
+        return std::unique_ptr<Sampler>(new HaltonSampler(n));
+    }
+    virtual const char* name() const override { return "halton"; }
+
+protected:
+    virtual Real sample_1d(int dim) override {
+        const std::vector<int>& primes = halton_primes();
+        if (dim >= static_cast<int>(primes.size())) return random_double();
+        Real x = radical_inverse(primes[dim], static_cast<uint64_t>(index));
+        x += u32_to_unit(static_cast<uint32_t>(hash_combine(pixel, dim) >> 32));
+        if (x >= 1) x -= 1;
+        return x < kOneMinusEpsilon ? x : kOneMinusEpsilon;
+    }
+};
+
+inline uint32_t reverse_bits(uint32_t x) {
+    x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+    x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+    x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+    x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+    return (x >> 16) | (x << 16);
+}
+
+// Laine-Karras 置换：只让低位影响高位，对位反转后的值做就是 Owen 嵌套均匀打乱
+inline uint32_t laine_karras_permutation(uint32_t x, uint32_t seed) {
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return x;
+}
+
+inline uint32_t nested_uniform_scramble(uint32_t x, uint32_t seed) {
+    x = reverse_bits(x);
+    x = laine_karras_permutation(x, seed);
+    return reverse_bits(x);
+}
+
+// 4 维 Sobol 序列的方向数：第 0 维是位反转（van der Corput），后 3 维用 Joe-Kuo 的参数
+inline const uint32_t (&sobol_directions())[4][32] {
+    static const struct Table {
+        uint32_t v[4][32];
+        Table() {
+            // Joe-Kuo new-joe-kuo-6.21201 的第 2~4 维：s 次本原多项式，系数 a，初始值 m
+            const int s[3] = {1, 2, 3};
+            const int a[3] = {0, 1, 1};
+            const uint32_t m[3][3] = {{1, 0, 0}, {1, 3, 0}, {1, 3, 1}};
+            for (int i = 0; i < 32; ++i) v[0][i] = 1u << (31 - i);
+            for (int d = 0; d < 3; ++d) {
+                uint32_t* dir = v[d + 1];
+                for (int i = 0; i < s[d]; ++i) dir[i] = m[d][i] << (31 - i);
+                for (int i = s[d]; i < 32; ++i) {
+                    dir[i] = dir[i - s[d]] ^ (dir[i - s[d]] >> s[d]);
+                    for (int k = 1; k < s[d]; ++k)
+                        dir[i] ^= ((a[d] >> (s[d] - 1 - k)) & 1) * dir[i - k];
+                }
+            }
+        }
+    } table;
+    return table.v;
+}
+
+inline uint32_t sobol_sample(uint32_t index, int dim) {
+    const uint32_t (&v)[4][32] = sobol_directions();
+    uint32_t x = 0;
+    for (int bit = 0; index; index >>= 1, ++bit)
+        if (index & 1) x ^= v[dim][bit];
+    return x;
+}
+
+/**
+* Owen 打乱的 Sobol 序列 (Burley 2020, Practical Hash-based Owen Scrambling)：
+* 维度按 4 个一组，每组是一个 4 维 Sobol 点；组内的样本下标先做一次嵌套均匀打乱（样本顺序洗牌），
+* 每一维的值再用不同的种子打乱。种子由 (像素, 组号) 哈希出来，组和组之间、像素和像素之间都不相关，
+* 相机块占一组，每次反弹块占两组
+*/
+class SobolSampler : public Sampler {
+public:
+    explicit SobolSampler(int spp) : Sampler(spp) {}
+
+    virtual std::unique_ptr<Sampler> clone(int n) const override {
+        return std::unique_ptr<Sampler>(new SobolSampler(n));
+    }
+    virtual const char* name() const override { return "sobol"; }
+
+protected:
+    virtual Real sample_1d(int dim) override {
+        uint32_t seed = static_cast<uint32_t>(hash_combine(pixel, dim / 4));
+        uint32_t i = nested_uniform_scramble(static_cast<uint32_t>(index), seed);
+        uint32_t x = nested_uniform_scramble(sobol_sample(i, dim % 4), static_cast<uint32_t>(hash_combine(seed, dim % 4)));
+        return u32_to_unit(x);
+    }
+};
+
+/**
+* 可平铺的蓝噪声阈值图 (kSize x kSize)，用 Ulichney 的 void-and-cluster 方法在第一次使用时生成：
+* 能量是环面上的高斯核之和，反复把最密的点挪到最空的位置，然后按 "去掉最密的点 / 填上最空的位置" 的顺序给每个像素排名，
+* 排名归一化到 [0,1) 就是阈值。相邻像素的值差得远，误差集中在高频，低通（人眼、降噪器）之后残差很小
+*@brief value(x, y) 取 (x, y) 处的阈值，坐标按 kSize 环绕
+*/
+class BlueNoiseMask {
+public:
+    static constexpr int kSize = 64;
+    static constexpr int kCount = kSize * kSize;
+    static constexpr uint64_t kBlueNoiseSeedStream = 64; // 固定的流，每次生成的图都一样
+
+    static const BlueNoiseMask& instance() {
+        static const BlueNoiseMask mask;
+        return mask;
+    }
+
+    Real value(int x, int y) const {
+        return rank_value[(y & (kSize - 1)) * kSize + (x & (kSize - 1))];
+    }
+
+private:
+    BlueNoiseMask() : rank_value(kCount) {
+        // 环面上的高斯核，sigma = 1.5
+        std::vector<double> kernel(kCount);
+        for (int y = 0; y < kSize; ++y) {
+            for (int x = 0; x < kSize; ++x) {
+                int dx = std::min(x, kSize - x), dy = std::min(y, kSize - y);
+                kernel[y * kSize + x] = std::exp(-(dx * dx + dy * dy) / (2 * 1.5 * 1.5));
+            }
+        }
+        std::vector<char> on(kCount, 0);
+        std::vector<double> energy(kCount, 0.0);
+        auto toggle = [&](int p, bool set) {
+            on[p] = set;
+            double sign = set ? 1 : -1;
+            int px = p % kSize, py = p / kSize;
+            for (int y = 0; y < kSize; ++y) {
+                const double* row = &kernel[((y - py) & (kSize - 1)) * kSize];
+                double* e = &energy[y * kSize];
+                for (int x = 0; x < kSize; ++x) e[x] += sign * row[(x - px) & (kSize - 1)];
+            }
+        };
+        // 值为 state 的像素里能量最大（最密）/ 最小（最空）的那个
+        auto tightest = [&](char state) {
+            int best = -1;
+            for (int p = 0; p < kCount; ++p)
+                if (on[p] == state && (best < 0 || energy[p] > energy[best])) best = p;
+            return best;
+        };
+        auto largest_void = [&](char state) {
+            int best = -1;
+            for (int p = 0; p < kCount; ++p)
+                if (on[p] == state && (best < 0 || energy[p] < energy[best])) best = p;
+            return best;
+        };
+
+        // 初始图案：固定种子随机撒 10% 的点，再松弛到均匀
+        Pcg32 rng;
+        rng.seed(0x5eedb1e5ULL, kBlueNoiseSeedStream);
+        const int initial = kCount / 10;
+        for (int n = 0; n < initial;) {
+            int p = static_cast<int>(rng.next_u32() % kCount);
+            if (!on[p]) { toggle(p, true); ++n; }
+        }
+        for (int iter = 0; iter < kCount; ++iter) {
+            int cluster = tightest(1);
+            toggle(cluster, false);
+            int hole = largest_void(0);
+            toggle(hole, true);
+            if (hole == cluster) break;
+        }
+        std::vector<char> prototype = on;
+        std::vector<double> prototype_energy = energy;
+
+        std::vector<int> rank(kCount, -1);
+        // 第一阶段：从初始图案里逐个去掉最密的点，排名从 initial-1 递减
+        for (int r = initial - 1; r >= 0; --r) {
+            int p = tightest(1);
+            toggle(p, false);
+            rank[p] = r;
+        }
+        // 第二阶段：回到初始图案，逐个填上最空的位置直到填满
+        on = prototype;
+        energy = prototype_energy;
+        for (int r = initial; r < kCount; ++r) {
+            int p = largest_void(0);
+            toggle(p, true);
+            rank[p] = r;
+        }
+        for (int p = 0; p < kCount; ++p) rank_value[p] = (rank[p] + Real(0.5)) / kCount;
+    }
+
+    std::vector<Real> rank_value;
+};
+
+/**
+* 蓝噪声采样器，给 1~4 spp 的预览用：每一维的值 = 蓝噪声阈值图在 (像素坐标 + 这一维的偏移) 处的值，
+* 再按样本序号做 Cranley-Patterson 平移（时间方向的旋转）：一维用黄金分割比，成对的两维用 R2 序列的两个无理数。
+* 同一个样本序号下相邻像素的误差呈蓝噪声分布，渐进渲染时每一遍之间又是低差异的。
+* 每一维的偏移由维度号哈希出来，维度之间不相关
+*@param image_width 图像宽度，把像素下标还原成 (x, y)
+*/
+class BlueNoiseSampler : public Sampler {
+public:
+    BlueNoiseSampler(int spp, int image_width) : Sampler(spp), width(image_width > 0 ? image_width : 1) {}
+
+    virtual std::unique_ptr<Sampler> clone(int n) const override {
+        return std::unique_ptr<Sampler>(new BlueNoiseSampler(n, width));
+    }
+    virtual const char* name() const override { return "bluenoise"; }
+
+protected:
+    virtual Real sample_1d(int dim) override {
+        return rotate(mask_value(dim), Real(0.6180339887498949));
+    }
+
+    virtual void sample_2d(int dim, Real& u, Real& v) override {
+        // R2 序列：g 是塑料数 x^3 = x + 1 的根，(1/g, 1/g^2) 在二维上最均匀
+        const Real a1 = Real(0.7548776662466927), a2 = Real(0.5698402909980532);
+        u = rotate(mask_value(dim), a1);
+        v = rotate(mask_value(dim + 1), a2);
+    }
+
+private:
+    Real mask_value(int dim) const {
+        uint64_t h = mix_bits(static_cast<uint64_t>(dim) + 1);
+        int x = static_cast<int>(pixel % width) + static_cast<int>(h & 63);
+        int y = static_cast<int>(pixel / width) + static_cast<int>((h >> 6) & 63);
+        return BlueNoiseMask::instance().value(x, y);
+    }
+
+    Real rotate(Real m, Real alpha) const {
+        Real x = m + static_cast<Real>(std::fmod(static_cast<double>(index) * alpha, 1.0));
+        if (x >= 1) x -= 1;
+        return x < kOneMinusEpsilon ? x : kOneMinusEpsilon;
+    }
+
+    int width;
+};
+
+// 按名字创建采样器，名字不认识返回空指针；蓝噪声需要知道图像宽度才能把像素下标换成坐标
+inline std::unique_ptr<Sampler> make_sampler(const std::string& name, int spp, int image_width = 0) {
+    if (name == "independent") return std::unique_ptr<Sampler>(new IndependentSampler(spp));
+    if (name == "stratified") return std::unique_ptr<Sampler>(new StratifiedSampler(spp));
+    if (name == "halton") return std::unique_ptr<Sampler>(new HaltonSampler(spp));
+    if (name == "sobol") return std::unique_ptr<Sampler>(new SobolSampler(spp));
+    if (name == "bluenoise") return std::unique_ptr<Sampler>(new BlueNoiseSampler(spp, image_width));
+    return nullptr;
+}
+
+#endif
@@ -0,0 +1,192 @@
+#ifndef SAMPLING_H
+#define SAMPLING_H
+
+#include "utils.h"
+#include "vec3.h"
+#include <cmath>
+
+// 解析的采样函数：输入 [0,1) 的样本（来自 Sampler 或 random_double），直接算出方向或点，不做拒绝循环，
+// 每个样本只消耗固定的维数；每个采样函数配一个对应的 pdf，给重要性采样和 MIS 用
+
+/**
+* 标准正交基 (Orthonormal Basis)：w 是给定的单位法线，u、v 和它两两垂直
+* 用 Duff 等人 (2017) 的无分支构造，法线接近任何轴都没有奇异点
+*@brief to_world(d) 把局部坐标系（z 轴朝 w）里的方向变换到世界坐标系
+*/
+struct Onb {
+    Vec3 u, v, w;
+
+    explicit Onb(const Vec3& n) : w(n) {
+        Real sign = std::copysign(Real(1), n.z());
+        Real a = -1 / (sign + n.z());
+        Real b = n.x() * n.y() * a;
+        u = Vec3(1 + sign * n.x() * n.x() * a, sign * b, -sign * n.x());
+        v = Vec3(b, sign + n.y() * n.y() * a, -n.y());
+    }
+
+    Vec3 to_world(const Vec3& d) const {
+        return d.x() * u + d.y() * v + d.z() * w;
+    }
+};
+
+// 单位球面上均匀分布（z 均匀 + 方位角均匀），pdf = 1/(4pi)
+inline Vec3 sample_uniform_sphere(Real u1, Real u2) {
+    Real z = 1 - 2 * u1;
+    Real r = std::sqrt(std::fmax(Real(0), 1 - z * z));
+    Real phi = 2 * pi * u2;
+    return Vec3(r * std::cos(phi), r * std::sin(phi), z);
+}
+
+inline Real uniform_sphere_pdf() {
+    return 1 / (4 * pi);
+}
+
+// 单位球内均匀分布：球面方向 * 半径的立方根，pdf = 3/(4pi)
+inline Vec3 sample_uniform_ball(Real u1, Real u2, Real u3) {
+    return sample_uniform_sphere(u1, u2) * std::cbrt(u3);
+}
+
+// 局部坐标系里 z > 0 的半球上均匀分布，pdf = 1/(2pi)
+inline Vec3 sample_uniform_hemisphere(Real u1, Real u2) {
+    Real z = u1;
+    Real r = std::sqrt(std::fmax(Real(0), 1 - z * z));
+    Real phi = 2 * pi * u2;
+    return Vec3(r * std::cos(phi), r * std::sin(phi), z);
+}
+
+inline Real uniform_hemisphere_pdf() {
+    return 1 / (2 * pi);
+}
+
+// Shirley-Chiu 同心映射：正方形映射到单位圆盘，面积保持、扭曲小，分层样本映射过去仍然分层
+inline void sample_concentric_disk(Real u1, Real u2, Real& x, Real& y) {
+    Real a = 2 * u1 - 1;
+    Real b = 2 * u2 - 1;
+    if (a == 0 && b == 0) {
+        x = y = 0;
+        return;
+    }
+    Real r, theta;
+    if (std::fabs(a) > std::fabs(b)) {
+        r = a;
+        theta = (pi / 4) * (b / a);
+    } else {
+        r = b;
+        theta = (pi / 2) - (pi / 4) * (a / b);
+    }
+    x = r * std::cos(theta);
+    y = r * std::sin(theta);
+}
+
+// 局部坐标系里的余弦加权半球采样 (Malley 方法：圆盘上均匀取点再投影到半球)，pdf = cos(theta)/pi
+inline Vec3 sample_cosine_hemisphere(Real u1, Real u2) {
+    Real x, y;
+    sample_concentric_disk(u1, u2, x, y);
+    Real z = std::sqrt(std::fmax(Real(0), 1 - x * x - y * y));
+    return Vec3(x, y, z);
+}
+
+inline Real cosine_hemisphere_pdf(Real cos_theta) {
+    return cos_theta > 0 ? cos_theta / pi : 0;
+}
+
+/**
+* 球形光源上采样的结果
+*@param p    光源上的点
+*@param n    该点处的外法线
+*@param wi   从着色点指向 p 的单位方向
+*@param dist 着色点到 p 的距离
+*@param pdf  对立体角的 pdf
+*/
+struct SphereLightSample {
+    Point3 p;
+    Vec3 n;
+    Vec3 wi;
+    Real dist;
+    Real pdf;
+};
+
+/**
+* 从着色点 ref 看过去，在球 (center, radius) 张成的圆锥里按立体角均匀采样（pbrt 的方法）：
+* 所有样本都落在 ref 能看到的那一侧球面上，不会像整球面积采样那样浪费一半在背面。
+* ref 在球内时退回整球面积采样，pdf 换算成立体角
+*@return 采样是否有效
+*/
+inline bool sample_sphere_solid_angle(const Point3& center, Real radius, const Point3& ref, Real u1, Real u2, SphereLightSample& s) {
+    Vec3 wc = center - ref;
+    Real dc2 = wc.length_squared();
+    Real r2 = radius * radius;
+    if (dc2 <= r2) {
+        s.n = sample_uniform_sphere(u1, u2);
+        s.p = center + radius * s.n;
+        Vec3 d = s.p - ref;
+        Real d2 = d.length_squared();
+        if (d2 == 0) return false;
+        s.dist = std::sqrt(d2);
+        s.wi = d / s.dist;
+        Real cos_light = std::fabs(dot(s.n, s.wi));
+        if (cos_light == 0) return false;
+        s.pdf = d2 / (cos_light * 4 * pi * r2);
+        return true;
+    }
+
+    Real dc = std::sqrt(dc2);
+    Real sin_max2 = r2 / dc2;
+    Real cos_max = std::sqrt(std::fmax(Real(0), 1 - sin_max2));
+    Real cos_theta = (1 - u1) + u1 * cos_max;
+    Real sin_theta2 = std::fmax(Real(0), 1 - cos_theta * cos_theta);
+    Real one_minus_cos_max = 1 - cos_max;
+    if (sin_max2 < Real(0.00068523)) { // 光源张角小于 1.5 度，1 - cos 有相消误差，换成泰勒展开
+        sin_theta2 = sin_max2 * u1;
+        cos_theta = std::sqrt(1 - sin_theta2);
+        one_minus_cos_max = sin_max2 / 2;
+    }
+
+    // 由圆锥里的方向求出它和球面的交点在球上的角度 alpha
+    Real ds = dc * cos_theta - std::sqrt(std::fmax(Real(0), r2 - dc2 * sin_theta2));
+    Real cos_alpha = (dc2 + r2 - ds * ds) / (2 * dc * radius);
+    Real sin_alpha = std::sqrt(std::fmax(Real(0), 1 - cos_alpha * cos_alpha));
+    Real phi = 2 * pi * u2;
+
+    Onb frame(wc / dc);
+    s.n = -frame.to_world(Vec3(sin_alpha * std::cos(phi), sin_alpha * std::sin(phi), cos_alpha));
+    s.p = center + radius * s.n;
+    Vec3 d = s.p - ref;
+    s.dist = d.length();
+    s.wi = d / s.dist;
+    s.pdf = 1 / (2 * pi * one_minus_cos_max);
+    return true;
+}
+
+// 和 sample_sphere_solid_angle 配套：ref 看向球的任意方向的立体角 pdf（方向要在圆锥里，MIS 时算另一种策略的 pdf 用）
+inline Real sphere_solid_angle_pdf(const Point3& center, Real radius, const Point3& ref) {
+    Real dc2 = (center - ref).length_squared();
+    Real sin_max2 = radius * radius / dc2;
+    if (sin_max2 >= 1) return 0; // 在球内，调用方要自己按面积换算
+    if (sin_max2 < Real(0.00068523)) return 1 / (pi * sin_max2);
+    return 1 / (2 * pi * (1 - std::sqrt(1 - sin_max2)));
+}
+
+// 三角形上均匀分布，返回重心坐标 (b0, b1)，第三个是 1 - b0 - b1；对面积的 pdf = 1/面积
+inline void sample_uniform_triangle(Real u1, Real u2, Real& b0, Real& b1) {
+    Real su = std::sqrt(u1);
+    b0 = 1 - su;
+    b1 = u2 * su;
+}
+
+inline Point3 sample_triangle(const Point3& p0, const Point3& p1, const Point3& p2, Real u1, Real u2, Real& pdf) {
+    Real b0, b1;
+    sample_uniform_triangle(u1, u2, b0, b1);
+    Real area = 0.5 * cross(p1 - p0, p2 - p0).length();
+    pdf = area > 0 ? 1 / area : 0;
+    return b0 * p0 + b1 * p1 + (1 - b0 - b1) * p2;
+}
+
+// 平行四边形 corner + s*e1 + t*e2 (s,t in [0,1)) 上均匀分布，对面积的 pdf = 1/|e1 x e2|
+inline Point3 sample_quad(const Point3& corner, const Vec3& e1, const Vec3& e2, Real u1, Real u2, Real& pdf) {
+    Real area = cross(e1, e2).length();
+    pdf = area > 0 ? 1 / area : 0;
+    return corner + u1 * e1 + u2 * e2;
+}
+
+#endif
@@ -0,0 +1,215 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "utils.h"
+#include "hittable_list.hpp"
+#include "bvh.h"
+#include "arena.h"
+#include "material.hpp"
+#include "sphere.h"
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+* 发光体表，commit 时对每个发光物体预先算好面积、辐射亮度和功率
+*@param shape    发光物体
+*@param sphere   发光物体是球体时指向它，commit 时转换一次，渲染时不用再做 RTTI（目前光子发射和直接光照只支持球体）
+*@param material 发光材质
+*@param area     表面积
+*@param radiance 辐射亮度 Le（纹理取包围盒中心的值）
+*@param power    功率 Le * area * pi，按它的大小分配光子和光源采样
+*/
+struct Emitter {
+    shared_ptr<HittableObj> shape;
+    const Sphere* sphere = nullptr;
+    const Material* material = nullptr;
+    Real area = 0;
+    Color radiance;
+    Color power;
+};
+
+// 加速结构的类型：物体很少时线性列表也够用，默认用 BVH
+enum class AccelType { List, Bvh };
+
+/**
+* Scene 类：渲染器用的场景。先 add 物体，再 commit 一次把物体列表编译成可以渲染的场景：
+*    1. 检查每个物体的包围盒（必须存在且有限），给顶层物体编号
+*    2. 建加速结构（BVH 或线性列表）
+*    3. 建材质表（去重，材质编号给 AOV、按材质排序用）
+*    4. 建发光体表和按功率的采样分布 (CDF)；光源采样和光子发射只支持球体，其他形状的发光物体会警告并且不进发光体表
+* commit 失败返回 false，错误信息打到 std::cerr；add 之后要重新 commit
+*@param arena       场景存储，物体、材质、纹理可以用 arena.make<T>() 创建，BVH 节点也放在这里，场景析构时整块释放
+*@param objects     顶层物体列表，编号就是下标
+*@param materials   材质表
+*@param emitters    发光体表
+*@param emitter_cdf 发光体按功率的累积分布，最后一个元素是 1
+*@param bounds      整个场景的包围盒
+*@brief accel() 已经 commit 的加速结构，所有渲染器都在它上面求交
+*@brief sample_emitter(u, pdf) 用 [0,1) 的随机数按功率选一个发光体，返回它的下标
+*@brief emitter_index(prim_id) 顶层物体对应的发光体下标，不是发光体返回 -1；emitter_pdf(i) 选中第 i 个发光体的概率，MIS 用
+*/
+class Scene {
+public:
+    Scene() {}
+
+    void add(shared_ptr<HittableObj> object) {
+        objects.push_back(object);
+        committed = false;
+    }
+
+    bool commit(AccelType type = AccelType::Bvh);
+
+    bool is_committed() const { return committed; }
+
+    const HittableObj& accel() const { return *accel_root; }
+
+    bool hit(const Ray& r, Real t_min, Real t_max, HitRecord& rec) const {
+        return accel_root->hit(r, t_min, t_max, rec);
+    }
+
+    // 材质编号，不在材质表里的返回 -1
+    int material_id(const Material* m) const {
+        auto it = material_index.find(m);
+        return it == material_index.end() ? -1 : it->second;
+    }
+
+    int sample_emitter(Real u, Real& pdf) const;
+
+    int emitter_index(int prim_id) const {
+        return (prim_id >= 0 && prim_id < static_cast<int>(emitter_of_prim.size())) ? emitter_of_prim[prim_id] : -1;
+    }
+
+    Real emitter_pdf(int idx) const {
+        return emitter_cdf[idx] - (idx > 0 ? emitter_cdf[idx - 1] : 0);
+    }
+
+public:
+    Arena arena; // 放在最前面，最后析构
+    std::vector<shared_ptr<HittableObj>> objects;
+    std::vector<const Material*> materials;
+    std::vector<Emitter> emitters;
+    std::vector<Real> emitter_cdf;
+    aabb bounds;
+
+private:
+    bool committed = false;
+    shared_ptr<HittableObj> accel_root;
+    std::unordered_map<const Material*, int> material_index;
+    std::vector<int> emitter_of_prim;
+};
+
+// 颜色的平均值，用来把功率变成一个标量权重
+inline Real average_component(const Color& c) {
+    return (c.x() + c.y() + c.z()) / 3;
+}
+
+inline bool Scene::commit(AccelType type) {
+    committed = false;
+    materials.clear();
+    material_index.clear();
+    emitters.clear();
+    emitter_cdf.clear();
+    emitter_of_prim.clear();
+
+    if (objects.empty()) {
+        std::cerr << "Scene::commit: 场景里没有物体\n";
+        return false;
+    }
+
+    // 1. 包围盒检查 + 顶层物体编号
+    for (size_t i = 0; i < objects.size(); ++i) {
+        aabb box;
+        if (!objects[i]->bounding_box(0, 0, box)) {
+            std::cerr << "Scene::commit: 第 " << i << " 个物体没有包围盒\n";
+            return false;
+        }
+        bool finite = true;
+        for (int a = 0; a < 3; ++a) {
+            if (!std::isfinite(box.min().e[a]) || !std::isfinite(box.max().e[a]) || box.min().e[a] > box.max().e[a])
+                finite = false;
+        }
+        if (!finite) {
+            std::cerr << "Scene::commit: 第 " << i << " 个物体的包围盒无效 ("
+                      << box.min() << ") - (" << box.max() << ")\n";
+            return false;
+        }
+        bounds = (i == 0) ? box : surrounding_box(bounds, box);
+        objects[i]->assign_prim_id(static_cast<int>(i));
+    }
+
+    // 2. 加速结构
+    if (type == AccelType::Bvh) {
+        accel_root = arena.make<BvhNode>(objects, 0, objects.size(), 0, 0, &arena);
+    } else {
+        auto list = arena.make<HittableObjList>();
+        list->objects = objects;
+        accel_root = list;
+    }
+
+    // 3. 材质表 + 4. 发光体表
+    Real total_weight = 0;
+    for (const auto& object : objects) {
+        std::vector<const Material*> used;
+        object->collect_materials(used);
+        bool all_emissive = !used.empty();
+        for (const Material* m : used) {
+            if (m && material_index.find(m) == material_index.end()) {
+                material_index[m] = static_cast<int>(materials.size());
+                materials.push_back(m);
+            }
+            if (!material_as<DiffuseLight>(m)) all_emissive = false;
+        }
+        if (!all_emissive) continue;
+
+        Emitter e;
+        e.shape = object;
+        e.sphere = dynamic_cast<const Sphere*>(object.get());
+        e.material = used[0];
+        e.area = object->area();
+        aabb box;
+        object->bounding_box(0, 0, box);
+        e.radiance = e.material->emitted(0, 0, 0.5 * (box.min() + box.max()));
+        e.power = e.radiance * e.area * pi;
+        if (!e.sphere) {
+            // 放进表里也采样不到：NEE 白白浪费样本，PM/PPM 选中它的光子直接丢掉，光子图的能量就少了一块
+            std::cerr << "Scene::commit: 警告: 发光物体 " << object->prim_id << " 不是球体，光源采样和光子发射只支持球形光源，"
+                      << "它不作为光源：路径追踪只能靠 BSDF 采样击中它，PM/PPM 里它不发射光子\n";
+            continue;
+        }
+        if (e.area <= 0 || average_component(e.power) <= 0) {
+            std::cerr << "Scene::commit: 发光物体 " << object->prim_id << " 的面积或功率为 0，不作为光源\n";
+            continue;
+        }
+        total_weight += average_component(e.power);
+        emitters.push_back(e);
+    }
+    Real running = 0;
+    emitter_of_prim.assign(objects.size(), -1);
+    for (size_t i = 0; i < emitters.size(); ++i) {
+        running += average_component(emitters[i].power);
+        emitter_cdf.push_back(running / total_weight);
+        emitter_of_prim[emitters[i].shape->prim_id] = static_cast<int>(i);
+    }
+    if (!emitter_cdf.empty()) emitter_cdf.back() = 1;
+
+    std::cout << "场景: " << objects.size() << " 个物体, " << materials.size() << " 种材质, "
+              << emitters.size() << " 个光源, 加速结构 " << (type == AccelType::Bvh ? "BVH" : "list") << "\n";
+    arena.report(std::cout);
+    committed = true;
+    return true;
+}
+
+inline int Scene::sample_emitter(Real u, Real& pdf) const {
+    if (emitters.empty()) {
+        pdf = 0;
+        return -1;
+    }
+    int idx = static_cast<int>(std::upper_bound(emitter_cdf.begin(), emitter_cdf.end(), u) - emitter_cdf.begin());
+    if (idx >= static_cast<int>(emitters.size())) idx = static_cast<int>(emitters.size()) - 1;
+    pdf = emitter_pdf(idx);
+    return idx;
+}
+
+#endif
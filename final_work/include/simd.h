@@ -0,0 +1,127 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include "utils.h"
+
+/**
+* 4 通道的 SIMD 小封装，给 Vec3 用（Vec3 补齐到 4 个分量，第 4 个分量恒为 0）
+* 根据 Real 和编译目标选择实现：
+*    float  + SSE   : __m128
+*    double + AVX2  : __m256d
+*    double + SSE2  : 两个 __m128d
+*    其他架构或定义了 RT_NO_SIMD : 普通的 4 元数组（标量回退）
+* Lane4 只在寄存器里用，读写都通过 16/32 字节对齐的 Real[4]
+*/
+#if !defined(RT_NO_SIMD) && defined(RT_USE_FLOAT) && defined(__SSE__)
+    #define RT_SIMD_SSE_FLOAT
+#elif !defined(RT_NO_SIMD) && !defined(RT_USE_FLOAT) && defined(__AVX2__)
+    #define RT_SIMD_AVX_DOUBLE
+#elif !defined(RT_NO_SIMD) && !defined(RT_USE_FLOAT) && defined(__SSE2__)
+    #define RT_SIMD_SSE2_DOUBLE
+#endif
+
+#if defined(RT_SIMD_SSE_FLOAT) || defined(RT_SIMD_AVX_DOUBLE) || defined(RT_SIMD_SSE2_DOUBLE)
+    #include <immintrin.h>
+#endif
+
+namespace simd {
+
+#if defined(RT_SIMD_SSE_FLOAT)
+
+inline const char* backend_name() { return "SSE (float x4)"; }
+
+using Lane4 = __m128;
+
+inline Lane4 load(const Real* p)        { return _mm_load_ps(p); }
+inline void  store(Real* p, Lane4 a)    { _mm_store_ps(p, a); }
+inline Lane4 set1(Real x)               { return _mm_set1_ps(x); }
+inline Lane4 zero()                     { return _mm_setzero_ps(); }
+inline Lane4 add(Lane4 a, Lane4 b)      { return _mm_add_ps(a, b); }
+inline Lane4 sub(Lane4 a, Lane4 b)      { return _mm_sub_ps(a, b); }
+inline Lane4 mul(Lane4 a, Lane4 b)      { return _mm_mul_ps(a, b); }
+inline Lane4 div(Lane4 a, Lane4 b)      { return _mm_div_ps(a, b); }
+inline Lane4 min(Lane4 a, Lane4 b)      { return _mm_min_ps(a, b); }
+inline Lane4 max(Lane4 a, Lane4 b)      { return _mm_max_ps(a, b); }
+inline Lane4 sqrt(Lane4 a)              { return _mm_sqrt_ps(a); }
+// (x, y, z, w) -> (y, z, x, w)，叉乘用
+inline Lane4 yzx(Lane4 a)               { return _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1)); }
+
+#elif defined(RT_SIMD_AVX_DOUBLE)
+
+inline const char* backend_name() { return "AVX2 (double x4)"; }
+
+using Lane4 = __m256d;
+
+inline Lane4 load(const Real* p)        { return _mm256_load_pd(p); }
+inline void  store(Real* p, Lane4 a)    { _mm256_store_pd(p, a); }
+inline Lane4 set1(Real x)               { return _mm256_set1_pd(x); }
+inline Lane4 zero()                     { return _mm256_setzero_pd(); }
+inline Lane4 add(Lane4 a, Lane4 b)      { return _mm256_add_pd(a, b); }
+inline Lane4 sub(Lane4 a, Lane4 b)      { return _mm256_sub_pd(a, b); }
+inline Lane4 mul(Lane4 a, Lane4 b)      { return _mm256_mul_pd(a, b); }
+inline Lane4 div(Lane4 a, Lane4 b)      { return _mm256_div_pd(a, b); }
+inline Lane4 min(Lane4 a, Lane4 b)      { return _mm256_min_pd(a, b); }
+inline Lane4 max(Lane4 a, Lane4 b)      { return _mm256_max_pd(a, b); }
+inline Lane4 sqrt(Lane4 a)              { return _mm256_sqrt_pd(a); }
+inline Lane4 yzx(Lane4 a)               { return _mm256_permute4x64_pd(a, _MM_SHUFFLE(3, 0, 2, 1)); }
+
+#elif defined(RT_SIMD_SSE2_DOUBLE)
+
+inline const char* backend_name() { return "SSE2 (double x2 x2)"; }
+
+// 低半部分 (x, y)，高半部分 (z, w)
+struct Lane4 { __m128d lo, hi; };
+
+inline Lane4 load(const Real* p)        { return {_mm_load_pd(p), _mm_load_pd(p + 2)}; }
+inline void  store(Real* p, Lane4 a)    { _mm_store_pd(p, a.lo); _mm_store_pd(p + 2, a.hi); }
+inline Lane4 set1(Real x)               { return {_mm_set1_pd(x), _mm_set1_pd(x)}; }
+inline Lane4 zero()                     { return {_mm_setzero_pd(), _mm_setzero_pd()}; }
+inline Lane4 add(Lane4 a, Lane4 b)      { return {_mm_add_pd(a.lo, b.lo), _mm_add_pd(a.hi, b.hi)}; }
+inline Lane4 sub(Lane4 a, Lane4 b)      { return {_mm_sub_pd(a.lo, b.lo), _mm_sub_pd(a.hi, b.hi)}; }
+inline Lane4 mul(Lane4 a, Lane4 b)      { return {_mm_mul_pd(a.lo, b.lo), _mm_mul_pd(a.hi, b.hi)}; }
+inline Lane4 div(Lane4 a, Lane4 b)      { return {_mm_div_pd(a.lo, b.lo), _mm_div_pd(a.hi, b.hi)}; }
+inline Lane4 min(Lane4 a, Lane4 b)      { return {_mm_min_pd(a.lo, b.lo), _mm_min_pd(a.hi, b.hi)}; }
+inline Lane4 max(Lane4 a, Lane4 b)      { return {_mm_max_pd(a.lo, b.lo), _mm_max_pd(a.hi, b.hi)}; }
+inline Lane4 sqrt(Lane4 a)              { return {_mm_sqrt_pd(a.lo), _mm_sqrt_pd(a.hi)}; }
+inline Lane4 yzx(Lane4 a)               { return {_mm_shuffle_pd(a.lo, a.hi, 1), _mm_shuffle_pd(a.lo, a.hi, 2)}; }
+
+#else
+
+inline const char* backend_name() { return "scalar"; }
+
+struct Lane4 { Real v[4]; };
+
+inline Lane4 load(const Real* p)        { return {{p[0], p[1], p[2], p[3]}}; }
+inline void  store(Real* p, Lane4 a)    { for (int i = 0; i < 4; ++i) p[i] = a.v[i]; }
+inline Lane4 set1(Real x)               { return {{x, x, x, x}}; }
+inline Lane4 zero()                     { return {{0, 0, 0, 0}}; }
+inline Lane4 add(Lane4 a, Lane4 b)      { Lane4 r; for (int i = 0; i < 4; ++i) r.v[i] = a.v[i] + b.v[i]; return r; }
+inline Lane4 sub(Lane4 a, Lane4 b)      { Lane4 r; for (int i = 0; i < 4; ++i) r.v[i] = a.v[i] - b.v[i]; return r; }
+inline Lane4 mul(Lane4 a, Lane4 b)      { Lane4 r; for (int i = 0; i < 4; ++i) r.v[i] = a.v[i] * b.v[i]; return r; }
+inline Lane4 div(Lane4 a, Lane4 b)      { Lane4 r; for (int i = 0; i < 4; ++i) r.v[i] = a.v[i] / b.v[i]; return r; }
+inline Lane4 min(Lane4 a, Lane4 b)      { Lane4 r; for (int i = 0; i < 4; ++i) r.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i]; return r; }
+inline Lane4 max(Lane4 a, Lane4 b)      { Lane4 r; for (int i = 0; i < 4; ++i) r.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i]; return r; }
+inline Lane4 sqrt(Lane4 a)              { Lane4 r; for (int i = 0; i < 4; ++i) r.v[i] = std::sqrt(a.v[i]); return r; }
+inline Lane4 yzx(Lane4 a)               { return {{a.v[1], a.v[2], a.v[0], a.v[3]}}; }
+
+#endif
+
+// 一个向量寄存器能放几个 Real（AVX 32 字节，否则 16 字节），至少和 Lane4 一样是 4 个；
+// 按 SoA 批量处理的循环（SphereSet）用它做步长：float + AVX 是 8，其他情况是 4
+#if !defined(RT_NO_SIMD) && defined(__AVX__)
+constexpr int kVectorBytes = 32;
+#else
+constexpr int kVectorBytes = 16;
+#endif
+constexpr int kRealLanes = kVectorBytes / int(sizeof(Real)) > 4 ? kVectorBytes / int(sizeof(Real)) : 4;
+
+// 前三个通道求和（第 4 个通道是补齐用的，不参与）
+inline Real hsum3(Lane4 a) {
+    alignas(4 * sizeof(Real)) Real t[4];
+    store(t, a);
+    return t[0] + t[1] + t[2];
+}
+
+} // namespace simd
+
+#endif
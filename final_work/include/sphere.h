@@ -11,21 +11,31 @@
 *@param center 球心位置
 *@param radius 球的半径
 *@param mat_ptr 指向球体材质的智能指针
-*@brief hit(r, t_min, t_max, rec) 判断光线 r 是否与球体相交
+*@brief intersect(r, t_min, t_max, hit) 判断光线 r 是否与球体相交，只算 t
+*@brief surface_interaction(r, hit, rec) 对最近交点计算交点、法线、uv 和材质
 */
 class Sphere : public HittableObj {
 public:
     Sphere() {}
-    Sphere(Point3 cen, double r, shared_ptr<Material> m)
+    Sphere(Point3 cen, Real r, shared_ptr<Material> m)
         : center(cen), radius(r), mat_ptr(m) {};
 
-    virtual bool hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const override;
+    virtual bool intersect(const Ray& r, Real t_min, Real t_max, PrimHit& hit) const override;
 
-    virtual bool bounding_box(double time0, double time1, aabb& output_box) const override;
+    virtual void surface_interaction(const Ray& r, const PrimHit& hit, HitRecord& rec) const override;
 
-private:
-    //得到球面p对应的的uv坐标
-    static void get_sphere_uv(const Point3& p, double& u, double& v) {
+    virtual bool bounding_box(Real time0, Real time1, aabb& output_box) const override;
+
+    virtual void hit_packet(const RayPacket& packet, uint32_t active, Real t_min, PacketHits& hits) const override;
+
+    virtual uint32_t occluded_packet(const RayPacket& packet, uint32_t active, Real t_min, const Real* t_max) const override;
+
+    virtual void collect_materials(std::vector<const Material*>& out) const override { out.push_back(mat_ptr.get()); }
+
+    virtual Real area() const override { return 4 * pi * radius * radius; }
+
+    //得到球面p对应的的uv坐标，SphereSet 也要复用，所以放在 public 里
+    static void get_sphere_uv(const Point3& p, Real& u, Real& v) {
 
         auto theta = acos(-p.y());
         auto phi = atan2(-p.z(), p.x()) + pi;
@@ -38,39 +48,98 @@ private:
 
 public:
     Point3 center;
-    double radius;
+    Real radius;
     shared_ptr<Material> mat_ptr;
 };
 // 光线与球体相交的实现
-bool Sphere::hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const {
+bool Sphere::intersect(const Ray& r, Real t_min, Real t_max, PrimHit& hit) const {
     Vec3 o2c = r.origin() - center;//光线原点指向球心的向量
     auto a = r.direction().length_squared();//光线方向向量的长度平方
     auto half_b = dot(o2c, r.direction());
     auto c = o2c.length_squared() - radius*radius;
 
-    auto Delta = half_b*half_b - a*c;//判别式
+    // 判别式写成 a*(r^2 - |o2c - (half_b/a)*d|^2)，和 half_b^2 - a*c 相等，
+    // 但不会在大半径球（墙壁）上发生相消，float 精度下也稳定
+    Vec3 l = o2c - (half_b / a) * r.direction();
+    auto Delta = a * (radius*radius - l.length_squared());//判别式
     if (Delta < 0) return false;
     auto sqrtd = sqrt(Delta);
 
+    // 两个根用 q 的形式求，避免 -half_b 和 sqrtd 相减损失精度
+    auto q = -half_b - std::copysign(sqrtd, half_b);
+    auto root0 = c / q;
+    auto root1 = q / a;
+    if (root0 > root1) std::swap(root0, root1);
+
     // 找到位于可接受范围内的最近的根。
-    auto root = (-half_b - sqrtd) / a;
+    auto root = root0;
     if (root < t_min || root > t_max) {
-        root = (-half_b + sqrtd) / a;
+        root = root1;
         if (root < t_min || root > t_max)
             return false;
     }
-    //把交点信息存入 hitRecord 结构体里面
-    rec.t = root;
+    // 这里只记下 t，法线和 uv (acos/atan2) 等确定是最近交点后再算
+    hit.t = root;
+    hit.prim = this;
+    hit.sub_index = 0;
+
+    return true;
+}
+
+//把交点信息存入 hitRecord 结构体里面
+void Sphere::surface_interaction(const Ray& r, const PrimHit& hit, HitRecord& rec) const {
+    rec.t = hit.t;
     rec.p = r.at(rec.t);//计算交点
     Vec3 outward_normal = (rec.p - center) / radius;
     rec.set_face_normal(r, outward_normal);
     get_sphere_uv(outward_normal, rec.u, rec.v);
-    rec.mat_ptr = mat_ptr;
+    rec.mat_ptr = mat_ptr.get();
+}
 
-    return true;
+// 光线包与球体求交：所有光线的根一起算（和 intersect 相同的公式）
+void Sphere::hit_packet(const RayPacket& p, uint32_t active, Real t_min, PacketHits& hits) const {
+    const Real cx = center.x(), cy = center.y(), cz = center.z();
+    const Real rr = radius*radius;
+    Real root_lane[RayPacket::kMaxSize];
+    bool lane_hit[RayPacket::kMaxSize];
+
+    #pragma omp simd
+    for (int k = 0; k < p.size; ++k) {
+        Real ocx = p.ox[k] - cx, ocy = p.oy[k] - cy, ocz = p.oz[k] - cz;
+        Real a = p.dx[k]*p.dx[k] + p.dy[k]*p.dy[k] + p.dz[k]*p.dz[k];
+        Real half_b = ocx*p.dx[k] + ocy*p.dy[k] + ocz*p.dz[k];
+        Real c = ocx*ocx + ocy*ocy + ocz*ocz - rr;
+        Real s = half_b / a;
+        Real lx = ocx - s*p.dx[k], ly = ocy - s*p.dy[k], lz = ocz - s*p.dz[k];
+        Real Delta = a * (rr - (lx*lx + ly*ly + lz*lz));
+        Real sqrtd = std::sqrt(Delta > 0 ? Delta : Real(0));
+        Real q = -half_b - std::copysign(sqrtd, half_b);
+        Real root0 = c / q, root1 = q / a;
+        Real near_root = root0 < root1 ? root0 : root1;
+        Real far_root = root0 < root1 ? root1 : root0;
+        Real root = (near_root >= t_min && near_root <= hits.t[k]) ? near_root : far_root;
+        lane_hit[k] = Delta >= 0 && root >= t_min && root <= hits.t[k];
+        root_lane[k] = root;
+    }
+    for (int k = 0; k < p.size; ++k) {
+        if (!(active & (1u << k)) || !lane_hit[k]) continue;
+        hits.hit[k].t = root_lane[k];
+        hits.hit[k].prim = this;
+        hits.hit[k].sub_index = 0;
+        hits.t[k] = root_lane[k];
+        hits.mask |= (1u << k);
+    }
+}
+
+// 遮挡测试直接复用整包求根，t_max 当作每条光线当前的最近交点
+uint32_t Sphere::occluded_packet(const RayPacket& p, uint32_t active, Real t_min, const Real* t_max) const {
+    PacketHits hits;
+    for (int k = 0; k < p.size; ++k) hits.t[k] = t_max[k];
+    hit_packet(p, active, t_min, hits);
+    return hits.mask;
 }
 
-bool Sphere::bounding_box(double time0, double time1, aabb& output_box) const {
+bool Sphere::bounding_box(Real time0, Real time1, aabb& output_box) const {
     output_box = aabb(
         center - Vec3(radius, radius, radius),
         center + Vec3(radius, radius, radius));
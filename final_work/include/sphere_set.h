@@ -0,0 +1,269 @@
+#ifndef SPHERE_SET_H
+#define SPHERE_SET_H
+
+#include "hittable_obj.h"
+#include "sphere.h"
+#include "simd.h"
+#include "vec3.h"
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+/**
+* SphereSet 类：把大量球体按 SoA (Structure of Arrays) 的方式存在一起，继承自 HittableObj
+* 程序化场景里动辄几十万个球，每个球单独一个对象、一个 BVH 叶子再走一次虚函数 intersect 太慢了，
+* 这里球心、半径、材质编号各自存成连续数组，build() 时在球上建一棵内部 BVH，叶子是 kLanes 个球的一个 SoA 块，
+* 遍历到叶子时一次 SIMD 步长同时测试整块，而且只有最近的那个交点才去算法线、uv (acos/atan2) 和材质。
+* 先 add 完所有球再调用一次 build()，没有 build 的集合没有包围盒，Scene::commit 会报错
+*@param cx,cy,cz 球心坐标数组，build 之后按块排好，长度是 kLanes 的整数倍
+*@param radius   半径数组
+*@param mat_id   材质编号数组，是 materials 里的下标
+*@param materials 材质表，相同材质只存一份
+*@brief add(center, r, m) 添加一个球体，返回它是第几个加入的
+*@brief build() 按球心把球分成 kLanes 个一块，建内部 BVH
+*/
+class SphereSet : public HittableObj {
+public:
+    static constexpr int kLanes = simd::kRealLanes; // 每个 SIMD 步长同时测试的球数，float + AVX 时是 8
+
+    SphereSet() {}
+
+    int add(const Point3& center, Real r, shared_ptr<Material> m);
+    size_t size() const { return count; }
+    void build();
+
+    virtual bool intersect(const Ray& r, Real t_min, Real t_max, PrimHit& hit) const override;
+
+    virtual void surface_interaction(const Ray& r, const PrimHit& hit, HitRecord& rec) const override;
+
+    virtual bool bounding_box(Real time0, Real time1, aabb& output_box) const override;
+
+    virtual void collect_materials(std::vector<const Material*>& out) const override {
+        for (const auto& m : materials) out.push_back(m.get());
+    }
+
+public:
+    std::vector<Real> cx, cy, cz;
+    std::vector<Real> radius;
+    std::vector<int> mat_id;
+    std::vector<shared_ptr<Material>> materials;
+
+private:
+    /**
+    内部 BVH 的节点，按深度优先存放，左孩子紧跟在自己后面
+    *@param right 右孩子的下标，叶子是 -1
+    *@param block 叶子对应的 SoA 块，块里的球是 [block * kLanes, (block + 1) * kLanes)，内部节点是 -1
+    *@param axis  划分的坐标轴，遍历时按光线方向先走近的孩子
+    */
+    struct Node {
+        aabb box;
+        int right = -1;
+        int block = -1;
+        int axis = 0;
+    };
+
+    size_t count = 0; // 真实的球数，块尾部多出来的是补齐用的重复球
+    aabb box;
+    std::vector<Point3> pending_center; // add 进来、还没 build 的球
+    std::vector<Real> pending_radius;
+    std::vector<int> pending_mat;
+    std::vector<Node> nodes;
+    int blocks = 0;
+
+    int material_index(const shared_ptr<Material>& m);
+    int build_node(std::vector<int>& ids, int begin, int end);
+    static bool hit_box(const aabb& b, const Real* o, const Real* inv, Real t_min, Real t_max);
+    void intersect_block(const Ray& r, int block, Real t_min, Real& closest, long& best) const;
+};
+
+inline int SphereSet::material_index(const shared_ptr<Material>& m) {
+    // 材质一般就几种，线性查一下就行
+    for (size_t i = 0; i < materials.size(); ++i)
+        if (materials[i] == m) return static_cast<int>(i);
+    materials.push_back(m);
+    return static_cast<int>(materials.size() - 1);
+}
+
+inline int SphereSet::add(const Point3& center, Real r, shared_ptr<Material> m) {
+    pending_center.push_back(center);
+    pending_radius.push_back(r);
+    pending_mat.push_back(material_index(m));
+    nodes.clear(); // 需要重新 build
+
+    Vec3 rvec(r, r, r);
+    aabb sphere_box(center - rvec, center + rvec);
+    box = (count == 0) ? sphere_box : surrounding_box(box, sphere_box);
+    return static_cast<int>(count++);
+}
+
+inline void SphereSet::build() {
+    nodes.clear();
+    blocks = 0;
+    if (count == 0) return;
+    size_t padded = (count + kLanes - 1) / kLanes * kLanes;
+    cx.assign(padded, 0);
+    cy.assign(padded, 0);
+    cz.assign(padded, 0);
+    radius.assign(padded, 0);
+    mat_id.assign(padded, -1);
+    std::vector<int> ids(count);
+    for (size_t i = 0; i < count; ++i) ids[i] = static_cast<int>(i);
+    nodes.reserve(2 * padded / kLanes);
+    build_node(ids, 0, static_cast<int>(count));
+}
+
+// 中位数划分：左边的球数取一半再向上补齐到 kLanes 的倍数，除了最后一块，每块都是满的
+inline int SphereSet::build_node(std::vector<int>& ids, int begin, int end) {
+    const int index = static_cast<int>(nodes.size());
+    nodes.push_back(Node());
+    aabb node_box, centroid_box;
+    for (int k = begin; k < end; ++k) {
+        const Point3& c = pending_center[ids[k]];
+        Real r = pending_radius[ids[k]];
+        aabb sphere_box(c - Vec3(r, r, r), c + Vec3(r, r, r));
+        node_box = (k == begin) ? sphere_box : surrounding_box(node_box, sphere_box);
+        centroid_box = (k == begin) ? aabb(c, c) : surrounding_box(centroid_box, aabb(c, c));
+    }
+    nodes[index].box = node_box;
+
+    const int n = end - begin;
+    if (n <= kLanes) {
+        // 叶子：写进一个 SoA 块，空位重复块里最后一个球（同样的 t，比较时不会替换掉前面的）
+        const int block = blocks++;
+        nodes[index].block = block;
+        for (int k = 0; k < kLanes; ++k) {
+            int id = ids[begin + std::min(k, n - 1)];
+            size_t slot = size_t(block) * kLanes + k;
+            cx[slot] = pending_center[id].x();
+            cy[slot] = pending_center[id].y();
+            cz[slot] = pending_center[id].z();
+            radius[slot] = pending_radius[id];
+            mat_id[slot] = pending_mat[id];
+        }
+        return index;
+    }
+
+    Vec3 extent = centroid_box.max() - centroid_box.min();
+    int axis = 0;
+    if (extent.y() > extent[axis]) axis = 1;
+    if (extent.z() > extent[axis]) axis = 2;
+    const int mid = begin + (n / 2 + kLanes - 1) / kLanes * kLanes;
+    std::nth_element(ids.begin() + begin, ids.begin() + mid, ids.begin() + end, [this, axis](int a, int b) {
+        return pending_center[a][axis] < pending_center[b][axis];
+    });
+    nodes[index].axis = axis;
+    build_node(ids, begin, mid);
+    int right = build_node(ids, mid, end);
+    nodes[index].right = right;
+    return index;
+}
+
+// 光线与一块 kLanes 个球求交：只算 t，比 closest 更近时更新 closest 和球的槽位 best
+inline void SphereSet::intersect_block(const Ray& r, int block, Real t_min, Real& closest, long& best) const {
+    const Real ox = r.orig.x(), oy = r.orig.y(), oz = r.orig.z();
+    const Real dx = r.dir.x(), dy = r.dir.y(), dz = r.dir.z();
+    const Real a = dx*dx + dy*dy + dz*dz;
+    const Real inv_a = 1 / a;
+    const size_t base = size_t(block) * kLanes;
+    const Real limit = closest;
+    Real t_lane[kLanes];
+    // 这一段没有分支，编译器可以直接向量化成 kLanes 宽的运算
+    #pragma omp simd
+    for (int k = 0; k < kLanes; ++k) {
+        size_t i = base + k;
+        Real ocx = ox - cx[i];
+        Real ocy = oy - cy[i];
+        Real ocz = oz - cz[i];
+        Real half_b = ocx*dx + ocy*dy + ocz*dz;
+        Real rr = radius[i]*radius[i];
+        Real c = ocx*ocx + ocy*ocy + ocz*ocz - rr;
+        // 和 Sphere::hit 一样用不相消的判别式和 q 形式的根
+        Real lx = ocx - half_b*inv_a*dx;
+        Real ly = ocy - half_b*inv_a*dy;
+        Real lz = ocz - half_b*inv_a*dz;
+        Real Delta = a * (rr - (lx*lx + ly*ly + lz*lz));
+        Real sqrtd = std::sqrt(Delta > 0 ? Delta : Real(0));
+        Real q = -half_b - std::copysign(sqrtd, half_b);
+        Real root0 = c / q;
+        Real root1 = q * inv_a;
+        Real near_root = root0 < root1 ? root0 : root1;
+        Real far_root = root0 < root1 ? root1 : root0;
+        Real root = (near_root >= t_min && near_root <= limit) ? near_root : far_root;
+        bool ok = Delta >= 0 && root >= t_min && root <= limit;
+        t_lane[k] = ok ? root : infinity;
+    }
+    for (int k = 0; k < kLanes; ++k) {
+        if (t_lane[k] < closest) {
+            closest = t_lane[k];
+            best = static_cast<long>(base + k);
+        }
+    }
+}
+
+// 包围盒的 slab 测试，方向的倒数在遍历开始时算一次，不用每个节点再做三次除法
+inline bool SphereSet::hit_box(const aabb& b, const Real* o, const Real* inv, Real t_min, Real t_max) {
+    for (int a = 0; a < 3; ++a) {
+        Real t0 = (b.minimum[a] - o[a]) * inv[a];
+        Real t1 = (b.maximum[a] - o[a]) * inv[a];
+        if (inv[a] < 0) std::swap(t0, t1);
+        t_min = t0 > t_min ? t0 : t_min;
+        t_max = t1 < t_max ? t1 : t_max;
+        if (t_max <= t_min) return false;
+    }
+    return true;
+}
+
+// 内部 BVH 的遍历：用栈代替递归，先走光线方向上近的孩子，找到交点之后远的孩子大多被包围盒测试剔掉
+inline bool SphereSet::intersect(const Ray& r, Real t_min, Real t_max, PrimHit& hit) const {
+    if (nodes.empty()) return false;
+    const Real o[3] = {r.orig.x(), r.orig.y(), r.orig.z()};
+    const Real inv[3] = {1 / r.dir.x(), 1 / r.dir.y(), 1 / r.dir.z()};
+    Real closest = t_max;
+    long best = -1;
+    int stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const int index = stack[--top];
+        const Node& node = nodes[index];
+        if (!hit_box(node.box, o, inv, t_min, closest)) continue;
+        if (node.block >= 0) {
+            intersect_block(r, node.block, t_min, closest, best);
+            continue;
+        }
+        int near_child = index + 1, far_child = node.right;
+        if (r.dir[node.axis] < 0) std::swap(near_child, far_child);
+        stack[top++] = far_child;
+        stack[top++] = near_child;
+    }
+    if (best < 0) return false;
+
+    hit.t = closest;
+    hit.prim = this;
+    hit.sub_index = static_cast<int>(best);
+    return true;
+}
+
+// 只对最终胜出的球计算交点、法线、uv 和材质
+inline void SphereSet::surface_interaction(const Ray& r, const PrimHit& hit, HitRecord& rec) const {
+    int i = hit.sub_index;
+    Point3 center(cx[i], cy[i], cz[i]);
+    rec.t = hit.t;
+    rec.p = r.at(rec.t);
+    Vec3 outward_normal = (rec.p - center) / radius[i];
+    rec.set_face_normal(r, outward_normal);
+    Sphere::get_sphere_uv(outward_normal, rec.u, rec.v);
+    rec.mat_ptr = materials[mat_id[i]].get();
+}
+
+inline bool SphereSet::bounding_box(Real time0, Real time1, aabb& output_box) const {
+    if (count == 0) return false;
+    if (nodes.empty()) {
+        std::cerr << "SphereSet: 加完球之后要先调用 build()\n";
+        return false;
+    }
+    output_box = box;
+    return true;
+}
+
+#endif
@@ -5,13 +5,23 @@
 #include "vec3.h"
 #include "stb_image.h"
 
+// 纹理类型标签：纯色和图像纹理在 eval_texture 里直接求值，不走虚函数；其他纹理是 Custom，回退到 value()
+enum class TextureType { Solid, Image, Custom };
+
 /**
 * 纹理基类，所有纹理类型都应继承自此类
+*@param type 纹理类型标签，自定义的纹理不用管，默认是 Custom
 *@brief value(u, v, p) 根据纹理坐标 (u, v) 和位置 p 返回颜色值
 */
 class Texture {
 public:
-    virtual Color value(double u, double v, const Point3& p) const = 0;
+    Texture() : type(TextureType::Custom) {}
+    explicit Texture(TextureType t) : type(t) {}
+    virtual ~Texture() {}
+
+    const TextureType type;
+
+    virtual Color value(Real u, Real v, const Point3& p) const = 0;
 };
 
 
@@ -21,13 +31,15 @@ public:
 */
 class SolidColor : public Texture {
 public:
-    SolidColor() {}
-    SolidColor(Color c) : color_value(c) {}
+    SolidColor() : Texture(TextureType::Solid) {}
+    SolidColor(Color c) : Texture(TextureType::Solid), color_value(c) {}
 
-    virtual Color value(double u, double v, const Point3& p) const override {
+    virtual Color value(Real u, Real v, const Point3& p) const override {
         return color_value;
     }
 
+    const Color& color() const { return color_value; }
+
 private:
     Color color_value;
 };
@@ -40,9 +52,9 @@ public:
     const static int bytes_per_pixel = 3;
 
     ImageTexture()
-      : data(nullptr), width(0), height(0), bytes_per_scanline(0) {}
+      : Texture(TextureType::Image), data(nullptr), width(0), height(0), bytes_per_scanline(0) {}
 
-    ImageTexture(const char* filename) {
+    ImageTexture(const char* filename) : Texture(TextureType::Image) {
         auto components_per_pixel = bytes_per_pixel;
 
         data = stbi_load(
@@ -61,7 +73,12 @@ public:
         if (data) stbi_image_free(data);
     }
 
-    virtual Color value(double u, double v, const Point3& p) const override {
+    virtual Color value(Real u, Real v, const Point3& p) const override {
+        return lookup(u, v);
+    }
+
+    // 非虚的查表函数，eval_texture 直接调用它
+    Color lookup(Real u, Real v) const {
         // 如果纹理数据不存在，返回红色作为错误指示
         if (data == nullptr)
             return Color(1, 0, 1);
@@ -77,7 +94,7 @@ public:
         if (i >= width)  i = width - 1;
         if (j >= height) j = height - 1;
 
-        const double color_scale = 1.0 / 255.0;
+        const Real color_scale = 1.0 / 255.0;
         auto pixel = data + j*bytes_per_scanline + i*bytes_per_pixel;
 
         return Color(color_scale*pixel[0], color_scale*pixel[1], color_scale*pixel[2]);
@@ -89,4 +106,41 @@ private:
     int bytes_per_scanline;
 };
 
+/**
+* 纹理求值：纯色纹理内联直接返回颜色，图像纹理走非虚的 lookup，只有自定义纹理才调用虚函数 value
+*@param t 纹理指针
+*@param u,v 纹理坐标
+*@param p 交点位置
+*/
+inline Color eval_texture(const Texture* t, Real u, Real v, const Point3& p) {
+    if (t->type == TextureType::Solid) return static_cast<const SolidColor*>(t)->color();
+    if (t->type == TextureType::Image) return static_cast<const ImageTexture*>(t)->lookup(u, v);
+    return t->value(u, v, p);
+}
+
+/**
+* 批量纹理求值：同一个纹理对 n 个交点求值，只分支一次，给按材质分组的着色阶段用
+*@param t 纹理指针
+*@param n 交点个数
+*@param u,v,p 长度为 n 的纹理坐标和交点数组（纯色纹理不读它们，可以传 nullptr）
+*@param out 长度为 n 的输出颜色
+*/
+inline void eval_texture_batch(const Texture* t, int n, const Real* u, const Real* v, const Point3* p, Color* out) {
+    switch (t->type) {
+    case TextureType::Solid: {
+        Color c = static_cast<const SolidColor*>(t)->color();
+        for (int i = 0; i < n; ++i) out[i] = c;
+        break;
+    }
+    case TextureType::Image: {
+        const ImageTexture* img = static_cast<const ImageTexture*>(t);
+        for (int i = 0; i < n; ++i) out[i] = img->lookup(u[i], v[i]);
+        break;
+    }
+    default:
+        for (int i = 0; i < n; ++i) out[i] = t->value(u[i], v[i], p[i]);
+        break;
+    }
+}
+
 #endif
@@ -0,0 +1,171 @@
+#ifndef TILE_SCHEDULER_H
+#define TILE_SCHEDULER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <omp.h>
+
+/**
+* 图像上的一个矩形块，像素行号和 buffer 一样，第 0 行在图像顶部
+*@param x0, y0 左上角（包含）
+*@param x1, y1 右下角（不包含）
+*/
+struct Tile {
+    int x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+};
+
+// 块的遍历顺序：逐行、Morton (Z 曲线)、Hilbert 曲线。后两种相邻的块在图像上也相邻，
+// 同一个线程连续处理的块打到的几何和纹理大致是同一片，缓存命中更好
+enum class TileOrder { Scanline, Morton, Hilbert };
+
+/**
+* 分块的参数
+*@param size  块的边长（像素）
+*@param order 块的遍历顺序
+*/
+struct TileSettings {
+    int size = 16;
+    TileOrder order = TileOrder::Hilbert;
+};
+
+inline bool parse_tile_order(const std::string& name, TileOrder& order) {
+    if (name == "scanline") order = TileOrder::Scanline;
+    else if (name == "morton") order = TileOrder::Morton;
+    else if (name == "hilbert") order = TileOrder::Hilbert;
+    else return false;
+    return true;
+}
+
+inline const char* tile_order_name(TileOrder order) {
+    switch (order) {
+        case TileOrder::Scanline: return "scanline";
+        case TileOrder::Morton: return "morton";
+        default: return "hilbert";
+    }
+}
+
+// 二维 Morton 码：x 占偶数位，y 占奇数位
+inline uint64_t morton_2d(uint32_t x, uint32_t y) {
+    uint64_t code = 0;
+    for (int bit = 0; bit < 32; ++bit) {
+        code |= uint64_t((x >> bit) & 1) << (2 * bit);
+        code |= uint64_t((y >> bit) & 1) << (2 * bit + 1);
+    }
+    return code;
+}
+
+// (x, y) 在边长为 n（2 的幂）的 Hilbert 曲线上的序号
+inline uint64_t hilbert_2d(uint32_t n, uint32_t x, uint32_t y) {
+    uint64_t d = 0;
+    for (uint32_t s = n / 2; s > 0; s /= 2) {
+        uint32_t rx = (x & s) ? 1 : 0;
+        uint32_t ry = (y & s) ? 1 : 0;
+        d += uint64_t(s) * s * ((3 * rx) ^ ry);
+        // 旋转象限，让子曲线首尾相接
+        if (ry == 0) {
+            if (rx == 1) {
+                x = s - 1 - x;
+                y = s - 1 - y;
+            }
+            std::swap(x, y);
+        }
+    }
+    return d;
+}
+
+/**
+* 把图像切成 tile_size x tile_size 的块（右边和下边的块可能小一些），按 order 排好
+* Morton / Hilbert 在覆盖块网格的 2 的幂大小的网格上算序号，网格外的位置直接跳过
+*/
+inline std::vector<Tile> make_tiles(int image_width, int image_height, const TileSettings& settings) {
+    const int size = std::max(settings.size, 1);
+    const int tiles_x = (image_width + size - 1) / size;
+    const int tiles_y = (image_height + size - 1) / size;
+    uint32_t n = 1;
+    while (n < uint32_t(std::max(tiles_x, tiles_y))) n *= 2;
+
+    std::vector<std::pair<uint64_t, Tile>> keyed;
+    keyed.reserve(size_t(tiles_x) * tiles_y);
+    for (int ty = 0; ty < tiles_y; ++ty)
+        for (int tx = 0; tx < tiles_x; ++tx) {
+            Tile t;
+            t.x0 = tx * size;
+            t.y0 = ty * size;
+            t.x1 = std::min(t.x0 + size, image_width);
+            t.y1 = std::min(t.y0 + size, image_height);
+            uint64_t key = uint64_t(ty) * tiles_x + tx;
+            if (settings.order == TileOrder::Morton) key = morton_2d(tx, ty);
+            else if (settings.order == TileOrder::Hilbert) key = hilbert_2d(n, tx, ty);
+            keyed.push_back(std::make_pair(key, t));
+        }
+    std::sort(keyed.begin(), keyed.end(), [](const std::pair<uint64_t, Tile>& a, const std::pair<uint64_t, Tile>& b) {
+        return a.first < b.first;
+    });
+    std::vector<Tile> tiles;
+    tiles.reserve(keyed.size());
+    for (const auto& k : keyed) tiles.push_back(k.second);
+    return tiles;
+}
+
+/**
+* 分块调度器：每个线程一个双端队列，开始时把按曲线排好的块切成连续的几段分给各个线程，
+* 每个线程从自己队列的头部取块，沿着曲线往前走；自己的取完了就从别的线程队列的尾部偷一块，
+* 偷的是离对方当前位置最远的块，不打断对方的局部性。
+* 队列只在取块时加锁，一个块里有成百上千条光线，锁的开销可以忽略
+*@param & tiles   按遍历顺序排好的块
+*@param threads   线程数，一般是 omp_get_max_threads()；实际线程比它少时，多出来的队列会被偷光
+*@brief next(thread, tile) 给第 thread 个线程取下一块，全部取完时返回 false
+*/
+class TileScheduler {
+public:
+    TileScheduler(const std::vector<Tile>& tiles, int threads) : queues(std::max(threads, 1)) {
+        const size_t q = queues.size();
+        for (size_t t = 0; t < q; ++t) {
+            size_t begin = tiles.size() * t / q;
+            size_t end = tiles.size() * (t + 1) / q;
+            queues[t].tiles.assign(tiles.begin() + begin, tiles.begin() + end);
+        }
+    }
+
+    bool next(int thread, Tile& tile) {
+        const int q = static_cast<int>(queues.size());
+        if (thread >= 0 && thread < q && queues[thread].pop_front(tile)) return true;
+        for (int k = 1; k <= q; ++k) {
+            int victim = (thread + k) % q;
+            if (victim < 0) victim += q;
+            if (queues[victim].pop_back(tile)) return true;
+        }
+        return false;
+    }
+
+private:
+    // 对齐到缓存行，不同线程的锁不挤在同一行里
+    struct alignas(64) Queue {
+        std::mutex lock;
+        std::deque<Tile> tiles;
+
+        bool pop_front(Tile& out) {
+            std::lock_guard<std::mutex> guard(lock);
+            if (tiles.empty()) return false;
+            out = tiles.front();
+            tiles.pop_front();
+            return true;
+        }
+
+        bool pop_back(Tile& out) {
+            std::lock_guard<std::mutex> guard(lock);
+            if (tiles.empty()) return false;
+            out = tiles.back();
+            tiles.pop_back();
+            return true;
+        }
+    };
+
+    std::vector<Queue> queues;
+};
+
+#endif
@@ -8,7 +8,8 @@
 *三角形类，继承自 HittableObj，用于模型的表示和光线相交计算
 *@param v0,v1,v2 三角形的三个顶点
 *@param mp 指向三角形材质的智能指针
-*@brief hit(r, t_min, t_max, rec) MT算法，判断光线 r 是否与三角形相交
+*@brief intersect(r, t_min, t_max, hit) MT算法，判断光线 r 是否与三角形相交，只记下 t 和重心坐标
+*@brief surface_interaction(r, hit, rec) 对最近交点计算交点、法线和材质
 */
 class Triangle : public HittableObj {
 public:
@@ -21,50 +22,62 @@ public:
     *@param  r 入射光线
     *@param  t_min 最小 t 值，防止自相交
     *@param  t_max 最大 t 值
-    *@param  rec 用于存储相交信息的 HitRecord 结构体
-    *@return 如果光线与三角形相交，返回 true 并填充 rec，否则返回 false
+    *@param  hit 用于存储 t 和重心坐标的 PrimHit
+    *@return 如果光线与三角形相交，返回 true 并填充 hit，否则返回 false
     */
-    virtual bool hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const override {
+    virtual bool intersect(const Ray& r, Real t_min, Real t_max, PrimHit& hit) const override {
         Vec3 v0v1 = v1 - v0;
         Vec3 v0v2 = v2 - v0;
         Vec3 pvec = cross(r.direction(), v0v2);
-        double det = dot(v0v1, pvec);
+        Real det = dot(v0v1, pvec);
 
         // culling
         if (fabs(det) < 1e-8) return false;
 
-        double invDet = 1.0 / det;
+        Real invDet = 1.0 / det;
 
         Vec3 tvec = r.origin() - v0;
-        double u = dot(tvec, pvec) * invDet;
+        Real u = dot(tvec, pvec) * invDet;
         if (u < 0 || u > 1) return false;
 
         Vec3 qvec = cross(tvec, v0v1);
-        double v = dot(r.direction(), qvec) * invDet;
+        Real v = dot(r.direction(), qvec) * invDet;
         if (v < 0 || u + v > 1) return false;
 
-        double t = dot(v0v2, qvec) * invDet;
+        Real t = dot(v0v2, qvec) * invDet;
 
         if (t < t_min || t > t_max) return false;
 
-        rec.t = t;
-        rec.p = r.at(t);
-        rec.set_face_normal(r, unit_vector(cross(v0v1, v0v2))); 
-        rec.mat_ptr = mp;
-        rec.u = u;
-        rec.v = v;
+        hit.t = t;
+        hit.prim = this;
+        hit.sub_index = 0;
+        hit.b1 = u;
+        hit.b2 = v;
 
         return true;
     }
 
-    virtual bool bounding_box(double time0, double time1, aabb& output_box) const override {
-        double min_x = fmin(v0.x(), fmin(v1.x(), v2.x()));
-        double min_y = fmin(v0.y(), fmin(v1.y(), v2.y()));
-        double min_z = fmin(v0.z(), fmin(v1.z(), v2.z()));
+    virtual void surface_interaction(const Ray& r, const PrimHit& hit, HitRecord& rec) const override {
+        rec.t = hit.t;
+        rec.p = r.at(hit.t);
+        rec.set_face_normal(r, unit_vector(cross(v1 - v0, v2 - v0)));
+        rec.mat_ptr = mp.get();
+        rec.u = hit.b1;
+        rec.v = hit.b2;
+    }
+
+    virtual void collect_materials(std::vector<const Material*>& out) const override { out.push_back(mp.get()); }
+
+    virtual Real area() const override { return 0.5 * cross(v1 - v0, v2 - v0).length(); }
+
+    virtual bool bounding_box(Real time0, Real time1, aabb& output_box) const override {
+        Real min_x = fmin(v0.x(), fmin(v1.x(), v2.x()));
+        Real min_y = fmin(v0.y(), fmin(v1.y(), v2.y()));
+        Real min_z = fmin(v0.z(), fmin(v1.z(), v2.z()));
 
-        double max_x = fmax(v0.x(), fmax(v1.x(), v2.x()));
-        double max_y = fmax(v0.y(), fmax(v1.y(), v2.y()));
-        double max_z = fmax(v0.z(), fmax(v1.z(), v2.z()));
+        Real max_x = fmax(v0.x(), fmax(v1.x(), v2.x()));
+        Real max_y = fmax(v0.y(), fmax(v1.y(), v2.y()));
+        Real max_z = fmax(v0.z(), fmax(v1.z(), v2.z()));
 
         output_box = aabb(
             Point3(min_x - 0.0001, min_y - 0.0001, min_z - 0.0001),
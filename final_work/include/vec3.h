@@ -4,6 +4,7 @@
 #include <cmath>
 #include <iostream>
 #include "utils.h"
+#include "simd.h"
 
 using std::sqrt;
 
@@ -11,51 +12,52 @@ using std::sqrt;
  * 两个类型别名：
  *    Point3: 用于表示三维空间中的点
  *    Color:  用于表示 RGB 颜色值
+ * 分量补齐到 4 个并按 SIMD 宽度对齐，e[3] 恒为 0，运算都走 simd.h 里的 Lane4
  */
-class Vec3 {
+class alignas(4 * sizeof(Real)) Vec3 {
 public:
-    double e[3];
+    Real e[4];
 
-    Vec3() : e{0,0,0} {}
-Vec3(double e0, double e1, double e2) : e{e0, e1, e2} {}
+    Vec3() : e{0,0,0,0} {}
+    Vec3(Real e0, Real e1, Real e2) : e{e0, e1, e2, 0} {}
+    explicit Vec3(simd::Lane4 v) { simd::store(e, v); }
 
-    double x() const { return e[0]; }
-    double y() const { return e[1]; }
-    double z() const { return e[2]; }
+    simd::Lane4 lanes() const { return simd::load(e); }
 
-    Vec3 operator-() const { return Vec3(-e[0], -e[1], -e[2]); }
-    double operator[](int i) const { return e[i]; }
-    double& operator[](int i) { return e[i]; }
+    Real x() const { return e[0]; }
+    Real y() const { return e[1]; }
+    Real z() const { return e[2]; }
+
+    Vec3 operator-() const { return Vec3(simd::sub(simd::zero(), lanes())); }
+    Real operator[](int i) const { return e[i]; }
+    Real& operator[](int i) { return e[i]; }
 
     Vec3& operator+=(const Vec3 &v) {
-        e[0] += v.e[0];
-        e[1] += v.e[1];
-        e[2] += v.e[2];
+        simd::store(e, simd::add(lanes(), v.lanes()));
         return *this;
     }
 
-    Vec3& operator*=(const double t) {
-        e[0] *= t;
-        e[1] *= t;
-        e[2] *= t;
+    Vec3& operator*=(const Real t) {
+        simd::store(e, simd::mul(lanes(), simd::set1(t)));
         return *this;
     }
 
-    Vec3& operator/=(const double t) {
+    Vec3& operator/=(const Real t) {
         return *this *= 1/t;
     }
 
-    double length() const {
+    Real length() const {
         return sqrt(length_squared());
     }
 
-    double length_squared() const {
-        return e[0]*e[0] + e[1]*e[1] + e[2]*e[2];
+    Real length_squared() const {
+        simd::Lane4 v = lanes();
+        return simd::hsum3(simd::mul(v, v));
     }
     
     bool near_zero() const {
         // 如果向量在所有维度上都非常接近零，则返回 true。
-        const double s = 1e-8;
+        const Real s = 1e-8;
         return (std::fabs(e[0]) < s) && (std::fabs(e[1]) < s) && (std::fabs(e[2]) < s);
     }
 
@@ -63,7 +65,7 @@ Vec3(double e0, double e1, double e2) : e{e0, e1, e2} {}
         return Vec3(random_double(), random_double(), random_double());
     }
 
-    inline static Vec3 random(double min, double max) {
+    inline static Vec3 random(Real min, Real max) {
         return Vec3(random_double(min,max), random_double(min,max), random_double(min,max));
     }
 };
@@ -79,39 +81,53 @@ inline std::ostream& operator<<(std::ostream &out, const Vec3 &v) {
 }
 
 inline Vec3 operator+(const Vec3 &u, const Vec3 &v) {
-    return Vec3(u.e[0] + v.e[0], u.e[1] + v.e[1], u.e[2] + v.e[2]);
+    return Vec3(simd::add(u.lanes(), v.lanes()));
 }
 
 inline Vec3 operator-(const Vec3 &u, const Vec3 &v) {
-    return Vec3(u.e[0] - v.e[0], u.e[1] - v.e[1], u.e[2] - v.e[2]);
+    return Vec3(simd::sub(u.lanes(), v.lanes()));
 }
 
 inline Vec3 operator*(const Vec3 &u, const Vec3 &v) {
-    return Vec3(u.e[0] * v.e[0], u.e[1] * v.e[1], u.e[2] * v.e[2]);
+    return Vec3(simd::mul(u.lanes(), v.lanes()));
 }
 
-inline Vec3 operator*(double t, const Vec3 &v) {
-    return Vec3(t*v.e[0], t*v.e[1], t*v.e[2]);
+inline Vec3 operator*(Real t, const Vec3 &v) {
+    return Vec3(simd::mul(simd::set1(t), v.lanes()));
 }
 
-inline Vec3 operator*(const Vec3 &v, double t) {
+inline Vec3 operator*(const Vec3 &v, Real t) {
     return t * v;
 }
 
-inline Vec3 operator/(Vec3 v, double t) {
+inline Vec3 operator/(Vec3 v, Real t) {
     return (1/t) * v;
 }
 
-inline double dot(const Vec3 &u, const Vec3 &v) {
-    return u.e[0] * v.e[0]
-         + u.e[1] * v.e[1]
-         + u.e[2] * v.e[2];
+inline Real dot(const Vec3 &u, const Vec3 &v) {
+    return simd::hsum3(simd::mul(u.lanes(), v.lanes()));
 }
 
+// 叉乘：cross(u, v) = (u * v.yzx - u.yzx * v).yzx，只需要两次乘法和三次通道重排
 inline Vec3 cross(const Vec3 &u, const Vec3 &v) {
-    return Vec3(u.e[1] * v.e[2] - u.e[2] * v.e[1],
-                u.e[2] * v.e[0] - u.e[0] * v.e[2],
-                u.e[0] * v.e[1] - u.e[1] * v.e[0]);
+    simd::Lane4 a = u.lanes();
+    simd::Lane4 b = v.lanes();
+    simd::Lane4 c = simd::sub(simd::mul(a, simd::yzx(b)), simd::mul(simd::yzx(a), b));
+    return Vec3(simd::yzx(c));
+}
+
+// 逐分量取最小/最大值，包围盒合并用
+inline Vec3 component_min(const Vec3 &u, const Vec3 &v) {
+    return Vec3(simd::min(u.lanes(), v.lanes()));
+}
+
+inline Vec3 component_max(const Vec3 &u, const Vec3 &v) {
+    return Vec3(simd::max(u.lanes(), v.lanes()));
+}
+
+// 逐分量开方，gamma=2.0 校正用
+inline Vec3 component_sqrt(const Vec3 &v) {
+    return Vec3(simd::sqrt(v.lanes()));
 }
 // 取单位向量
 inline Vec3 unit_vector(Vec3 v) {
@@ -122,47 +138,26 @@ inline Vec3 reflect(const Vec3& v, const Vec3& n) {
     return v - 2*dot(v,n)*n;
 }
 
-inline Vec3 refract(const Vec3& uv, const Vec3& n, double etai_over_etat) {
+inline Vec3 refract(const Vec3& uv, const Vec3& n, Real etai_over_etat) {
     auto cos_theta = fmin(dot(-uv, n), 1.0);
     Vec3 r_out_perp =  etai_over_etat * (uv + cos_theta*n);
     Vec3 r_out_parallel = -sqrt(fabs(1.0 - r_out_perp.length_squared())) * n;
     return r_out_perp + r_out_parallel;
 }
 
-inline Vec3 random_in_unit_sphere() {
-    while (true) {
-        auto p = Vec3::random(-1,1);
-        if (p.length_squared() >= 1) continue;
-        return p;
-    }
-}
-
-inline Vec3 random_unit_vector() {
-    return unit_vector(random_in_unit_sphere());
-}
-
-inline Vec3 random_in_hemisphere(const Vec3& normal) {
-    Vec3 in_unit_sphere = random_in_unit_sphere();
-    if (dot(in_unit_sphere, normal) > 0.0) // In the same hemisphere as the normal
-        return in_unit_sphere;
-    else
-        return -in_unit_sphere;
-}
-
 // ACES 色调映射tone mapping 近似，因为sppm和path tracing都需要这个，所以挪到这里来了
 inline Vec3 aces_approx(Vec3 v) {
-    v *= 0.6;
-    double a = 2.51;
-    double b = 0.03;
-    double c = 2.43;
-    double d = 0.59;
-    double e = 0.14;
-    // 逐分量应用公式
-    return Vec3(
-        clamp((v.x()*(a*v.x()+b))/(v.x()*(c*v.x()+d)+e), 0.0, 1.0),
-        clamp((v.y()*(a*v.y()+b))/(v.y()*(c*v.y()+d)+e), 0.0, 1.0),
-        clamp((v.z()*(a*v.z()+b))/(v.z()*(c*v.z()+d)+e), 0.0, 1.0)
-    );
+    using namespace simd;
+    Lane4 x = mul(v.lanes(), set1(0.6));
+    Lane4 a = set1(2.51);
+    Lane4 b = set1(0.03);
+    Lane4 c = set1(2.43);
+    Lane4 d = set1(0.59);
+    Lane4 e = set1(0.14);
+    // 三个分量一起套公式 (x*(a*x+b))/(x*(c*x+d)+e)，再限制到 [0,1]
+    Lane4 num = mul(x, add(mul(a, x), b));
+    Lane4 den = add(mul(x, add(mul(c, x), d)), e);
+    return Vec3(min(max(div(num, den), zero()), set1(1.0)));
 }
 
 #endif
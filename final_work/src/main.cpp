@@ -2,6 +2,10 @@
 #include "renderer_path.h"
 #include "renderer_ppm.h"
 #include "renderer_pm.h"
+#include "renderer_wavefront.h"
+#include "sampler.h"
+#include "film.h"
+#include "scene.h"
 #include "vec3.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -10,6 +14,7 @@
 #include <vector>
 #include <omp.h>
 #include <cstring>
+#include <algorithm>
 
 // 将颜色写入流的工具函数,这玩意不方便定义在utils.h里，因为会引入循环依赖
 void write_color(std::ostream &out, Color pixelColor, int samplesPerPixel)
@@ -37,6 +42,22 @@ int main(int argc, char* argv[]) {
     int width = 400;
     int height = 225;
     int samples = 100;
+    AccelType accel_type = AccelType::Bvh;
+    std::string sampler_name = "sobol";
+    int fg_samples = 512; // pm 的 Final Gather 光线数
+    int rr_min_bounce = 3; // 路径追踪从第几次反弹开始俄罗斯轮盘赌
+    AdaptiveSettings adaptive; // 路径追踪的自适应采样，阈值 <= 0 时关闭
+    bool progressive = false; // 渐进式路径追踪，累加到 HDR 胶片
+    int pass_spp = 4; // 渐进式每一遍每个像素的样本数
+    std::string checkpoint; // 检查点文件，存在时从它续算
+    double checkpoint_interval = 60; // 两次存检查点之间最少隔多少秒
+    int run_id = 0; // 同一个场景分几次渲染再合并时，每次用不同的编号
+    std::vector<std::string> merge_files; // 要合并的检查点文件，合并完直接输出，不渲染
+    double time_budget = 0; // 时间预算（秒），> 0 时渲染到时间用完为止，不看样本数 / 光子数
+    TileSettings tiles; // 分块调度：块大小和遍历顺序
+    DenoiseSettings denoise; // 第一个交点引导的 À-Trous 降噪
+    bool aov = false; // 同一遍里输出第一个交点的反照率 / 法线 / 深度 / 物体编号 / 材质编号
+    std::string tile_order = "hilbert";
 
     // 解析命令行参数
     for (int i = 1; i < argc; ++i) {
@@ -53,14 +74,112 @@ int main(int argc, char* argv[]) {
             width = static_cast<int>(height * (16.0/9.0));
         } else if ((arg == "-s" || arg == "--spp") && i + 1 < argc) {
             samples = std::atoi(argv[++i]);
+        } else if (arg == "--accel" && i + 1 < argc) {
+            std::string a = argv[++i];
+            accel_type = (a == "list") ? AccelType::List : AccelType::Bvh;
+        } else if (arg == "--sampler" && i + 1 < argc) {
+            sampler_name = argv[++i];
+        } else if (arg == "--fg" && i + 1 < argc) {
+            fg_samples = std::atoi(argv[++i]);
+        } else if (arg == "--rr" && i + 1 < argc) {
+            rr_min_bounce = std::atoi(argv[++i]);
+        } else if (arg == "--adaptive" && i + 1 < argc) {
+            adaptive.threshold = std::atof(argv[++i]);
+        } else if (arg == "--progressive") {
+            progressive = true;
+        } else if (arg == "--pass-spp" && i + 1 < argc) {
+            pass_spp = std::atoi(argv[++i]);
+        } else if (arg == "--checkpoint" && i + 1 < argc) {
+            checkpoint = argv[++i];
+            progressive = true;
+        } else if (arg == "--checkpoint-interval" && i + 1 < argc) {
+            checkpoint_interval = std::atof(argv[++i]);
+        } else if (arg == "--run-id" && i + 1 < argc) {
+            run_id = std::atoi(argv[++i]);
+        } else if (arg == "--merge" && i + 1 < argc) {
+            merge_files.push_back(argv[++i]);
+        } else if (arg == "--time" && i + 1 < argc) {
+            time_budget = std::atof(argv[++i]);
+        } else if (arg == "--tile" && i + 1 < argc) {
+            tiles.size = std::atoi(argv[++i]);
+        } else if (arg == "--tile-order" && i + 1 < argc) {
+            tile_order = argv[++i];
+        } else if (arg == "--denoise") {
+            denoise.enabled = true;
+        } else if (arg == "--denoise-iterations" && i + 1 < argc) {
+            denoise.iterations = std::atoi(argv[++i]);
+        } else if (arg == "--denoise-color" && i + 1 < argc) {
+            denoise.sigma_color = std::atof(argv[++i]);
+        } else if (arg == "--denoise-normal" && i + 1 < argc) {
+            denoise.sigma_normal = std::atof(argv[++i]);
+        } else if (arg == "--denoise-depth" && i + 1 < argc) {
+            denoise.sigma_depth = std::atof(argv[++i]);
+        } else if (arg == "--denoise-albedo" && i + 1 < argc) {
+            denoise.sigma_albedo = std::atof(argv[++i]);
+        } else if (arg == "--denoise-firefly" && i + 1 < argc) {
+            denoise.firefly_ratio = std::atof(argv[++i]);
+        } else if (arg == "--aov") {
+            aov = true;
         }
     }
     
     if (height == 0) height = static_cast<int>(width / (16.0/9.0));
 
-    std::cout << "光追模式(path tracing/pm/ppm): " << mode << "\n";
+    std::cout << "光追模式(path tracing/wavefront/pm/ppm): " << mode << "\n";
     std::cout << "尺寸: " << width << "x" << height << "\n";
     std::cout << "采样数(path tracing)/光子数(pm/ppm): " << samples << "\n";
+    std::unique_ptr<Sampler> sampler = make_sampler(sampler_name, samples, width);
+    if (!sampler) {
+        std::cerr << "未知的采样器: " << sampler_name << " (可选 independent/stratified/halton/sobol/bluenoise)\n";
+        return 1;
+    }
+    if (fg_samples < 1) fg_samples = 1;
+    if (pass_spp < 1) pass_spp = 1;
+    if (tiles.size < 1) tiles.size = 1;
+    if (!parse_tile_order(tile_order, tiles.order)) {
+        std::cerr << "未知的分块顺序: " << tile_order << " (可选 scanline/morton/hilbert)\n";
+        return 1;
+    }
+    if (run_id < 0 || run_id >= kFilmMaxRuns) {
+        std::cerr << "--run-id 要在 0 到 " << kFilmMaxRuns - 1 << " 之间\n";
+        return 1;
+    }
+    if (time_budget > 0 && mode == "wavefront") {
+        std::cerr << "--time 不支持 wavefront 模式（一批路径要一起走完），限时渲染请用 pt/pm/ppm\n";
+        return 1;
+    }
+    if (time_budget > 0 && adaptive.threshold > 0) {
+        std::cerr << "--adaptive 不能和 --time 一起用：自适应采样按误差阈值停，限时渲染按时间停，请二选一\n";
+        return 1;
+    }
+    if (adaptive.threshold > 0 && (progressive || !merge_files.empty())) {
+        std::cerr << "--adaptive 不能和 --progressive / --checkpoint / --merge 一起用：渐进式每遍给所有像素加同样多的样本，检查点里也没有每个像素的方差\n";
+        return 1;
+    }
+    if (adaptive.threshold > 0 && mode != "pt") {
+        std::cerr << "--adaptive 只支持 pt 模式，" << mode << " 模式不做自适应采样\n";
+        return 1;
+    }
+    if (time_budget > 0 && mode != "pm" && mode != "ppm") {
+        // 路径追踪限时渲染走渐进式：一遍一遍加样本，到点就停
+        mode = "pt";
+        progressive = true;
+    }
+    if (time_budget > 0) std::cout << "时间预算: " << time_budget << " 秒\n";
+    if (denoise.enabled && !merge_files.empty()) {
+        std::cerr << "--denoise 不能和 --merge 一起用：合并检查点不渲染，没有第一个交点缓冲\n";
+        return 1;
+    }
+    if (aov && !merge_files.empty()) {
+        std::cerr << "--aov 不能和 --merge 一起用：合并检查点不渲染，没有第一个交点缓冲\n";
+        return 1;
+    }
+    if (denoise.iterations < 0 || denoise.sigma_color <= 0 || denoise.sigma_normal <= 0 || denoise.sigma_depth <= 0 || denoise.sigma_albedo <= 0) {
+        std::cerr << "--denoise-iterations 不能是负数，--denoise-color/normal/depth/albedo 要大于 0\n";
+        return 1;
+    }
+    std::cout << "采样器: " << sampler_name << "\n";
+    std::cout << "数值精度: " << (sizeof(Real) == sizeof(float) ? "float" : "double") << "\n";
 
     // 图像
     const auto aspect_ratio = double(width) / height;
@@ -69,55 +188,58 @@ int main(int argc, char* argv[]) {
     const int samples_per_pixel = samples; 
     const int max_depth = 50; // 递归深度
 
-    // 世界，显而易见的世界也是一个支持光追的物体列表
-    HittableObjList world;
-    std::vector<shared_ptr<HittableObj>> lights; // Keep track of lights for SPPM
+    // 世界：先往场景里加物体，全部加完之后 commit 一次建加速结构、材质表和光源表
+    Scene world;
     
     //用指针的方式创建材质，方便多个物体共享同一个材质。
-    auto material_ground = make_shared<Lambertian>(Color(0.5, 0.5, 0.5)); // 地面灰色
-    auto material_cat_pic = make_shared<ImageTexture>("maodie.png"); 
-    auto material_cat = make_shared<Lambertian>(material_cat_pic);
+    auto material_ground = world.arena.make<Lambertian>(Color(0.5, 0.5, 0.5)); // 地面灰色
+    auto material_cat_pic = world.arena.make<ImageTexture>("maodie.png"); 
+    auto material_cat = world.arena.make<Lambertian>(material_cat_pic);
 
-    auto material_wall_back = make_shared<Lambertian>(Color(0.7, 0.3, 0.3)); // 后墙红色
-    auto material_wall_right = make_shared<Lambertian>(Color(0.3, 0.7, 0.3)); // 右墙绿色
-    auto material_wall_left = make_shared<Lambertian>(Color(0.3, 0.3, 0.7)); // 左墙蓝色
+    auto material_wall_back = world.arena.make<Lambertian>(Color(0.7, 0.3, 0.3)); // 后墙红色
+    auto material_wall_right = world.arena.make<Lambertian>(Color(0.3, 0.7, 0.3)); // 右墙绿色
+    auto material_wall_left = world.arena.make<Lambertian>(Color(0.3, 0.3, 0.7)); // 左墙蓝色
     
-    // auto material_center = make_shared<Lambertian>(Color(0.1, 0.2, 0.5));
-    auto texture_center = make_shared<ImageTexture>("maodie.png");
-    auto material_center = make_shared<Lambertian>(texture_center);
+    // auto material_center = world.arena.make<Lambertian>(Color(0.1, 0.2, 0.5));
+    auto texture_center = world.arena.make<ImageTexture>("maodie.png");
+    auto material_center = world.arena.make<Lambertian>(texture_center);
 
-    auto material_glass = make_shared<Dielectric>(1.5); // 玻璃 
-    auto color_glass = make_shared<Dielectric>(1.5,Color(0,0.5,0));//绿色玻璃
+    auto material_glass = world.arena.make<Dielectric>(1.5); // 玻璃 
+    auto color_glass = world.arena.make<Dielectric>(1.5,Color(0,0.5,0));//绿色玻璃
     // 增加一点粗糙度 (fuzz = 0.01) 让金属看起来更真实，不是完美的镜子
-    auto material_metal  = make_shared<Metal>(Color(0.8, 0.6, 0.2), 0.01);
+    auto material_metal  = world.arena.make<Metal>(Color(0.8, 0.6, 0.2), 0.01);
 
-    auto material_light = make_shared<DiffuseLight>(Color(50.0, 50.0, 50.0)); // 光（path tracing用的）
-    // auto material_light = make_shared<DiffuseLight>(Color(100.0, 100.0, 100.0)); // 更强的光（PM用的）
+    auto material_light = world.arena.make<DiffuseLight>(Color(50.0, 50.0, 50.0)); // 光（path tracing用的）
+    // auto material_light = world.arena.make<DiffuseLight>(Color(100.0, 100.0, 100.0)); // 更强的光（PM用的）
     //目前平面类还每实现
     // 地面
-    world.add(make_shared<Sphere>(Point3( 0.0, -100.5, -1.0), 100.0, material_ground));
+    world.add(world.arena.make<Sphere>(Point3( 0.0, -100.5, -1.0), 100.0, material_ground));
     // 后墙 (z = -3 左右)
-    world.add(make_shared<Sphere>(Point3(0, 0, -1003), 1000, material_wall_back));
+    world.add(world.arena.make<Sphere>(Point3(0, 0, -1003), 1000, material_wall_back));
     // 左墙
-    world.add(make_shared<Sphere>(Point3(-1002, 0, -1), 1000, material_wall_left));
+    world.add(world.arena.make<Sphere>(Point3(-1002, 0, -1), 1000, material_wall_left));
     // 右墙
-    world.add(make_shared<Sphere>(Point3( 1002, 0, -1), 1000, material_wall_right));
+    world.add(world.arena.make<Sphere>(Point3( 1002, 0, -1), 1000, material_wall_right));
     //前墙
-    world.add(make_shared<Sphere>(Point3(0, 0, 1005), 1000, material_wall_back));
+    world.add(world.arena.make<Sphere>(Point3(0, 0, 1005), 1000, material_wall_back));
 
     // 光源 (在上方)
-    auto light_sphere = make_shared<Sphere>(Point3(0.8, 1.5, 0.2), 0.2, material_light);
+    auto light_sphere = world.arena.make<Sphere>(Point3(0.8, 1.5, 0.2), 0.2, material_light);
     //这里把光源放到摄像机前面，可以直接看见光源，方便测试PM直接光照部分
     
-    world.add(light_sphere);
-    lights.push_back(light_sphere); // Add to lights list
+    world.add(light_sphere); // 发光材质的物体 commit 时会自动进光源表
 
     // 物体
-    // world.add(make_shared<Sphere>(Point3( -0.5,    0.0, 0.5),   0.5, material_center));
-    // world.add(make_shared<Sphere>(Point3( 0.0,    0.0, -1.0),   0.4, material_cat));
-    world.add(make_shared<Sphere>(Point3(-0.5,    0.0, 0.2),   0.5, material_glass));
-    // world.add(make_shared<Sphere>(Point3(-0.5,    0.0, 0.2),   0.5, color_glass));
-    world.add(make_shared<Sphere>(Point3( 1.1,    0.0, -1.1),   0.7, material_metal));
+    // world.add(world.arena.make<Sphere>(Point3( -0.5,    0.0, 0.5),   0.5, material_center));
+    // world.add(world.arena.make<Sphere>(Point3( 0.0,    0.0, -1.0),   0.4, material_cat));
+    world.add(world.arena.make<Sphere>(Point3(-0.5,    0.0, 0.2),   0.5, material_glass));
+    // world.add(world.arena.make<Sphere>(Point3(-0.5,    0.0, 0.2),   0.5, color_glass));
+    world.add(world.arena.make<Sphere>(Point3( 1.1,    0.0, -1.1),   0.7, material_metal));
+
+    if (!world.commit(accel_type)) {
+        std::cerr << "场景 commit 失败" << std::endl;
+        return 1;
+    }
 
     // 摄像机
     Point3 lookfrom(0, 1, 4); // 调整相机位置，正对墙角
@@ -134,27 +256,72 @@ int main(int argc, char* argv[]) {
 
     // 渲染
     std::string filename_ = "../images/" + filename;
-    std::ofstream outfile(filename_);
-    outfile << "P3\n" << image_width << " " << image_height << "\n255\n";
+    int out_width = image_width, out_height = image_height; // 合并检查点时以胶片的尺寸为准
 
     std::vector<unsigned char> buffer;
+    std::vector<int> sample_counts; // 自适应采样时每个像素的样本数
+    GBuffer guides; // 第一个交点缓冲：降噪的引导和 AOV 输出，渲染函数按像素数分配
+    GBuffer* gbuffer = (denoise.enabled || aov) ? &guides : nullptr;
+    std::string hdr_name = filename.substr(0, filename.rfind('.')) + ".pfm"; // 渐进式 / 合并时的 HDR 输出
 
-    if (mode == "pm") {
+    if (!merge_files.empty()) {
+        // 合并几次运行的检查点，样本数相加，不渲染
+        Film merged;
+        if (!merged.load(merge_files[0])) return 1;
+        for (size_t f = 1; f < merge_files.size(); ++f) {
+            Film other;
+            if (!other.load(merge_files[f]) || !merged.merge(other)) return 1;
+        }
+        std::cout << "合并了 " << merge_files.size() << " 个检查点, 共 " << merged.total_samples() << " 个样本\n";
+        if (merged.signature != scene_signature(world)) std::cerr << "警告: 检查点不是当前场景渲染的\n";
+        out_width = merged.width;
+        out_height = merged.height;
+        merged.resolve(buffer);
+        merged.write_pfm("../images/" + hdr_name);
+        if (!checkpoint.empty()) merged.save(checkpoint);
+    } else if (mode == "pm") {
         // PM的参数 
         int num_photons = samples * 10000; 
         double radius = 0.002; 
-        render_pm(world, lights, cam, image_width, image_height, num_photons, max_depth, radius, buffer);
+        render_pm(world, cam, image_width, image_height, num_photons, max_depth, radius, *sampler, fg_samples, buffer, time_budget, tiles, denoise, gbuffer);
     } else if (mode == "ppm") {
         // PPM 参数
         int num_photons = samples * 10000; 
         double radius = 0.01; //ppm的初始半径要大，因为会不断缩减，如果一开始没有搜索到光子，后面就更难搜到了
-        render_ppm(world, lights, cam, image_width, image_height, num_photons, max_depth, radius, buffer);
+        render_ppm(world, cam, image_width, image_height, num_photons, max_depth, radius, *sampler, buffer, time_budget, tiles, denoise, gbuffer);
+    } else if (mode == "wavefront") {
+        // 同样的路径追踪，按阶段整批推进
+        render_wavefront(world, cam, image_width, image_height, samples_per_pixel, max_depth, rr_min_bounce, *sampler, buffer, denoise, gbuffer);
+    } else if (progressive) {
+        // 渐进式：一遍一遍累加到 HDR 胶片，定期存检查点，检查点已经存在就接着算
+        Film film(image_width, image_height, max_depth, rr_min_bounce, sampler_name, scene_signature(world), run_id);
+        std::ifstream probe(checkpoint);
+        if (!checkpoint.empty() && probe.good()) {
+            Film saved;
+            std::string why;
+            if (!saved.load(checkpoint)) return 1;
+            if (!film.can_resume(saved, why)) {
+                std::cerr << "检查点 " << checkpoint << " 和当前设置不一致: " << why << "，请换一个检查点文件\n";
+                return 1;
+            }
+            film = saved;
+            std::cout << "从检查点 " << checkpoint << " 续算, 已有 " << film.min_count() << " spp\n";
+        }
+        // 第一个交点只来自这次运行的样本，从完成的检查点续算时没有引导和 AOV
+        render_path_tracing_progressive(world, cam, samples_per_pixel, pass_spp, max_depth, rr_min_bounce, *sampler, film, checkpoint, checkpoint_interval, time_budget, tiles, gbuffer);
+        film.resolve(buffer, guides, denoise);
+        film.write_pfm("../images/" + hdr_name);
+    } else if (adaptive.threshold > 0) {
+        // 自适应采样：同样的总预算，按像素的相对误差分配
+        render_path_tracing_adaptive(world, cam, image_width, image_height, samples_per_pixel, max_depth, rr_min_bounce, *sampler, adaptive, buffer, sample_counts, denoise, gbuffer);
     } else {
         // 默认路径追踪
-        render_path_tracing(world, cam, image_width, image_height, samples_per_pixel, max_depth, buffer);
+        render_path_tracing(world, cam, image_width, image_height, samples_per_pixel, max_depth, rr_min_bounce, *sampler, buffer, tiles, denoise, gbuffer);
     }
 
     // 将缓冲区写入文件
+    std::ofstream outfile(filename_);
+    outfile << "P3\n" << out_width << " " << out_height << "\n255\n";
     for (size_t i = 0; i < buffer.size(); i += 3) {
         outfile << static_cast<int>(buffer[i]) << ' '
                 << static_cast<int>(buffer[i+1]) << ' '
@@ -163,5 +330,26 @@ int main(int argc, char* argv[]) {
     outfile.close();
 
     std::cout << "ppm格式的文件已保存到 " << filename << std::endl;
+    if (progressive || !merge_files.empty()) std::cout << "HDR 结果 (PFM) 已保存到 " << hdr_name << std::endl;
+
+    // AOV：第一个交点的几张 float 图，存在主输出旁边 (xxx_albedo.pfm 等)
+    if (aov) {
+        std::string stem = filename.substr(0, filename.rfind('.'));
+        if (save_aovs("../images/" + stem, out_width, out_height, guides, world))
+            std::cout << "AOV (PFM) 已保存到 " << stem << "_{albedo,normal,depth,objid,matid}.pfm" << std::endl;
+    }
+
+    // 自适应采样的样本数分布图：灰度，越亮样本越多，存在主输出旁边 (xxx_spp.ppm)
+    if (!sample_counts.empty()) {
+        std::string map_name = filename.substr(0, filename.rfind('.')) + "_spp.ppm";
+        std::ofstream map_file("../images/" + map_name);
+        map_file << "P3\n" << image_width << " " << image_height << "\n255\n";
+        int max_count = *std::max_element(sample_counts.begin(), sample_counts.end());
+        for (int count : sample_counts) {
+            int v = static_cast<int>(255.0 * count / std::max(max_count, 1));
+            map_file << v << ' ' << v << ' ' << v << '\n';
+        }
+        std::cout << "样本数分布图已保存到 " << map_name << " (最多 " << max_count << " spp)" << std::endl;
+    }
     std::cout << "查看ppm文件: cd ../&& python3 read_ppm.py " << filename  << std::endl;
 }